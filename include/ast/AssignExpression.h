@@ -0,0 +1,19 @@
+#pragma once
+#include "Node.h"
+#include "ast/Expression.h"
+#include "token.h"
+#include <memory>
+#include <string>
+
+namespace ast {
+// target = value, where target is an Identifier naming an existing binding
+// or an IndexExpression naming an element of an array or hash
+class AssignExpression : public Expression {
+  public:
+    std::unique_ptr<Expression> target;
+    std::unique_ptr<Expression> value;
+
+    std::string tokenLiteral() const override;
+    std::string toString() const override;
+};
+} // namespace ast
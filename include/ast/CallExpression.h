@@ -11,6 +11,9 @@ class CallExpression : public Expression {
   public:
     std::unique_ptr<ast::Expression> function;
     std::vector<std::unique_ptr<ast::Expression>> arguments;
+    // set by the resolver when the call's value is what its function returns
+    bool tail = false;
+    Fusion fusion = Fusion::NONE;
 
     std::string tokenLiteral() const override;
     std::string toString() const override;
@@ -0,0 +1,14 @@
+#pragma once
+#include "Node.h"
+#include "ast/Statement.h"
+#include "token.h"
+#include <string>
+
+namespace ast {
+class ContinueStatement : public Statement {
+  public:
+    std::string tokenLiteral() const override;
+    std::string toString() const override;
+    token::Token token;
+};
+} // namespace ast
@@ -4,6 +4,27 @@
 #include <string>
 
 namespace ast {
+// A superinstruction an expression has been fused into by
+// evaluator::fuseSuperinstructions; the operands of a fused node are read
+// in place instead of being evaluated as nodes of their own.
+enum class Fusion : unsigned char {
+    NONE,
+    // a local variable and an integer literal: n - 1, i < 10
+    LOCAL_OP_CONST,
+    // two local variables: a + b
+    LOCAL_OP_LOCAL,
+    // a named value indexed by a local variable: arr[i]
+    INDEX_BY_LOCAL,
+    // a named function called with one local variable: len(arr)
+    CALL_LOCAL,
+    // a named function called with any one argument: fib(n - 1)
+    CALL_NAMED,
+};
+
+// The type evaluator::inferTypes proved an expression's value always has.
+// UNKNOWN promises nothing.
+enum class StaticType : unsigned char { UNKNOWN, INTEGER, BOOLEAN };
+
 class Expression : public Node {
   public:
     virtual ~Expression() = default;
@@ -0,0 +1,22 @@
+#pragma once
+#include "Node.h"
+#include "ast/BlockStatement.h"
+#include "ast/Expression.h"
+#include "ast/Identifier.h"
+#include "ast/Statement.h"
+#include "token.h"
+#include <memory>
+#include <string>
+
+namespace ast {
+// for (variable in iterable) body
+class ForStatement : public Statement {
+  public:
+    std::string tokenLiteral() const override;
+    std::string toString() const override;
+    token::Token token;
+    std::unique_ptr<Identifier> variable;
+    std::unique_ptr<Expression> iterable;
+    std::unique_ptr<BlockStatement> body;
+};
+} // namespace ast
@@ -8,11 +8,18 @@
 #include <string>
 #include <vector>
 
+namespace object {
+class FunctionPrototype;
+}
+
 namespace ast {
 class FunctionLiteral : public Expression {
   public:
     std::vector<std::unique_ptr<ast::Identifier>> parameters;
-    std::unique_ptr<ast::BlockStatement> body;
+    // shared with the literal's FunctionPrototype, which outlives the AST
+    std::shared_ptr<ast::BlockStatement> body;
+    // built the first time the literal is evaluated and reused afterwards
+    std::shared_ptr<const object::FunctionPrototype> prototype;
 
     std::string tokenLiteral() const override;
     std::string toString() const override;
@@ -6,8 +6,23 @@
 #include <string>
 
 namespace ast {
+// Where the variable an identifier names lives at runtime. The resolver
+// fills this in for identifiers inside function bodies; anything it leaves
+// as GLOBAL is looked up by name in the global scope.
+enum class BindingKind : unsigned char { GLOBAL, LOCAL, CELL, UPVALUE };
+
+struct Binding {
+    BindingKind kind = BindingKind::GLOBAL;
+    // index into the frame's slots (LOCAL) or cells (CELL), or the closure's upvalues (UPVALUE)
+    int index = 0;
+};
+
 class Identifier : public Expression {
   public:
+    Binding binding;
+    // the type every value of the variable has, when inferTypes proved one
+    StaticType type = StaticType::UNKNOWN;
+
     std::string tokenLiteral() const override;
     std::string toString() const override;
 };
@@ -6,12 +6,23 @@
 #include <memory>
 #include <string>
 
+namespace object {
+class Object;
+class Shape;
+} // namespace object
+
 namespace ast {
 class IndexExpression : public Expression {
   public:
     std::unique_ptr<Expression> left;
     std::unique_ptr<Expression> index;
+    Fusion fusion = Fusion::NONE;
 
+    // inline cache for record lookups, see evaluator::evalCachedIndexExpression;
+    // tree walker only, like InfixExpression::form
+    const object::Shape *cachedShape = nullptr;
+    const object::Object *cachedKey = nullptr;
+    int cachedSlot = 0;
 
     std::string tokenLiteral() const override;
     std::string toString() const override;
@@ -7,12 +7,36 @@
 #include <string>
 
 namespace ast {
+// What an infix node has been specialized to by quickening, see
+// evaluator::evalQuickenedInfix. UNSPECIALIZED nodes take the generic path.
+enum class InfixForm : unsigned char {
+    UNSPECIALIZED,
+    ADD_INT_INT,
+    SUB_INT_INT,
+    MUL_INT_INT,
+    DIV_INT_INT,
+    EQ_INT_INT,
+    NE_INT_INT,
+    LT_INT_INT,
+    GT_INT_INT,
+    CONCAT_STR,
+};
+
 class InfixExpression : public Expression {
   public:
     std::string oper;
     std::unique_ptr<Expression> right;
     std::unique_ptr<Expression> left;
 
+    Fusion fusion = Fusion::NONE;
+    // tree walker only: the quickened form, and how often a specialized form
+    // met operands it does not handle; a background compile runs beside
+    // these writes, so compileFunction does not read them
+    InfixForm form = InfixForm::UNSPECIALIZED;
+    unsigned char deopts = 0;
+    // the type of the result, when inferTypes proved one
+    StaticType type = StaticType::UNKNOWN;
+
     std::string tokenLiteral() const override;
     std::string toString() const override;
 };
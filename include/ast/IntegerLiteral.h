@@ -5,10 +5,16 @@
 #include <memory>
 #include <string>
 
+namespace object {
+class Integer;
+}
+
 namespace ast {
 class IntegerLiteral : public Expression {
   public:
     int valueInt;
+    // shared runtime value, filled in when the literal is fused into its parent
+    object::Integer *constant = nullptr;
 
     std::string tokenLiteral() const override;
     std::string toString() const override;
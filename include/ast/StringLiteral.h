@@ -5,10 +5,16 @@
 #include <memory>
 #include <string>
 
+namespace object {
+class String;
+}
+
 namespace ast {
 class StringLiteral : public Expression {
   public:
     std::string valueString;
+    // interned runtime value, filled in the first time the literal is evaluated
+    object::String *interned = nullptr;
 
     std::string tokenLiteral() const override;
     std::string toString() const override;
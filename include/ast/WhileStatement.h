@@ -0,0 +1,19 @@
+#pragma once
+#include "Node.h"
+#include "ast/BlockStatement.h"
+#include "ast/Expression.h"
+#include "ast/Statement.h"
+#include "token.h"
+#include <memory>
+#include <string>
+
+namespace ast {
+class WhileStatement : public Statement {
+  public:
+    std::string tokenLiteral() const override;
+    std::string toString() const override;
+    token::Token token;
+    std::unique_ptr<Expression> condition;
+    std::unique_ptr<BlockStatement> body;
+};
+} // namespace ast
@@ -0,0 +1,32 @@
+#pragma once
+#include "object/object.h"
+#include <cstddef>
+#include <vector>
+
+namespace evaluator {
+// Call arguments are evaluated directly onto this stack and handed to the
+// callee as an object::Args view, so a call does not allocate an argument
+// vector. The stack is made of fixed chunks that are never resized: a block
+// returned by reserve() stays put while nested calls push their own
+// arguments, and chunks are kept for reuse once released.
+class ArgumentStack {
+  public:
+    struct Mark {
+        std::size_t chunk;
+        std::size_t used;
+    };
+
+    Mark mark() const { return Mark{chunk_, used_}; }
+    // returns `count` contiguous slots; valid until reset() to an earlier mark
+    object::Object **reserve(std::size_t count);
+    void reset(Mark mark);
+
+  private:
+    static constexpr std::size_t CHUNK_SIZE = 4096;
+
+    std::vector<std::vector<object::Object *>> chunks_;
+    std::size_t chunk_ = 0;
+    std::size_t used_ = 0;
+};
+
+} // namespace evaluator
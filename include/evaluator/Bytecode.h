@@ -0,0 +1,112 @@
+#pragma once
+#include "object/FunctionPrototype.h"
+#include "object/object.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace evaluator {
+// Instruction set of the register machine, in the style of Lua 5: three
+// address instructions over a per-call register file. R(x) is register x of
+// the current frame; RK(x) is R(x) for x >= 0 and constant -x - 1 for x < 0,
+// so literal operands need no load. N(x) is the name at index x.
+//
+// A function's uncaptured locals live in registers 0 to slotCount - 1 (their
+// resolver slot index is their register); temporaries are allocated above.
+//
+// The list is kept in one place so the enum, opcodeName and the machine's
+// dispatch table cannot get out of step.
+#define MONKEY_OPCODES(X) \
+    X(MOVE)         /* R(a) = R(b) */ \
+    X(LOADK)        /* R(a) = constant b */ \
+    X(GETLOCAL)     /* R(a) = R(b), or the global or builtin N(c) if the local is unset */ \
+    X(GETCELL)      /* R(a) = cells[b], or the global or builtin N(c) if the cell is unset */ \
+    X(GETUPVAL)     /* R(a) = upvalues[b], or the global or builtin N(c) if it is unset */ \
+    X(GETGLOBAL)    /* R(a) = the global or builtin N(b) */ \
+    X(SETCELL)      /* cells[a] = RK(b) */ \
+    X(SETUPVAL)     /* upvalues[a] = RK(b) */ \
+    X(SETGLOBAL)    /* let N(a) = RK(b) in the global scope */ \
+    X(ASSIGNGLOBAL) /* N(a) = RK(b) where N(a) already exists */ \
+    X(ADD)          /* R(a) = RK(b) + RK(c) */ \
+    X(SUB)          /* R(a) = RK(b) - RK(c) */ \
+    X(MUL)          /* R(a) = RK(b) * RK(c) */ \
+    X(DIV)          /* R(a) = RK(b) / RK(c) */ \
+    X(EQ)           /* R(a) = RK(b) == RK(c) */ \
+    X(NE)           /* R(a) = RK(b) != RK(c) */ \
+    X(LT)           /* R(a) = RK(b) < RK(c) */ \
+    X(GT)           /* R(a) = RK(b) > RK(c) */ \
+    X(NOT)          /* R(a) = !RK(b) */ \
+    X(NEG)          /* R(a) = -RK(b) */ \
+    X(JMP)          /* pc += b */ \
+    X(JMPIFNOT)     /* if RK(a) is falsy, pc += b */ \
+    X(NEWARRAY)     /* R(a) = [R(b), ..., R(b + c - 1)] */ \
+    X(NEWHASH)      /* R(a) = {R(b): R(b + 1), ...} with c pairs */ \
+    X(INDEX)        /* R(a) = RK(b)[RK(c)] */ \
+    X(SETINDEX)     /* R(a)[RK(b)] = RK(c) */ \
+    X(CLOSURE)      /* R(a) = a closure of function b */ \
+    X(CALL)         /* R(a) = R(b)(R(b + 1), ..., R(b + c)) */ \
+    X(TAILCALL)     /* return R(b)(R(b + 1), ..., R(b + c)), reusing the frame */ \
+    X(RETURN)       /* return RK(a) */ \
+    X(FORPREP)      /* R(a) = loopSource(R(a)), resetting the cursor in R(a + 1) and R(a + 2) */ \
+    X(FORNEXT)      /* R(a + 1) = the next element of R(a), or pc += b at the end */ \
+    X(ADD_INT_INT)  /* ADD quickened for two integers */ \
+    X(SUB_INT_INT)  /* SUB quickened for two integers */ \
+    X(MUL_INT_INT)  /* MUL quickened for two integers */ \
+    X(DIV_INT_INT)  /* DIV quickened for two integers */ \
+    X(EQ_INT_INT)   /* EQ quickened for two integers */ \
+    X(NE_INT_INT)   /* NE quickened for two integers */ \
+    X(LT_INT_INT)   /* LT quickened for two integers */ \
+    X(GT_INT_INT)   /* GT quickened for two integers */ \
+    X(CONCAT_STR)   /* ADD quickened for two strings */ \
+    X(CALL1)        /* R(a) = R(b)(RK(c)): CALL with its one argument in place */ \
+    X(JMPIFNOTEQ)   /* if not RK(a) == RK(c), pc += b: EQ and JMPIFNOT fused */ \
+    X(JMPIFNOTNE)   /* if not RK(a) != RK(c), pc += b: NE and JMPIFNOT fused */ \
+    X(JMPIFNOTLT)   /* if not RK(a) < RK(c), pc += b: LT and JMPIFNOT fused */ \
+    X(JMPIFNOTGT)   /* if not RK(a) > RK(c), pc += b: GT and JMPIFNOT fused */
+
+enum class Opcode : unsigned char {
+#define MONKEY_OPCODE_ENUM(name) name,
+    MONKEY_OPCODES(MONKEY_OPCODE_ENUM)
+#undef MONKEY_OPCODE_ENUM
+};
+
+// The generic arithmetic and comparison opcodes, ADD to GT, rewrite
+// themselves in place to their quickened form once they have seen its
+// operand types; the quickened form reverts to the generic one on operands
+// it does not handle, see quicken in RegisterMachine.cpp.
+inline Opcode quickenedInteger(Opcode generic) {
+    return static_cast<Opcode>(static_cast<int>(generic) - static_cast<int>(Opcode::ADD) +
+                               static_cast<int>(Opcode::ADD_INT_INT));
+}
+
+// CALL1 and the JMPIFNOT comparisons are superinstructions, emitted for the
+// calls and conditions that were fused, see Superinstructions.h.
+
+// Jump offsets are relative to the instruction after the jump.
+struct Instruction {
+    Opcode op;
+    // how often a quickened form of this instruction had to fall back
+    unsigned char deopts;
+    int a;
+    int b;
+    int c;
+};
+
+// The compiled form of a program or of a function body. Not const while it
+// runs: quickening rewrites its instructions.
+struct CodeBlock {
+    std::vector<Instruction> code;
+    std::vector<object::Object *> constants;
+    std::vector<std::string> names;
+    // the functions CLOSURE instructions create
+    std::vector<std::shared_ptr<const object::FunctionPrototype>> functions;
+    // size of the register file of one call
+    std::size_t registerCount = 0;
+};
+
+const char *opcodeName(Opcode op);
+// One instruction per line, for debugging and tests.
+std::string disassemble(const CodeBlock &block);
+
+} // namespace evaluator
@@ -0,0 +1,36 @@
+#pragma once
+#include "ast/Node.h"
+#include "ast/Program.h"
+#include "object/Environment.h"
+#include "object/FunctionPrototype.h"
+#include "object/object.h"
+#include <functional>
+
+namespace evaluator {
+// Closure compilation: each AST node is turned once into a C++ callable
+// that has its children's callables, its operator and its literal values
+// bound in, and identifiers bound to their slot, cell or upvalue. Running
+// the result never inspects node types again, unlike evaluator::eval,
+// which re-dispatches on every node each time it is reached.
+//
+// It shares frames, closures, builtins and error reporting with the tree
+// walker. Builtins that call back into Monkey code (map, filter, ...) run
+// the callback through applyFunction, on the tree walker.
+using CompiledNode = std::function<object::Result(object::Environment *env)>;
+
+// The compiled body of a function, cached on its prototype.
+struct CompiledBody {
+    CompiledNode run;
+};
+
+// Compiles `node`; it must stay alive as long as the result is used.
+// Function literals not yet resolved are resolved first.
+CompiledNode compileClosure(ast::Node *node);
+// The compiled body of a function, compiled on its first call.
+const CompiledBody *compiledBody(const object::FunctionPrototype *prototype);
+// applyFunction, running compiled bodies.
+object::Result applyCompiled(object::Object *func, object::Args args);
+// Compiles `program` and runs it; returns what eval() would.
+object::Object *evalClosureCompiled(ast::Program *program, object::Environment *env);
+
+} // namespace evaluator
@@ -0,0 +1,21 @@
+#pragma once
+#include "ast/Program.h"
+#include "evaluator/Bytecode.h"
+#include "object/FunctionPrototype.h"
+#include <memory>
+
+namespace evaluator {
+// Compiles a top-level program for the register machine. Function literals
+// in it are resolved first (see Resolver.h); their bodies are compiled when
+// they are first called, see functionCode.
+std::unique_ptr<CodeBlock> compileProgram(ast::Program *program);
+// Compiles the body of a function. The tiering manager runs this on a
+// worker thread while the tree walker runs the same body, so it must not
+// read the fields the tree walker rewrites as it goes: InfixExpression's
+// form and deopts, IndexExpression's cached*, IntegerLiteral::constant.
+std::unique_ptr<CodeBlock> compileFunction(const object::FunctionPrototype &prototype);
+// The compiled body of a function, compiled on the first request and cached
+// in the function's profile, so every closure of a literal shares one CodeBlock.
+CodeBlock *functionCode(const object::FunctionPrototype *prototype);
+
+} // namespace evaluator
@@ -0,0 +1,29 @@
+#pragma once
+#include "ast/Program.h"
+#include "object/Environment.h"
+#include "object/object.h"
+#include <string>
+
+namespace evaluator {
+// The interchangeable ways of running a program. They agree on values,
+// errors and the global scope, so a REPL session or a benchmark can pick
+// any of them.
+enum class Engine {
+    // evaluator::eval, the recursive tree walker
+    TREE,
+    // StacklessMachine
+    STACKLESS,
+    // RegisterMachine, running compiled bytecode
+    REGISTER,
+    // the tree compiled to C++ closures, see ClosureCompiler.h
+    CLOSURE,
+};
+
+// Parses an engine name as given on the command line: "tree", "stackless"
+// "register" or "closure". Returns false for anything else.
+bool parseEngine(const std::string &name, Engine &engine);
+const char *engineName(Engine engine);
+// Runs `program` against `env` on `engine`; returns what eval() would.
+object::Object *evalWith(Engine engine, ast::Program *program, object::Environment *env);
+
+} // namespace evaluator
@@ -0,0 +1,49 @@
+#pragma once
+#include "object/Function.h"
+#include "object/FunctionPrototype.h"
+#include "object/object.h"
+#include <memory>
+
+namespace evaluator {
+struct CodeBlock;
+struct CompiledBody;
+class NativeCode;
+class OptimizedCode;
+enum class Tier : unsigned char;
+
+// What the engines learn and build while a function runs: its compiled
+// forms and the counts the tiering manager promotes it by. There is one
+// profile per object::FunctionPrototype, shared by all of its closures and
+// kept here in the evaluator, beside the immutable prototype rather than
+// in it. The tiering manager's background worker hands its results over
+// through it (see Tiering.h).
+struct FunctionProfile {
+    // the body compiled for the register machine, on the first call it runs
+    std::shared_ptr<CodeBlock> code;
+    // the body compiled to closures, on the first call the closure engine runs
+    std::shared_ptr<CompiledBody> compiled;
+    // the machine code the JIT made, once the function reached its native tier
+    std::shared_ptr<NativeCode> native;
+    // counted calls and the tier they run in, kept by the tiering manager
+    unsigned callCount = 0;
+    Tier tier{};
+    // a background compile of the function is under way
+    bool compiling = false;
+    // set when the JIT could not compile the function, so it is not retried
+    bool nativeFailed = false;
+    // the optimizing tier's code, how often its guards failed, and whether
+    // the function was found unsuitable or demoted from it
+    std::shared_ptr<OptimizedCode> optimized;
+    unsigned char optimizedDeopts = 0;
+    bool optimizedFailed = false;
+    // for a function compiled ahead of time by monkeyc, the C++ function
+    // that runs a call in place of the body, which is then nullptr
+    object::Result (*entry)(object::Function *self, object::Args args) = nullptr;
+};
+
+// The profile of `prototype`, found by its id. Profiles are never freed:
+// ids are not reused, and there is one per function literal resolved, not
+// one per closure.
+FunctionProfile &profileOf(const object::FunctionPrototype *prototype);
+
+} // namespace evaluator
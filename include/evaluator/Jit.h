@@ -0,0 +1,78 @@
+#pragma once
+#include "evaluator/Bytecode.h"
+#include "object/Environment.h"
+#include "object/Function.h"
+#include "object/FunctionPrototype.h"
+#include "object/object.h"
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// The baseline JIT emits x86-64 machine code and needs mmap/mprotect; on
+// other targets it compiles to nothing and every function stays interpreted.
+#if defined(__x86_64__) && defined(__linux__)
+#define MONKEY_JIT_SUPPORTED 1
+#else
+#define MONKEY_JIT_SUPPORTED 0
+#endif
+
+namespace evaluator {
+// A baseline template JIT. When the tiering manager (see Tiering.h)
+// promotes a function to its native tier, the function's register bytecode
+// (see Bytecode.h) is translated to x86-64 by stitching together a fixed
+// machine-code template per instruction into an executable buffer. Integer
+// arithmetic, integer comparisons, branches, moves and returns run inline;
+// allocation, hashes, globals, calls and builtins call back into the
+// runtime. The function's registers live in its native stack frame.
+//
+// Functions with captured locals (cells) are not compiled. Setting
+// jitEnabled to false, with --jit=off or MONKEY_JIT=off, is the kill switch:
+// no function is promoted past bytecode.
+extern bool jitEnabled;
+// Compiled functions call each other on the C++ stack, unlike the register
+// machine's frames; past this many nested native calls the tiering manager
+// runs callees as bytecode instead.
+constexpr unsigned MAX_NATIVE_DEPTH = 1000;
+extern unsigned nativeDepth;
+
+// What a compiled function needs besides its arguments.
+struct JitContext {
+    object::Function *closure;
+    CodeBlock *code;
+    // set when the function ended in a tail call: the callee is returned and
+    // its arguments are in tailArguments
+    bool tailCall = false;
+};
+
+// Machine code for one function: the entry takes the context and the
+// arguments and returns the function's value, or nullptr on an error (the
+// details are in lastError).
+class NativeCode {
+  public:
+    using Entry = object::Object *(*)(JitContext *context, object::Object *const *args);
+
+    NativeCode(void *memory, std::size_t size, std::shared_ptr<CodeBlock> code)
+        : memory_(memory), size_(size), code_(std::move(code)) {};
+    ~NativeCode();
+    NativeCode(const NativeCode &) = delete;
+    NativeCode &operator=(const NativeCode &) = delete;
+
+    Entry entry() const { return reinterpret_cast<Entry>(memory_); }
+    std::size_t size() const { return size_; }
+    // the bytecode it was translated from, which its instructions refer to
+    CodeBlock *code() const { return code_.get(); }
+
+  private:
+    void *memory_;
+    std::size_t size_;
+    std::shared_ptr<CodeBlock> code_;
+};
+
+// Compiles `prototype` to bytecode of its own and translates that; nullptr
+// if it uses something the JIT does not handle or the target is not
+// supported. It touches no shared state, so it may run on a worker thread.
+std::unique_ptr<NativeCode> compileNative(const object::FunctionPrototype *prototype);
+// Runs `func` as compiled code. A tail call comes back as a TAIL_CALL result.
+object::Result runNative(const NativeCode *native, object::Function *func, object::Args args);
+
+} // namespace evaluator
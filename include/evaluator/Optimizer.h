@@ -0,0 +1,59 @@
+#pragma once
+#include "object/Function.h"
+#include "object/FunctionPrototype.h"
+#include "object/object.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace evaluator {
+// The optimizing tier, for long-running numeric functions. A function whose
+// bytecode only does integer and boolean arithmetic, comparisons, branches
+// and calls to itself is lowered, with its parameters specialized to
+// integers, to LLVM IR and compiled by ORC at -O2. Values live in
+// machine registers, self calls are direct calls, and tail calls are loops.
+//
+// Guards keep the interpreter's semantics: the arguments must be integers,
+// the global names the function calls itself by must still refer to it, and
+// a division by zero, an overflowing division or recursion past
+// MAX_OPTIMIZED_DEPTH bails out. Such code has no side effects, so bailing
+// out just reruns the whole call on a lower tier.
+//
+// The tier exists only in builds with LLVM (make llvm, which defines
+// MONKEY_LLVM for Optimizer.cpp); elsewhere optimizerAvailable() is false
+// and nothing is ever compiled.
+constexpr std::size_t MAX_OPTIMIZED_PARAMETERS = 8;
+constexpr std::int32_t MAX_OPTIMIZED_DEPTH = 10000;
+
+class OptimizedCode {
+  public:
+    // Returns the function's value; sets *failed instead when a guard
+    // inside the code fails.
+    using Entry = std::int32_t (*)(const std::int32_t *args, unsigned char *failed);
+
+    OptimizedCode(Entry entry, bool returnsBoolean, std::vector<std::string> selfNames)
+        : entry_(entry), returnsBoolean_(returnsBoolean), selfNames_(std::move(selfNames)) {};
+
+    Entry entry() const { return entry_; }
+    // whether the value is a boolean rather than an integer
+    bool returnsBoolean() const { return returnsBoolean_; }
+    // globals the function calls itself through
+    const std::vector<std::string> &selfNames() const { return selfNames_; }
+
+  private:
+    Entry entry_;
+    bool returnsBoolean_;
+    std::vector<std::string> selfNames_;
+};
+
+bool optimizerAvailable();
+// Compiles `prototype` from bytecode of its own; nullptr if the function
+// does anything the tier does not handle. Safe to call on a worker thread.
+std::unique_ptr<OptimizedCode> compileOptimized(const object::FunctionPrototype *prototype);
+// Runs `func` as optimized code and stores its value in `result`; false if
+// a guard failed and the call has to be rerun on a lower tier.
+bool runOptimized(const OptimizedCode *code, object::Function *func, object::Args args, object::Result &result);
+
+} // namespace evaluator
@@ -0,0 +1,63 @@
+#pragma once
+#include "ast/Program.h"
+#include "evaluator/Bytecode.h"
+#include "object/Cell.h"
+#include "object/Environment.h"
+#include "object/Function.h"
+#include "object/object.h"
+#include <cstddef>
+#include <vector>
+
+namespace evaluator {
+// A bytecode engine: programs are compiled to register code (see
+// Bytecode.h) and run here. Registers of all active calls share one
+// growable file, so a call costs a frame record and no allocation, and
+// Monkey-to-Monkey calls do not recurse on the C++ stack.
+//
+// It produces the same values and errors as evaluator::eval and uses the
+// same closures: functions it creates are ordinary object::Functions, which
+// builtins such as map call back through applyFunction.
+class RegisterMachine {
+  public:
+    // Runs a compiled top-level program against `globals`.
+    object::Result run(CodeBlock *code, object::Environment *globals);
+    // Calls `func` with `args`.
+    object::Result call(object::Function *func, object::Args args);
+
+  private:
+    struct Frame {
+        CodeBlock *code;
+        Instruction *pc;
+        // first register and first cell of the call
+        std::size_t base;
+        std::size_t cellBase;
+        object::Function *closure;
+        object::Environment *globals;
+        // caller's register that receives the result
+        int result;
+    };
+
+    std::vector<Frame> frames_;
+    std::vector<object::Object *> registers_;
+    std::vector<object::Cell *> cells_;
+    // arguments of a tail call while its frame is reset
+    std::vector<object::Object *> arguments_;
+
+    std::size_t top() const;
+    void enter(CodeBlock *code, std::size_t base, object::Function *closure, object::Environment *globals,
+               int result);
+    void bindArguments(const Frame &frame, object::Object *const *args);
+    bool leave(object::Object *value, std::size_t depth);
+    object::Result fail(std::size_t depth);
+    object::Result execute(std::size_t depth);
+    object::Result lookup(const Frame &frame, int name);
+    object::Function *makeClosure(const Frame &frame, int function);
+};
+
+// Compiles `program` and runs it on the register machine; returns what
+// eval() would.
+object::Object *evalRegisterMachine(ast::Program *program, object::Environment *env);
+// Calls `func` on the register machine, for functions tiered up to bytecode.
+object::Result callRegisterMachine(object::Function *func, object::Args args);
+
+} // namespace evaluator
@@ -0,0 +1,84 @@
+#pragma once
+#include "ast/ArrayLiteral.h"
+#include "ast/AssignExpression.h"
+#include "ast/CallExpression.h"
+#include "ast/ExpressionStatement.h"
+#include "ast/ForStatement.h"
+#include "ast/FunctionLiteral.h"
+#include "ast/HashLiteral.h"
+#include "ast/IfExpression.h"
+#include "ast/IndexExpression.h"
+#include "ast/InfixExpression.h"
+#include "ast/LetStatement.h"
+#include "ast/PrefixExpression.h"
+#include "ast/ReturnStatement.h"
+#include "ast/WhileStatement.h"
+#include "object/FunctionPrototype.h"
+#include <memory>
+
+namespace evaluator {
+// Calls `visit` on each direct child of `node`; an absent child (an if
+// without an else) is passed as nullptr.
+template <typename Visit> void forEachChild(ast::Node *node, Visit &&visit) {
+    if (auto block = dynamic_cast<ast::BlockStatement *>(node)) {
+        for (const auto &statement : block->statements) {
+            visit(statement.get());
+        }
+    } else if (auto let = dynamic_cast<ast::LetStatement *>(node)) {
+        visit(let->name.get());
+        visit(let->value.get());
+    } else if (auto expression = dynamic_cast<ast::ExpressionStatement *>(node)) {
+        visit(expression->expression.get());
+    } else if (auto ret = dynamic_cast<ast::ReturnStatement *>(node)) {
+        visit(ret->returnValue.get());
+    } else if (auto ifExpression = dynamic_cast<ast::IfExpression *>(node)) {
+        visit(ifExpression->condition.get());
+        visit(ifExpression->consiquence.get());
+        visit(ifExpression->alternative.get());
+    } else if (auto prefix = dynamic_cast<ast::PrefixExpression *>(node)) {
+        visit(prefix->right.get());
+    } else if (auto infix = dynamic_cast<ast::InfixExpression *>(node)) {
+        visit(infix->left.get());
+        visit(infix->right.get());
+    } else if (auto call = dynamic_cast<ast::CallExpression *>(node)) {
+        visit(call->function.get());
+        for (const auto &arg : call->arguments) {
+            visit(arg.get());
+        }
+    } else if (auto array = dynamic_cast<ast::ArrayLiteral *>(node)) {
+        for (const auto &element : array->elements) {
+            visit(element.get());
+        }
+    } else if (auto index = dynamic_cast<ast::IndexExpression *>(node)) {
+        visit(index->left.get());
+        visit(index->index.get());
+    } else if (auto hash = dynamic_cast<ast::HashLiteral *>(node)) {
+        for (const auto &pair : hash->pairs) {
+            visit(pair.first.get());
+            visit(pair.second.get());
+        }
+    } else if (auto assign = dynamic_cast<ast::AssignExpression *>(node)) {
+        visit(assign->target.get());
+        visit(assign->value.get());
+    } else if (auto whileStatement = dynamic_cast<ast::WhileStatement *>(node)) {
+        visit(whileStatement->condition.get());
+        visit(whileStatement->body.get());
+    } else if (auto forStatement = dynamic_cast<ast::ForStatement *>(node)) {
+        visit(forStatement->variable.get());
+        visit(forStatement->iterable.get());
+        visit(forStatement->body.get());
+    } else if (auto function = dynamic_cast<ast::FunctionLiteral *>(node)) {
+        for (const auto &param : function->parameters) {
+            visit(param.get());
+        }
+        visit(function->body.get());
+    }
+}
+
+// Resolves every name used inside `literal` and the functions nested in it
+// to a frame slot, a cell or an upvalue, and attaches a FunctionPrototype to
+// each of those literals. `literal` must be defined outside any function:
+// names that no enclosing function binds are left as globals.
+std::shared_ptr<const object::FunctionPrototype> resolveFunction(ast::FunctionLiteral *literal);
+
+} // namespace evaluator
@@ -0,0 +1,90 @@
+#pragma once
+#include "ast/Node.h"
+#include "object/Environment.h"
+#include "object/Error.h"
+#include "object/object.h"
+#include <cstddef>
+#include <vector>
+
+namespace evaluator {
+// An evaluation engine that does not recurse on the C++ stack. Pending work
+// is kept on a heap-allocated continuation stack of tasks and intermediate
+// values on a value stack, so call depth is bounded only by the machine's
+// memory budget, and evaluation can stop after any step and be resumed
+// later, e.g. to time-slice several scripts on one thread.
+//
+// It shares the node semantics, the resolver's bindings and the frame
+// layout of evaluator::eval. Builtins that call back into Monkey code still
+// go through the recursive evaluator.
+class StacklessMachine {
+  public:
+    static constexpr std::size_t DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+    explicit StacklessMachine(std::size_t memoryBudget = DEFAULT_BUDGET) : memoryBudget_(memoryBudget) {};
+
+    // Begins evaluating `node` in `env`. The AST must stay alive until the
+    // machine has finished.
+    void start(ast::Node *node, object::Environment *env);
+    // Runs up to `steps` steps, or until finished when `steps` is 0.
+    // Returns true once evaluation has finished.
+    bool run(std::size_t steps = 0);
+    bool finished() const { return tasks_.empty(); }
+    // The value the evaluation produced, an object::Error if it failed, like eval().
+    object::Object *result() const;
+    // Bytes currently used by the continuation and value stacks.
+    std::size_t memoryUsage() const;
+
+  private:
+    enum class Op : unsigned char {
+        EVAL,
+        PUSH,
+        PREFIX,
+        INFIX,
+        INDEX,
+        IF,
+        LET,
+        RETURN,
+        ARRAY,
+        HASH_KEY,
+        HASH,
+        CALL,
+        CALL_RETURN,
+        WHILE_TEST,
+        WHILE_NEXT,
+        FOR_START,
+        FOR_NEXT,
+        ASSIGN,
+        ASSIGN_INDEX,
+    };
+
+    struct Task {
+        Op op;
+        ast::Node *node;
+        object::Environment *env;
+        // value stack height when the task was pushed, for tasks that consume a run of values
+        std::size_t base;
+        // FOR_NEXT: position of the next element
+        std::size_t position;
+    };
+
+    std::size_t memoryBudget_;
+    std::vector<Task> tasks_;
+    std::vector<object::Object *> values_;
+    object::Result acc_ = nullptr;
+    object::ErrorInfo error_;
+
+    void push(Op op, ast::Node *node, object::Environment *env = nullptr) {
+        tasks_.push_back(Task{op, node, env, values_.size(), 0});
+    }
+    void step(const Task &task);
+    void eval(ast::Node *node, object::Environment *env);
+    void call(const Task &task);
+    void nextElement(const Task &task);
+    void unwind();
+};
+
+// Evaluates `node` to completion on a StacklessMachine.
+object::Object *evalStackless(ast::Node *node, object::Environment *env,
+                              std::size_t memoryBudget = StacklessMachine::DEFAULT_BUDGET);
+
+} // namespace evaluator
@@ -0,0 +1,59 @@
+#pragma once
+#include "ast/Expression.h"
+#include "ast/FunctionLiteral.h"
+#include <array>
+#include <bitset>
+#include <cstddef>
+#include <string>
+
+namespace evaluator {
+// Superinstructions: a handful of expression shapes (see ast::Fusion)
+// account for most of the nodes a typical program evaluates, and each costs
+// a dispatch per operand. After resolution, the shapes in enabledFusions are
+// marked on the nodes; the tree walker then evaluates a fused node and its
+// operands in one step, and the compiler emits a fused opcode where the shape
+// still takes several instructions in register code.
+//
+// Which shapes are worth fusing is decided from a profiling run: with every
+// shape enabled and fusionProfile set, the tree walker counts the fused
+// nodes it evaluates, and chooseFusions keeps the shapes that matter.
+constexpr std::size_t FUSION_COUNT = static_cast<std::size_t>(ast::Fusion::CALL_NAMED) + 1;
+using FusionSet = std::bitset<FUSION_COUNT>;
+
+struct FusionProfile {
+    // evaluations of fused nodes, indexed by ast::Fusion
+    std::array<unsigned long, FUSION_COUNT> counts{};
+};
+
+// The shapes fuseSuperinstructions marks.
+extern FusionSet enabledFusions;
+// When set, the tree walker counts each fused node it evaluates here.
+extern FusionProfile *fusionProfile;
+
+inline void countFusion(ast::Fusion fusion) {
+    if (fusionProfile != nullptr) {
+        fusionProfile->counts[static_cast<std::size_t>(fusion)]++;
+    }
+}
+
+// A profile of recursive and loop-heavy programs, checked in so the
+// default set can be chosen from it; see Superinstructions.cpp.
+extern const FusionProfile defaultProfile;
+// The default set: chooseFusions(defaultProfile, 0.01).
+FusionSet defaultFusions();
+// Every shape, for a profiling run.
+FusionSet allFusions();
+// The shapes that make up at least `minimumShare` of the fused evaluations
+// in `profile`.
+FusionSet chooseFusions(const FusionProfile &profile, double minimumShare);
+
+const char *fusionName(ast::Fusion fusion);
+// The shape `expression` has, if it is one of the fusable ones.
+ast::Fusion fusionOf(ast::Expression *expression);
+// Marks the enabled shapes in `literal` and the functions nested in it,
+// which must have been resolved.
+void fuseSuperinstructions(ast::FunctionLiteral *literal);
+// One line per shape: its name, count and share of the total.
+std::string formatProfile(const FusionProfile &profile);
+
+} // namespace evaluator
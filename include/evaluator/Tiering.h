@@ -0,0 +1,79 @@
+#pragma once
+#include "object/Function.h"
+#include "object/FunctionPrototype.h"
+#include "object/object.h"
+#include <string>
+#include <vector>
+
+namespace evaluator {
+// Tiered execution. Every function starts on the tree walker, which needs
+// no compilation, and its calls are counted (in applyFunction, and in the
+// register machine's CALL). Once the count reaches a tier's threshold the
+// function is promoted: to bytecode run by the register machine, then to
+// machine code from the JIT (see Jit.h), and in builds with LLVM to the
+// optimizing tier (see Optimizer.h). Short scripts never pay for a compile;
+// hot functions end up on the fastest tier.
+//
+// Tiering is opt-in: by default every threshold is 0, so each engine runs
+// every call itself and engines can be compared one for one. The
+// interpreter's --tier turns it on with the DEFAULT_* thresholds below.
+//
+// With background compilation the function keeps running in its current
+// tier while a worker thread compiles it, and is switched over on the
+// first call after the worker is done.
+enum class Tier : unsigned char {
+    TREE,
+    BYTECODE,
+    NATIVE,
+    OPTIMIZED,
+};
+
+struct TierPolicy {
+    // calls before a function is promoted to the tier; 0 never promotes
+    unsigned bytecodeThreshold;
+    unsigned nativeThreshold;
+    unsigned optimizedThreshold;
+    bool background;
+};
+// the thresholds --tier promotes at
+constexpr unsigned DEFAULT_BYTECODE_THRESHOLD = 10;
+constexpr unsigned DEFAULT_NATIVE_THRESHOLD = 100;
+constexpr unsigned DEFAULT_OPTIMIZED_THRESHOLD = 1000;
+extern TierPolicy tierPolicy;
+
+// One function reaching a tier.
+struct Promotion {
+    const object::FunctionPrototype *prototype;
+    Tier tier;
+    // calls counted when it switched
+    unsigned calls;
+    // when the function switched tiers, since the first counted call, and
+    // how long its compile took
+    double atMilliseconds;
+    double compileMilliseconds;
+};
+
+// What the tiering manager did; collected while tierStats is set.
+struct TierStats {
+    std::vector<Promotion> promotions;
+};
+extern TierStats *tierStats;
+
+const char *tierName(Tier tier);
+// Counts a call of `prototype`, promotes the function if the count crossed
+// a threshold, and returns the tier the call runs in.
+Tier enterTier(const object::FunctionPrototype *prototype);
+// Runs `func` as optimized code; false if a guard failed and the call has
+// to be rerun on a lower tier. A function that keeps failing its guards is
+// demoted for good.
+bool callOptimized(object::Function *func, object::Args args, object::Result &result);
+// Runs `func` in the compiled tier enterTier chose, falling back from
+// optimized code to native code or bytecode. A tail call out of native code
+// is finished by applyFunction.
+object::Result callCompiled(object::Function *func, object::Args args);
+// Waits for the background worker to finish what it has been given and
+// installs the results.
+void finishBackgroundCompilation();
+std::string formatTierStats(const TierStats &stats);
+
+} // namespace evaluator
@@ -0,0 +1,31 @@
+#pragma once
+#include "ast/Program.h"
+#include <string>
+
+namespace evaluator {
+// Static type inference over a whole program. Monkey is dynamically typed,
+// but most functions only ever see integers; this pass proves as much where
+// it can and records it on the AST (ast::Identifier::type and
+// ast::InfixExpression::type), so a compiler can keep proven integers
+// unboxed and drop the type checks on them.
+//
+// The analysis is flow-insensitive: a variable's type is the join of every
+// value stored to it, and it stays UNKNOWN unless it is provably never read
+// before its first store (a local read early falls back to the globals).
+// Parameters take the types of the arguments at the function's call sites,
+// which are all known when the function literal is the only value of a
+// variable that is used for nothing but calling it; otherwise they are
+// UNKNOWN. Call results take the type the callee returns. Globals are
+// never typed: a function may run before the top-level `let` that stores
+// one.
+//
+// The program must be complete, as monkeyc compiles it: a later REPL line
+// could call a function with other arguments. Resolves the program's
+// function literals first.
+void inferTypes(ast::Program *program);
+
+// The proven types in `program`, one section per function listing each
+// typed variable once and each typed infix expression, in program order.
+std::string dumpTypes(ast::Program *program);
+
+} // namespace evaluator
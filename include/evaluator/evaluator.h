@@ -1,51 +1,129 @@
 #pragma once
 
+#include "ast/AssignExpression.h"
 #include "ast/BlockStatement.h"
+#include "ast/CallExpression.h"
 #include "ast/Expression.h"
+#include "ast/ForStatement.h"
 #include "ast/HashLiteral.h"
 #include "ast/Identifier.h"
 #include "ast/IfExpression.h"
+#include "ast/IndexExpression.h"
+#include "ast/InfixExpression.h"
 #include "ast/Node.h"
 #include "ast/Program.h"
 #include "ast/Statement.h"
+#include "ast/WhileStatement.h"
+#include "evaluator/ArgumentStack.h"
 #include "object/Boolean.h"
 #include "object/Builtin.h"
 #include "object/Environment.h"
 #include "object/Error.h"
 #include "object/Function.h"
+#include "object/Null.h"
+#include "object/FunctionPrototype.h"
+#include "object/Iterator.h"
+#include "object/Set.h"
 #include "object/object.h"
+#include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 namespace evaluator {
+extern ArgumentStack argumentStack;
+extern object::Null NULL_OBJECT;
+extern object::Boolean TRUE;
+extern object::Boolean FALSE;
+extern std::map<std::string, object::Builtin *> builtins;
+// Details of the most recent error; an evaluation result with status ERROR
+// refers to this until eval() formats it into an object::Error.
+extern object::ErrorInfo lastError;
+// How many times a quickened infix node or instruction may fall back to the
+// generic path before it stops specializing.
+constexpr unsigned char MAX_DEOPTS = 4;
+// Arguments of the pending tail call, see evalTailCall.
+extern std::vector<object::Object *> tailArguments;
+
 object::Object *eval(ast::Node *node, object::Environment *env);
-object::Object *evalProgram(ast::Program *program, object::Environment *env);
-object::Object *evalBlockStatement(ast::BlockStatement *block, object::Environment *env);
+object::Result evalNode(ast::Node *node, object::Environment *env);
+object::Result evalProgram(ast::Program *program, object::Environment *env);
+object::Result evalBlockStatement(ast::BlockStatement *block, object::Environment *env);
 object::Boolean *nativeBoolToBooleanObject(bool input);
-object::Object *evalPrefixExpression(std::string oper, object::Object *right);
-object::Object *evalInfixExpression(std::string oper, object::Object *left, object::Object *right);
+object::Result evalPrefixExpression(const std::string &oper, object::Object *right);
+object::Result evalInfixExpression(const std::string &oper, object::Object *left, object::Object *right);
 object::Object *evalBangOperatorExpression(object::Object *right);
-object::Object *evalMinusOperatorExpression(object::Object *right);
-object::Object *evalIntegerInfixExpression(std::string oper, object::Object *left, object::Object *right);
-object::Object *evalStringInfixExpression(std::string oper, object::Object *left, object::Object *right);
-object::Object *evalIfExpression(ast::IfExpression *ifExpression, object::Environment *env);
-object::Object *evalIdentifier(ast::Identifier *ident, object::Environment *env);
-object::Object *applyFunction(object::Object *func, std::vector<object::Object *> args);
-object::Environment *extendFunctionEnvironment(object::Function *func, std::vector<object::Object *> args);
+object::Result evalMinusOperatorExpression(object::Object *right);
+object::Result evalIntegerInfixExpression(const std::string &oper, object::Object *left, object::Object *right);
+object::Result evalStringInfixExpression(const std::string &oper, object::Object *left, object::Object *right);
+object::Object *concatStrings(object::Object *left, object::Object *right);
+object::Result evalQuickenedInfix(ast::InfixExpression *node, object::Object *left, object::Object *right);
+ast::InfixForm infixForm(const std::string &oper, object::Object *left, object::Object *right);
+object::Result evalIfExpression(ast::IfExpression *ifExpression, object::Environment *env);
+object::Result evalAssignExpression(ast::AssignExpression *assign, object::Environment *env);
+object::Result assignVariable(ast::Identifier *ident, object::Object *value, object::Environment *env);
+object::Result assignIndex(object::Object *left, object::Object *index, object::Object *value);
+object::Result evalWhileStatement(ast::WhileStatement *loop, object::Environment *env);
+object::Result evalForStatement(ast::ForStatement *loop, object::Environment *env);
+object::Object *loopSource(object::Object *iterable);
+object::Result loopNext(object::Object *source, size_t position, object::Object *previous);
+object::Result iteratorNext(object::Iterator *it);
+object::Iterator *toIterator(object::Object *iterable);
+object::Result evalIdentifier(ast::Identifier *ident, object::Environment *env);
+object::Result evalLocal(ast::Expression *operand, object::Environment *env);
+object::Result evalFusedInfix(ast::InfixExpression *node, object::Environment *env);
+object::Result evalFusedIndex(ast::IndexExpression *node, object::Environment *env);
+object::Result evalFusedCall(ast::CallExpression *call, object::Environment *env);
+object::Result evalCallExpression(ast::CallExpression *call, object::Object *func, object::Environment *env);
+object::Result evalTailCall(ast::CallExpression *call, object::Object *func, object::Environment *env);
+object::Result applyFunction(object::Object *func, object::Args args);
+object::Result applyBuiltin(object::Builtin *builtin, object::Args args);
+object::Environment *extendFunctionEnvironment(object::Function *func, object::Args args);
+void initFrame(object::Environment *frame, object::Function *func, object::Args args);
+object::Function *makeClosure(const std::shared_ptr<const object::FunctionPrototype> &prototype,
+                              object::Environment *env);
+void bindVariable(const ast::Binding &binding, const std::string &name, object::Object *value,
+                  object::Environment *env);
 bool isTruthy(object::Object *object);
-template <typename... Args> object::Error *newError(const std::string &format, Args &&...args);
-bool isError(object::Object *object);
-std::vector<object::Object *> evalExpression(std::vector<ast::Expression *> exps, object::Environment *env);
-object::Object *unwrapReturnValue(object::Object *obj);
-object::Object *evalIndexExpression(object::Object *left, object::Object *index);
+// Records the error's code and operands in lastError; the message is only
+// formatted if the error reaches eval().
+template <typename... Args> object::Result newError(object::ErrorCode code, Args &&...args) {
+    lastError = object::ErrorInfo(code, std::forward<Args>(args)...);
+    return object::Result::error();
+}
+object::Result setAlgebra(object::Args args, const char *name,
+                          object::Set *(*combine)(const object::Set *, const object::Set *));
+object::Result evalExpression(const std::vector<std::unique_ptr<ast::Expression>> &exps, object::Environment *env,
+                              std::vector<object::Object *> &out);
+object::Result unwrapReturnValue(object::Result result);
+object::Result evalIndexExpression(object::Object *left, object::Object *index);
 object::Object *evalArrayIndexExpression(object::Object *array, object::Object *index);
-object::Object *lenFunction(const std::vector<object::Object*>& args);
-object::Object *firstFunction(const std::vector<object::Object*>& args);
-object::Object *lastFunction(const std::vector<object::Object*>& args);
-object::Object *restFunction(const std::vector<object::Object*>& args);
-object::Object *pushFunction(const std::vector<object::Object*>& args);
-object::Object *putsFunction(const std::vector<object::Object*>& args);
-object::Object *evalHashLiteral(ast::HashLiteral *hash, object::Environment *env);
-object::Object *evalHashIndexExpression(object::Object *hash, object::Object *index);
+object::Result lenFunction(object::Args args);
+object::Result firstFunction(object::Args args);
+object::Result lastFunction(object::Args args);
+object::Result restFunction(object::Args args);
+object::Result pushFunction(object::Args args);
+object::Result putsFunction(object::Args args);
+object::Result builderFunction(object::Args args);
+object::Result appendFunction(object::Args args);
+object::Result buildFunction(object::Args args);
+object::Result setFunction(object::Args args);
+object::Result addFunction(object::Args args);
+object::Result hasFunction(object::Args args);
+object::Result removeFunction(object::Args args);
+object::Result unionFunction(object::Args args);
+object::Result intersectFunction(object::Args args);
+object::Result differenceFunction(object::Args args);
+object::Result rangeFunction(object::Args args);
+object::Result pipelineStage(object::Args args, const char *name, object::Iterator::Stage stage);
+object::Result mapFunction(object::Args args);
+object::Result filterFunction(object::Args args);
+object::Result takeFunction(object::Args args);
+object::Result zipFunction(object::Args args);
+object::Result reduceFunction(object::Args args);
+object::Result collectFunction(object::Args args);
+object::Result evalHashLiteral(ast::HashLiteral *hash, object::Environment *env);
+object::Result evalHashIndexExpression(object::Object *hash, object::Object *index);
+object::Result evalCachedIndexExpression(ast::IndexExpression *node, object::Object *left, object::Object *index);
 
 } // namespace evaluator
@@ -0,0 +1,109 @@
+#pragma once
+#include "evaluator/FunctionProfile.h"
+#include "evaluator/evaluator.h"
+#include "object/Array.h"
+#include "object/Error.h"
+#include "object/Function.h"
+#include "object/FunctionPrototype.h"
+#include "object/Hash.h"
+#include "object/Hashable.h"
+#include "object/Integer.h"
+#include "object/String.h"
+#include "object/object.h"
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace monkeyc {
+// What the C++ that monkeyc generates (see Transpiler.h) calls, besides the
+// evaluator's own runtime functions and builtins. The generated program is
+// linked against libmonkey.a, the interpreter without its main().
+
+// A closure of a compiled function. Its prototype has an entry instead of
+// an AST, so the closure keeps the source text inspect() shows.
+class CompiledFunction : public object::Function {
+  public:
+    const char *text;
+
+    CompiledFunction(std::shared_ptr<const object::FunctionPrototype> prototype, const char *text)
+        : object::Function(std::move(prototype), nullptr), text(text) {};
+    std::string inspect() const override { return text; }
+};
+
+enum class Operator { ADD, SUB, MUL, DIV, LT, GT, EQ, NE };
+// The operator as the evaluator spells it; the string outlives any error.
+const std::string &operatorString(Operator oper);
+
+// Unboxed arithmetic wraps around like the interpreter's, without relying
+// on signed overflow, which the C++ compiler may assume never happens.
+inline int add(int left, int right) { return static_cast<int>(static_cast<unsigned>(left) + right); }
+inline int sub(int left, int right) { return static_cast<int>(static_cast<unsigned>(left) - right); }
+inline int mul(int left, int right) { return static_cast<int>(static_cast<unsigned>(left) * right); }
+inline int neg(int value) { return static_cast<int>(0u - value); }
+
+template <Operator oper> object::Object *integerInfix(int left, int right) {
+    switch (oper) {
+    case Operator::ADD:
+        return new object::Integer(add(left, right));
+    case Operator::SUB:
+        return new object::Integer(sub(left, right));
+    case Operator::MUL:
+        return new object::Integer(mul(left, right));
+    case Operator::DIV:
+        return new object::Integer(left / right);
+    case Operator::LT:
+        return evaluator::nativeBoolToBooleanObject(left < right);
+    case Operator::GT:
+        return evaluator::nativeBoolToBooleanObject(left > right);
+    case Operator::EQ:
+        return evaluator::nativeBoolToBooleanObject(left == right);
+    case Operator::NE:
+        return evaluator::nativeBoolToBooleanObject(left != right);
+    }
+    return nullptr;
+}
+
+inline bool isInteger(object::Object *object) { return object->type() == object::ObjectType::INTEGER_OBJ; }
+inline int intValue(object::Object *integer) { return static_cast<object::Integer *>(integer)->value; }
+
+// An infix operator on operands whose types were not proven: the integer
+// case inline, anything else through evalInfixExpression. An operand that
+// was proven an integer is passed unboxed and boxed only on the slow path.
+template <Operator oper> object::Result infix(object::Object *left, object::Object *right) {
+    if (isInteger(left) && isInteger(right)) {
+        return integerInfix<oper>(intValue(left), intValue(right));
+    }
+    return evaluator::evalInfixExpression(operatorString(oper), left, right);
+}
+
+template <Operator oper> object::Result infix(object::Object *left, int right) {
+    if (isInteger(left)) {
+        return integerInfix<oper>(intValue(left), right);
+    }
+    return evaluator::evalInfixExpression(operatorString(oper), left, new object::Integer(right));
+}
+
+template <Operator oper> object::Result infix(int left, object::Object *right) {
+    if (isInteger(right)) {
+        return integerInfix<oper>(left, intValue(right));
+    }
+    return evaluator::evalInfixExpression(operatorString(oper), new object::Integer(left), right);
+}
+
+// Completes a direct call of a compiled function, which may have ended in
+// a tail call for applyFunction to run.
+inline object::Result finish(object::Result result) {
+    if (result.isTailCall()) {
+        return evaluator::applyFunction(
+            result.value, object::Args{evaluator::tailArguments.data(), evaluator::tailArguments.size()});
+    }
+    return result;
+}
+
+// Raises the error for reading or assigning an unbound `name`.
+object::Result notFound(const std::string &name);
+// Prints what the interpreter prints at the end of a script and returns
+// its exit status.
+int report(object::Result result);
+
+} // namespace monkeyc
@@ -0,0 +1,25 @@
+#pragma once
+#include "ast/Program.h"
+#include <string>
+
+namespace monkeyc {
+// Ahead-of-time compilation: a whole program is translated to one C++
+// translation unit, which includes monkeyc/Runtime.h and links against
+// libmonkey.a. Every function literal becomes a C++ function installed as
+// its profile's entry, so applyFunction (and with it map, filter and the
+// other builtins) calls compiled code; the top-level statements become the
+// generated main(). Objects, builtins and error reporting are the
+// interpreter's own, so the program prints what the interpreter would.
+//
+// Variables are bound the way the resolver binds them: a function's locals
+// and cells are C++ locals, captured variables are the closure's upvalues,
+// and globals are C++ variables. Locals that evaluator::inferTypes proved
+// integers, parameters included, are kept as unboxed ints, and arithmetic
+// and comparisons it proved integer compile to plain C++ arithmetic with no
+// type checks. A call to the running function itself is a direct C++ call,
+// and one in tail position a jump.
+//
+// Runs inferTypes on `program`, which must have parsed without errors.
+std::string transpile(ast::Program *program);
+
+} // namespace monkeyc
@@ -7,10 +7,9 @@
 namespace object {
 class Array : public Object {
   public:
-    ObjectType objectType = ObjectType::ARRAY_OBJ;
     std::vector<Object *> elements;
 
-    ObjectType type() const override;
+    Array() : Object(ObjectType::ARRAY_OBJ) {};
     std::string inspect() const override;
     std::string typeToString() const override;
 };
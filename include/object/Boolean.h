@@ -4,16 +4,14 @@
 #include <string>
 
 namespace object {
-class Boolean : public Object, public Hashable {
+class Boolean : public Object {
   public:
-    ObjectType objectType = ObjectType::BOOLEAN_OBJ;
     bool value;
 
-    Boolean(bool value) : value(value) {};
-    ObjectType type() const override;
+    Boolean(bool value) : Object(ObjectType::BOOLEAN_OBJ), value(value) {};
     std::string inspect() const override;
     std::string typeToString() const override;
-    HashKey hashKey() const override;
+    HashKey hashKey() const;
 };
 
 } // namespace object
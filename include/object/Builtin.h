@@ -5,11 +5,9 @@
 namespace object {
 class Builtin : public Object {
   public:
-    ObjectType objectType = ObjectType::BUILTIN_OBJ;
     BuiltinFunction fn;
 
-    Builtin(BuiltinFunction fn) : fn(fn) {};
-    ObjectType type() const override;
+    Builtin(BuiltinFunction fn) : Object(ObjectType::BUILTIN_OBJ), fn(fn) {};
     std::string inspect() const override;
     std::string typeToString() const override;
 };
@@ -0,0 +1,12 @@
+#pragma once
+#include "object/object.h"
+
+namespace object {
+// A boxed variable. Locals that an inner function captures live in a Cell
+// instead of a frame slot, so the frame and every closure that captured the
+// variable see the same value.
+struct Cell {
+    Object *value = nullptr;
+};
+
+} // namespace object
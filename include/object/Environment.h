@@ -1,21 +1,35 @@
 #pragma once
+#include "object/Cell.h"
 #include "object/object.h"
 #include <map>
 #include <memory>
 #include <string>
 #include <tuple>
+#include <vector>
 
 namespace object {
+class Function;
+
 class Environment {
   public:
-    std::map<std::string, std::unique_ptr<Object>> store;
+    // objects are shared and never freed, so the scope does not own them
+    std::map<std::string, Object *> store;
     Environment *outer;
 
+    // Set only for a function call frame, whose outer is the global scope:
+    // the closure being called, its uncaptured locals, and the cells of the
+    // locals its inner functions capture. See evaluator/Resolver.h.
+    Function *closure = nullptr;
+    std::vector<Object *> slots;
+    std::vector<Cell *> cells;
+
     Environment() : outer(nullptr) {};
     Environment(Environment *outer) : outer(outer) {};
     ~Environment() = default;
-    Object *get(std::string &name);
-    Object *set(std::string name, std::unique_ptr<Object> value);
+    Object *get(const std::string &name);
+    Object *set(const std::string &name, Object *value);
+    // rebinds `name` in the innermost scope that has it; false if none does
+    bool assign(const std::string &name, Object *value);
 };
 
 } // namespace object
@@ -3,13 +3,61 @@
 #include <string>
 
 namespace object {
+enum class ErrorCode {
+    UNKNOWN_OPERATOR,
+    TYPE_MISMATCH,
+    IDENTIFIER_NOT_FOUND,
+    NOT_A_FUNCTION,
+    WRONG_ARGUMENT_COUNT,
+    TOO_FEW_ARGUMENTS,
+    ARGUMENT_NOT_SUPPORTED,
+    ARGUMENT_TYPE,
+    UNUSABLE_AS_HASH_KEY,
+    UNUSABLE_AS_SET_MEMBER,
+    INDEX_NOT_SUPPORTED,
+    INDEX_OUT_OF_RANGE,
+    NOT_ITERABLE,
+    ZERO_STEP,
+    BUDGET_EXCEEDED,
+};
+
+// A compact description of a runtime error: a code plus the operands needed
+// to describe it. Nothing is formatted until message() is called, so raising
+// an error costs a few stores. `text` and `name` must outlive the ErrorInfo
+// (string literals or strings owned by the AST).
+struct ErrorInfo {
+    ErrorCode code;
+    const char *text = "";
+    const char *expected = "";
+    const std::string *name = nullptr;
+    const Object *left = nullptr;
+    const Object *right = nullptr;
+    long want = 0;
+    long got = 0;
+
+    ErrorInfo() : code(ErrorCode::UNKNOWN_OPERATOR) {};
+    // operator and unusable-value errors
+    ErrorInfo(ErrorCode code, const char *text, const Object *left, const Object *right = nullptr)
+        : code(code), text(text), left(left), right(right) {};
+    // builtin argument type errors
+    ErrorInfo(ErrorCode code, const char *text, const char *expected, const Object *left)
+        : code(code), text(text), expected(expected), left(left) {};
+    // identifier errors
+    ErrorInfo(ErrorCode code, const std::string *name) : code(code), name(name) {};
+    // argument count errors, where a non-empty `text` replaces `want` in the
+    // message; BUDGET_EXCEEDED puts the budget in `want`, INDEX_OUT_OF_RANGE
+    // the index in `want` and the length in `got`
+    ErrorInfo(ErrorCode code, long want, long got, const char *text = "")
+        : code(code), text(text), want(want), got(got) {};
+
+    std::string message() const;
+};
+
 class Error : public Object {
   public:
-    ObjectType objectType = ObjectType::ERROR_OBJ;
     std::string message;
 
-    Error(std::string message) : message(message) {};
-    ObjectType type() const override;
+    Error(std::string message) : Object(ObjectType::ERROR_OBJ), message(message) {};
     std::string inspect() const override;
     std::string typeToString() const override;
 };
@@ -1,21 +1,24 @@
 #pragma once
-#include "ast/BlockStatement.h"
-#include "ast/Identifier.h"
+#include "object/Cell.h"
 #include "object/Environment.h"
+#include "object/FunctionPrototype.h"
 #include "object/object.h"
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace object {
 class Function : public Object {
   public:
-    ObjectType objectType = ObjectType::FUNCTION_OBJ;
-    std::vector<std::unique_ptr<ast::Identifier>> parameters;
-    std::unique_ptr<ast::BlockStatement > body;
-    Environment *env;
+    std::shared_ptr<const FunctionPrototype> prototype;
+    // where names the function does not bind are looked up
+    Environment *globals;
+    // the variables the function captured, in the order of prototype->captures
+    std::vector<Cell *> upvalues;
 
-    ObjectType type() const override;
+    Function(std::shared_ptr<const FunctionPrototype> prototype, Environment *globals)
+        : Object(ObjectType::FUNCTION_OBJ), prototype(std::move(prototype)), globals(globals) {};
     std::string inspect() const override;
     std::string typeToString() const override;
 };
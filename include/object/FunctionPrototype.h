@@ -0,0 +1,59 @@
+#pragma once
+#include "ast/BlockStatement.h"
+#include "ast/Identifier.h"
+#include "object/object.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace object {
+
+// The immutable, shareable part of a function: what the resolver produces
+// once per FunctionLiteral. Every closure created from the same literal
+// points at the same prototype, so creating a closure only copies a pointer
+// and the closure's captured cells. The prototype keeps the body alive
+// after the program that contained the literal is gone (the REPL drops each
+// line's AST). What changes as the function runs is kept by the evaluator,
+// keyed by `id` (see evaluator/FunctionProfile.h).
+class FunctionPrototype {
+  public:
+    // How a new closure fills one of its upvalues: from a cell of the frame
+    // it is created in, or by sharing one of that frame's closure's upvalues.
+    struct Capture {
+        bool fromCell;
+        int index;
+    };
+
+    const std::vector<std::string> parameters;
+    // where each parameter is stored in a call frame
+    const std::vector<ast::Binding> parameterBindings;
+    const std::shared_ptr<ast::BlockStatement> body;
+    const std::vector<Capture> captures;
+    // number of parameters
+    const std::size_t arity;
+    // uncaptured locals, kept directly in the frame
+    const std::size_t slotCount;
+    // captured locals, boxed in cells
+    const std::size_t cellCount;
+    // number of distinct names a call binds: parameters plus every `let`
+    // and loop variable in the body outside nested functions
+    const std::size_t frameSize;
+
+    // numbers prototypes in the order they are made; never reused
+    const std::size_t id;
+
+    FunctionPrototype(std::vector<std::string> parameters, std::vector<ast::Binding> parameterBindings,
+                      std::shared_ptr<ast::BlockStatement> body, std::vector<Capture> captures,
+                      std::size_t slotCount, std::size_t cellCount)
+        : parameters(std::move(parameters)), parameterBindings(std::move(parameterBindings)), body(std::move(body)),
+          captures(std::move(captures)), arity(this->parameters.size()), slotCount(slotCount), cellCount(cellCount),
+          frameSize(slotCount + cellCount), id(nextId++) {};
+
+  private:
+    inline static std::atomic<std::size_t> nextId{0};
+};
+
+} // namespace object
@@ -1,22 +1,72 @@
 #pragma once
 #include "object/object.h"
 #include "object/Hashable.h"
+#include "object/Shape.h"
+#include <cstddef>
+#include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 namespace object {
 struct HashPair {
     Object* key;
     Object* value;
 };
+// A Hash picks its representation from the keys it receives:
+//  - RECORD: every key is an interned string, as string literals are;
+//    values live in `slots` at the positions given by `shape`. A computed
+//    string key that is not already in the shape makes the hash GENERAL, so
+//    keys built at runtime never reach the intern table or the shape tree.
+//  - DENSE: every key is a small non-negative integer; `slots[k]` holds the
+//    value for key k and `present` is a bitmap of the keys that are set.
+//  - GENERAL: anything else; keys and values live in `pairs`. Distinct keys
+//    whose HashKeys collide are kept side by side under the same HashKey
+//    and told apart with keysEqual.
+// An empty hash starts as a record. A key that does not fit the current
+// representation moves the hash to GENERAL, which is never left again.
 class Hash : public Object {
   public:
-    ObjectType objectType = ObjectType::HASH_OBJ;
-    std::map<HashKey, HashPair> pairs;
+    enum class Representation { RECORD, DENSE, GENERAL };
 
-    ObjectType type() const override;
+    Representation representation = Representation::RECORD;
+    std::multimap<HashKey, HashPair> pairs;
+    Shape *shape = Shape::root();
+    std::vector<Object *> slots;
+    std::vector<std::uint64_t> present;
+
+    Hash() : Object(ObjectType::HASH_OBJ) {};
     std::string inspect() const override;
     std::string typeToString() const override;
+    bool isRecord() const { return representation == Representation::RECORD; }
+    bool isDense() const { return representation == Representation::DENSE; }
+    std::size_t size() const;
+    // key must be hashable; returns nullptr when the key is absent
+    Object *get(Object *key) const;
+    Object *getDense(int key) const {
+        if (key < 0 || static_cast<std::size_t>(key) >= slots.size() || !(present[key / 64] >> (key % 64) & 1)) {
+            return nullptr;
+        }
+        return slots[key];
+    }
+    void set(Object *key, Object *value);
+    // Walks the keys without copying them: returns the first key when
+    // `previous` is nullptr, otherwise the key after `previous`, and nullptr
+    // after the last one.
+    Object *keyAfter(const Object *previous) const;
+
+  private:
+    // a dense hash may span at most max(DENSE_MIN_SPAN, DENSE_FACTOR * size) keys
+    static constexpr std::size_t DENSE_MIN_SPAN = 64;
+    static constexpr std::size_t DENSE_FACTOR = 4;
+
+    std::size_t denseCount_ = 0;
+
+    bool fitsDense(int key) const;
+    void setDense(int key, Object *value);
+    void generalize();
+    // the pair holding `key` in `pairs`, or pairs.end()
+    std::multimap<HashKey, HashPair>::const_iterator findPair(const Object *key) const;
 };
 
 } // namespace object
@@ -1,12 +1,14 @@
 #pragma once
 #include "object/object.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 
 namespace object {
 struct HashKey {
     ObjectType type;
-    int value;
+    // an integer's value, 0 or 1 for a boolean, a string's full hash
+    std::int64_t value;
     bool operator<(const HashKey& other) const {
         if (type != other.type){
             return type < other.type;
@@ -14,9 +16,17 @@ struct HashKey {
         return value < other.value;
     }
 };
-class Hashable {
-  public:
-    virtual HashKey hashKey() const = 0;
-};
+// Integers, booleans and strings can be used as hash keys and set members.
+// Hashability is decided by the type tag; hashKey() dispatches on it.
+inline bool isHashable(const Object *object) {
+    ObjectType type = object->type();
+    return type == ObjectType::INTEGER_OBJ || type == ObjectType::BOOLEAN_OBJ || type == ObjectType::STRING_OBJ;
+}
+
+// object must be hashable
+HashKey hashKey(const Object *object);
+
+// Confirms that two objects with the same HashKey really are the same key.
+bool keysEqual(const Object *left, const Object *right);
 
 } // namespace object
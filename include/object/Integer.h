@@ -4,16 +4,14 @@
 #include <string>
 
 namespace object {
-class Integer : public Object, public Hashable {
+class Integer : public Object {
   public:
-    ObjectType objectType = ObjectType::INTEGER_OBJ;
     int value;
 
-    Integer(int value) : value(value) {};
-    ObjectType type() const override;
+    Integer(int value) : Object(ObjectType::INTEGER_OBJ), value(value) {};
     std::string inspect() const override;
     std::string typeToString() const override;
-    HashKey hashKey() const override;
+    HashKey hashKey() const;
 };
 
 } // namespace object
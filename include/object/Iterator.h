@@ -0,0 +1,37 @@
+#pragma once
+#include "object/object.h"
+#include <cstddef>
+#include <string>
+
+namespace object {
+// One stage of a lazy pipeline. A SOURCE walks an iterable in place (see
+// evaluator::loopSource); the other stages pull from `upstream` one element
+// at a time, so a chain like map(filter(range(n), p), f) runs as a single
+// pass with no intermediate arrays. Iterators are single-use: pulling an
+// element consumes it. Pulling runs Monkey functions and so lives in the
+// evaluator (evaluator::iteratorNext); this class only holds the state.
+class Iterator : public Object {
+  public:
+    enum class Stage { SOURCE, MAP, FILTER, TAKE, ZIP };
+
+    const Stage stage;
+    // SOURCE: the iterable being walked
+    Object *source = nullptr;
+    // every other stage: where elements come from; ZIP pairs them with `other`
+    Iterator *upstream = nullptr;
+    Iterator *other = nullptr;
+    // MAP and FILTER: the function applied to each element
+    Object *function = nullptr;
+    // TAKE: how many elements to let through
+    std::size_t limit = 0;
+
+    // SOURCE cursor, and the number of elements TAKE has passed on
+    std::size_t position = 0;
+    Object *previous = nullptr;
+
+    explicit Iterator(Stage stage) : Object(ObjectType::ITERATOR_OBJ), stage(stage) {};
+    std::string inspect() const override;
+    std::string typeToString() const override;
+};
+
+} // namespace object
@@ -5,9 +5,7 @@
 namespace object {
 class Null : public Object {
   public:
-    ObjectType objectType = ObjectType::NULL_OBJ;
-
-    ObjectType type() const override;
+    Null() : Object(ObjectType::NULL_OBJ) {};
     std::string inspect() const override;
     std::string typeToString() const override;
 };
@@ -0,0 +1,23 @@
+#pragma once
+#include "object/object.h"
+#include <cstddef>
+#include <string>
+
+namespace object {
+// The integers from `start` up to (or, with a negative step, down to) `end`,
+// exclusive. Loops walk a range without materializing it.
+class Range : public Object {
+  public:
+    const int start;
+    const int end;
+    const int step;
+
+    Range(int start, int end, int step) : Object(ObjectType::RANGE_OBJ), start(start), end(end), step(step) {};
+    std::string inspect() const override;
+    std::string typeToString() const override;
+    std::size_t size() const;
+    // the i-th integer of the range; i must be less than size()
+    int at(std::size_t i) const { return start + static_cast<int>(i) * step; }
+};
+
+} // namespace object
@@ -0,0 +1,54 @@
+#pragma once
+#include "object/Hashable.h"
+#include "object/object.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace object {
+// A Set of hashable values. While every member is an integer in
+// [0, BITSET_LIMIT) the set is a word-packed bitset, so membership is a bit
+// test, size is a popcount and set algebra works a machine word at a time.
+// The first member outside that range moves the set to an open-addressing
+// table with linear probing.
+class Set : public Object {
+  public:
+    static constexpr int BITSET_LIMIT = 1 << 16;
+
+    Set() : Object(ObjectType::SET_OBJ) {};
+    std::string inspect() const override;
+    std::string typeToString() const override;
+    bool isBitset() const { return bitset_; }
+    std::size_t size() const;
+    // members must be hashable
+    bool has(Object *member) const;
+    void add(Object *member);
+    void remove(Object *member);
+    std::vector<Object *> members() const;
+
+    static Set *unionOf(const Set *left, const Set *right);
+    static Set *intersectionOf(const Set *left, const Set *right);
+    static Set *differenceOf(const Set *left, const Set *right);
+
+  private:
+    struct Entry {
+        Object *member;
+        std::size_t hash;
+    };
+
+    bool bitset_ = true;
+    std::vector<std::uint64_t> bits_;
+    std::vector<Entry> table_;
+    std::size_t count_ = 0;
+    std::size_t used_ = 0;
+
+    static bool fitsBitset(const Object *member, int &value);
+    static std::size_t hashOf(const Object *member);
+    std::size_t findSlot(const Object *member, std::size_t hash) const;
+    void insertEntry(Object *member, std::size_t hash);
+    void growTable();
+    void convertToTable();
+};
+
+} // namespace object
@@ -0,0 +1,33 @@
+#pragma once
+#include "object/String.h"
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace object {
+// A Shape (hidden class) describes the ordered string keys of a record-like
+// hash and maps each key to an index in the hash's slot array. Shapes form a
+// transition tree rooted at root(): hashes that receive the same keys in the
+// same order share the same Shape, so a shape pointer comparison is enough to
+// know where a key lives.
+class Shape {
+  public:
+    static constexpr std::size_t MAX_KEYS = 32;
+
+    static Shape *root();
+    Shape *withKey(String *key);
+    int slotOf(const String *key) const;
+    const std::vector<String *> &keys() const { return keys_; }
+    std::size_t size() const { return keys_.size(); }
+
+  private:
+    Shape() = default;
+
+    // keys are interned, so they can be looked up by address
+    std::vector<String *> keys_;
+    std::unordered_map<const String *, int> slots_;
+    std::unordered_map<const String *, std::unique_ptr<Shape>> transitions_;
+};
+
+} // namespace object
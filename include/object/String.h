@@ -1,19 +1,49 @@
 #pragma once
 #include "object/Hashable.h"
 #include "object/object.h"
+#include <cstddef>
 #include <string>
+#include <string_view>
 
 namespace object {
-class String : public Object, public Hashable {
+// A String is either flat (it owns its characters) or a rope node that
+// concatenates two other strings. Rope nodes are flattened lazily the first
+// time their characters are needed, so `a + b` is O(1) regardless of length.
+//
+// Strings returned by intern() are unique per content, which lets key
+// equality fall back to a pointer comparison when both sides are interned.
+class String : public Object {
   public:
-    ObjectType objectType = ObjectType::STRING_OBJ;
-    std::string value;
-
-    String(std::string value) : value(value) {};
-    ObjectType type() const override;
+    String(std::string value) : Object(ObjectType::STRING_OBJ), value_(std::move(value)), length_(value_.size()) {};
+    String(const String *left, const String *right);
     std::string inspect() const override;
     std::string typeToString() const override;
-    HashKey hashKey() const override;
+    HashKey hashKey() const;
+    const std::string &value() const;
+    std::size_t length() const { return length_; }
+    bool isFlat() const { return left_ == nullptr; }
+    bool isInterned() const { return interned_; }
+    bool equals(const String *other) const;
+
+    static String *intern(const std::string &value);
+    // Hashes a string's characters. Tests replace it to force collisions.
+    static std::size_t (*hasher)(std::string_view value);
+
+  private:
+    // concatenations shorter than this are copied eagerly instead of building a rope node
+    static constexpr std::size_t ROPE_THRESHOLD = 64;
+
+    mutable std::string value_;
+    std::size_t length_;
+    mutable const String *left_ = nullptr;
+    mutable const String *right_ = nullptr;
+    mutable std::size_t hash_ = 0;
+    mutable bool hashed_ = false;
+    bool interned_ = false;
+
+    std::size_t hash() const;
+
+    void flatten() const;
 };
 
 } // namespace object
@@ -0,0 +1,15 @@
+#pragma once
+#include "object/object.h"
+#include <string>
+
+namespace object {
+class StringBuilder : public Object {
+  public:
+    std::string buffer;
+
+    StringBuilder() : Object(ObjectType::BUILDER_OBJ) {};
+    std::string inspect() const override;
+    std::string typeToString() const override;
+};
+
+} // namespace object
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -9,20 +10,69 @@ enum class ObjectType {
     INTEGER_OBJ,
     BOOLEAN_OBJ,
     NULL_OBJ,
-    RETURN_VALUE,
     ERROR_OBJ,
     FUNCTION_OBJ,
     STRING_OBJ,
     BUILTIN_OBJ,
     ARRAY_OBJ,
     HASH_OBJ,
+    BUILDER_OBJ,
+    SET_OBJ,
+    RANGE_OBJ,
+    ITERATOR_OBJ,
 };
-using BuiltinFunction = Object* (*)(const std::vector<Object *>& args);
 
+// A non-owning (pointer, count) view of the arguments of a call. The storage
+// belongs to the caller and is only valid for the duration of the call.
+struct Args {
+    Object *const *data;
+    std::size_t count;
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    Object *operator[](std::size_t i) const { return data[i]; }
+    Object *const *begin() const { return data; }
+    Object *const *end() const { return data + count; }
+};
+
+// What evaluating a node or calling a function produced. A RETURN result is
+// a `return` still unwinding to its function; an ERROR result means the
+// error's details are in evaluator::lastError. A TAIL_CALL result carries the
+// function a call in tail position wants to call, unwinding to the caller's
+// applyFunction, which runs it in the same frame (the arguments wait in
+// evaluator::tailArguments). None is boxed in a heap object, so control
+// flow costs no allocation. BREAK and CONTINUE unwind to the innermost loop,
+// which the parser guarantees exists in the same function.
+struct Result {
+    enum class Status : unsigned char { VALUE, RETURN, ERROR, TAIL_CALL, BREAK, CONTINUE };
+
+    Object *value;
+    Status status;
+
+    // implicit, so code that produces a plain value can keep returning Object *
+    Result(Object *value) : value(value), status(Status::VALUE) {};
+    Result(Object *value, Status status) : value(value), status(status) {};
+    static Result error() { return Result(nullptr, Status::ERROR); }
+    bool isError() const { return status == Status::ERROR; }
+    bool isReturn() const { return status == Status::RETURN; }
+    bool isTailCall() const { return status == Status::TAIL_CALL; }
+    bool isBreak() const { return status == Status::BREAK; }
+    bool isContinue() const { return status == Status::CONTINUE; }
+    // true for everything but VALUE: evaluation of the enclosing node must stop
+    bool isAbrupt() const { return status != Status::VALUE; }
+};
+using BuiltinFunction = Result (*)(Args args);
+
+// The type tag lives in the base class and is fixed at construction, so
+// type checks are a plain load and compare rather than a virtual call or a
+// dynamic_cast. Once the tag is checked, downcast with static_cast.
 class Object {
   public:
+    const ObjectType objectType;
+
+    explicit Object(ObjectType objectType) : objectType(objectType) {};
     virtual ~Object() = default;
-    virtual ObjectType type() const = 0;
+    ObjectType type() const { return objectType; }
     virtual std::string inspect() const = 0;
     virtual std::string typeToString() const = 0;
 };
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "ast/BlockStatement.h"
+#include "ast/BreakStatement.h"
+#include "ast/ContinueStatement.h"
 #include "ast/Expression.h"
 #include "ast/ExpressionStatement.h"
+#include "ast/ForStatement.h"
 #include "ast/Identifier.h"
 #include "ast/InfixExpression.h"
 #include "ast/LetStatement.h"
@@ -10,6 +13,7 @@
 #include "ast/Program.h"
 #include "ast/ReturnStatement.h"
 #include "ast/Statement.h"
+#include "ast/WhileStatement.h"
 #include "lexer.h"
 #include "token.h"
 #include <cstddef>
@@ -25,18 +29,21 @@ class Parser {
     Parser(std::unique_ptr<lexer::Lexer> lexer);
     std::unique_ptr<ast::Program> parseProgram();
     std::vector<std::string> *errors();
-    enum class Precedence { LOWEST = 0, EQUALS, LESSGREATER, SUM, PRODUCT, PREFIX, CALL, INDEX};
+    enum class Precedence { LOWEST = 0, ASSIGN, EQUALS, LESSGREATER, SUM, PRODUCT, PREFIX, CALL, INDEX};
 
   private:
     std::unique_ptr<lexer::Lexer> lexer_;
     token::Token currentToken_;
     token::Token peekToken_;
     std::vector<std::string> errors_;
+    // number of loops around the current token within the current function
+    int loopDepth_ = 0;
     using prefixParseFn = std::function<std::unique_ptr<ast::Expression>()>;
     using infixParseFn = std::function<std::unique_ptr<ast::Expression>(std::unique_ptr<ast::Expression>)>;
     std::map<token::TokenType, prefixParseFn> prefixParseFns;
     std::map<token::TokenType, infixParseFn> infixParseFns;
     std::map<token::TokenType, Precedence> precedences_ = {
+        {token::TokenType::ASSIGN, Precedence::ASSIGN},
         {token::TokenType::EQ, Precedence::EQUALS},
         {token::TokenType::NOT_EQ, Precedence::EQUALS},
         {token::TokenType::LT, Precedence::LESSGREATER},
@@ -54,9 +61,14 @@ class Parser {
     std::unique_ptr<ast::LetStatement> parseLetStatement();
     std::unique_ptr<ast::ReturnStatement> parseReturnStatement();
     std::unique_ptr<ast::ExpressionStatement> parseExpressionStatement();
+    std::unique_ptr<ast::WhileStatement> parseWhileStatement();
+    std::unique_ptr<ast::ForStatement> parseForStatement();
+    std::unique_ptr<ast::Statement> parseLoopControl();
+    std::unique_ptr<ast::BlockStatement> parseLoopBody();
     std::unique_ptr<ast::PrefixExpression> parsePrefixExpression();
     std::unique_ptr<ast::InfixExpression> parseInfixExpression(std::unique_ptr<ast::Expression> left);
     std::unique_ptr<ast::Expression> parseIndexExpression(std::unique_ptr<ast::Expression> left);
+    std::unique_ptr<ast::Expression> parseAssignExpression(std::unique_ptr<ast::Expression> target);
     bool curTokenIs(token::TokenType tokenType);
     bool peekTokenIs(token::TokenType tokenType);
     bool expectPeek(token::TokenType tokenType);
@@ -1,7 +1,9 @@
 #pragma once
 
+#include "evaluator/Engine.h"
 #include "lexer.h"
 #include "token.h"
+#include <istream>
 #include <ostream>
 #include <string>
 #include <vector>
@@ -23,7 +25,10 @@ const std::string MONKEY_FACE = R"(
 )";
 class REPL {
   public:
-    static void start(std::ostream &out);
+    static void start(std::ostream &out, evaluator::Engine engine = evaluator::Engine::TREE);
+    // Runs a whole script and prints its value; returns the process exit
+    // status, nonzero if it did not parse or ended in an error.
+    static int run(std::istream &in, std::ostream &out, evaluator::Engine engine);
 
   private:
     static void printParserErrors(std::ostream &out, std::vector<std::string> errors);
@@ -36,6 +36,11 @@ enum class TokenType {
     IF,
     ELSE,
     RETURN,
+    WHILE,
+    FOR,
+    IN,
+    BREAK,
+    CONTINUE,
 
     STRING,
 
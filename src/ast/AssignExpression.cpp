@@ -0,0 +1,14 @@
+#include "ast/AssignExpression.h"
+#include <sstream>
+#include <string>
+
+namespace ast {
+
+std::string AssignExpression::tokenLiteral() const { return token.literal; }
+
+std::string AssignExpression::toString() const {
+    std::stringstream ss;
+    ss << "(" << target->toString() << " = " << value->toString() << ")";
+    return ss.str();
+}
+} // namespace ast
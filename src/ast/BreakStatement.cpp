@@ -0,0 +1,10 @@
+#include "ast/BreakStatement.h"
+#include <string>
+
+namespace ast {
+
+std::string BreakStatement::tokenLiteral() const { return token.literal; }
+
+std::string BreakStatement::toString() const { return tokenLiteral() + ";"; }
+
+} // namespace ast
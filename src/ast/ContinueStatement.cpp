@@ -0,0 +1,10 @@
+#include "ast/ContinueStatement.h"
+#include <string>
+
+namespace ast {
+
+std::string ContinueStatement::tokenLiteral() const { return token.literal; }
+
+std::string ContinueStatement::toString() const { return tokenLiteral() + ";"; }
+
+} // namespace ast
@@ -0,0 +1,14 @@
+#include "ast/ForStatement.h"
+#include <sstream>
+#include <string>
+
+namespace ast {
+
+std::string ForStatement::tokenLiteral() const { return token.literal; }
+
+std::string ForStatement::toString() const {
+    std::stringstream ss;
+    ss << "for (" << variable->toString() << " in " << iterable->toString() << ") " << body->toString();
+    return ss.str();
+}
+} // namespace ast
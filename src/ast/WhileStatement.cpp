@@ -0,0 +1,14 @@
+#include "ast/WhileStatement.h"
+#include <sstream>
+#include <string>
+
+namespace ast {
+
+std::string WhileStatement::tokenLiteral() const { return token.literal; }
+
+std::string WhileStatement::toString() const {
+    std::stringstream ss;
+    ss << "while" << condition->toString() << " " << body->toString();
+    return ss.str();
+}
+} // namespace ast
@@ -0,0 +1,33 @@
+#include "evaluator/ArgumentStack.h"
+#include "object/object.h"
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace evaluator {
+
+object::Object **ArgumentStack::reserve(std::size_t count) {
+    if (chunks_.empty()) {
+        chunks_.emplace_back(std::max(CHUNK_SIZE, count));
+    }
+    if (used_ + count > chunks_[chunk_].size()) {
+        chunk_++;
+        used_ = 0;
+        if (chunk_ == chunks_.size()) {
+            chunks_.emplace_back(std::max(CHUNK_SIZE, count));
+        } else if (chunks_[chunk_].size() < count) {
+            // only reachable for calls with more than CHUNK_SIZE arguments
+            chunks_[chunk_].resize(count);
+        }
+    }
+    object::Object **base = chunks_[chunk_].data() + used_;
+    used_ += count;
+    return base;
+}
+
+void ArgumentStack::reset(Mark mark) {
+    chunk_ = mark.chunk;
+    used_ = mark.used;
+}
+
+} // namespace evaluator
@@ -0,0 +1,26 @@
+#include "evaluator/Bytecode.h"
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+namespace evaluator {
+
+const char *opcodeName(Opcode op) {
+    static const char *const names[] = {
+#define MONKEY_OPCODE_NAME(name) #name,
+        MONKEY_OPCODES(MONKEY_OPCODE_NAME)
+#undef MONKEY_OPCODE_NAME
+    };
+    return names[static_cast<int>(op)];
+}
+
+std::string disassemble(const CodeBlock &block) {
+    std::stringstream out;
+    for (std::size_t pc = 0; pc < block.code.size(); pc++) {
+        const Instruction &in = block.code[pc];
+        out << pc << '\t' << opcodeName(in.op) << ' ' << in.a << ' ' << in.b << ' ' << in.c << '\n';
+    }
+    return out.str();
+}
+
+} // namespace evaluator
@@ -0,0 +1,499 @@
+#include "evaluator/ClosureCompiler.h"
+#include "ast/ArrayLiteral.h"
+#include "ast/AssignExpression.h"
+#include "ast/BlockStatement.h"
+#include "ast/Boolean.h"
+#include "ast/BreakStatement.h"
+#include "ast/CallExpression.h"
+#include "ast/ContinueStatement.h"
+#include "ast/ExpressionStatement.h"
+#include "ast/ForStatement.h"
+#include "ast/FunctionLiteral.h"
+#include "ast/HashLiteral.h"
+#include "ast/IfExpression.h"
+#include "ast/IndexExpression.h"
+#include "ast/InfixExpression.h"
+#include "ast/IntegerLiteral.h"
+#include "ast/LetStatement.h"
+#include "ast/PrefixExpression.h"
+#include "ast/ReturnStatement.h"
+#include "ast/StringLiteral.h"
+#include "ast/WhileStatement.h"
+#include "evaluator/FunctionProfile.h"
+#include "evaluator/Resolver.h"
+#include "evaluator/evaluator.h"
+#include "object/Array.h"
+#include "object/Hash.h"
+#include "object/Hashable.h"
+#include "object/Integer.h"
+#include "object/String.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace evaluator {
+
+namespace {
+
+bool isInteger(object::Object *object) { return object->type() == object::ObjectType::INTEGER_OBJ; }
+
+int intValue(object::Object *integer) { return static_cast<object::Integer *>(integer)->value; }
+
+CompiledNode constant(object::Object *value) {
+    return [value](object::Environment *) -> object::Result { return value; };
+}
+
+// An infix operator with its integer case inline; anything else goes to
+// the generic evalInfixExpression. A right operand that is an integer
+// literal is bound as a C++ int.
+template <typename Operation>
+CompiledNode compileInfix(ast::InfixExpression *infix, CompiledNode left, Operation operation) {
+    const std::string &oper = infix->oper;
+    if (auto literal = dynamic_cast<ast::IntegerLiteral *>(infix->right.get())) {
+        int r = literal->valueInt;
+        object::Object *right = new object::Integer(r);
+        return [left, operation, r, right, &oper](object::Environment *env) -> object::Result {
+            object::Result l = left(env);
+            if (l.isAbrupt()) {
+                return l;
+            } else if (isInteger(l.value)) {
+                return operation(intValue(l.value), r);
+            }
+            return evalInfixExpression(oper, l.value, right);
+        };
+    }
+    CompiledNode right = compileClosure(infix->right.get());
+    return [left, right, operation, &oper](object::Environment *env) -> object::Result {
+        object::Result l = left(env);
+        if (l.isAbrupt()) {
+            return l;
+        }
+        object::Result r = right(env);
+        if (r.isAbrupt()) {
+            return r;
+        } else if (isInteger(l.value) && isInteger(r.value)) {
+            return operation(intValue(l.value), intValue(r.value));
+        }
+        return evalInfixExpression(oper, l.value, r.value);
+    };
+}
+
+CompiledNode compileInfix(ast::InfixExpression *infix) {
+    CompiledNode left = compileClosure(infix->left.get());
+    const std::string &oper = infix->oper;
+    if (oper == "+") {
+        return compileInfix(infix, left, [](int l, int r) -> object::Object * { return new object::Integer(l + r); });
+    } else if (oper == "-") {
+        return compileInfix(infix, left, [](int l, int r) -> object::Object * { return new object::Integer(l - r); });
+    } else if (oper == "*") {
+        return compileInfix(infix, left, [](int l, int r) -> object::Object * { return new object::Integer(l * r); });
+    } else if (oper == "/") {
+        return compileInfix(infix, left, [](int l, int r) -> object::Object * { return new object::Integer(l / r); });
+    } else if (oper == "<") {
+        return compileInfix(infix, left,
+                            [](int l, int r) -> object::Object * { return nativeBoolToBooleanObject(l < r); });
+    } else if (oper == ">") {
+        return compileInfix(infix, left,
+                            [](int l, int r) -> object::Object * { return nativeBoolToBooleanObject(l > r); });
+    } else if (oper == "==") {
+        return compileInfix(infix, left,
+                            [](int l, int r) -> object::Object * { return nativeBoolToBooleanObject(l == r); });
+    } else if (oper == "!=") {
+        return compileInfix(infix, left,
+                            [](int l, int r) -> object::Object * { return nativeBoolToBooleanObject(l != r); });
+    }
+    CompiledNode right = compileClosure(infix->right.get());
+    return [left, right, &oper](object::Environment *env) -> object::Result {
+        object::Result l = left(env);
+        if (l.isAbrupt()) {
+            return l;
+        }
+        object::Result r = right(env);
+        if (r.isAbrupt()) {
+            return r;
+        }
+        return evalInfixExpression(oper, l.value, r.value);
+    };
+}
+
+CompiledNode compileIdentifier(ast::Identifier *ident) {
+    int index = ident->binding.index;
+    switch (ident->binding.kind) {
+    case ast::BindingKind::LOCAL:
+        return [ident, index](object::Environment *env) -> object::Result {
+            object::Object *val = env->slots[index];
+            return val != nullptr ? val : evalIdentifier(ident, env);
+        };
+    case ast::BindingKind::CELL:
+        return [ident, index](object::Environment *env) -> object::Result {
+            object::Object *val = env->cells[index]->value;
+            return val != nullptr ? val : evalIdentifier(ident, env);
+        };
+    case ast::BindingKind::UPVALUE:
+        return [ident, index](object::Environment *env) -> object::Result {
+            object::Object *val = env->closure->upvalues[index]->value;
+            return val != nullptr ? val : evalIdentifier(ident, env);
+        };
+    case ast::BindingKind::GLOBAL:
+        break;
+    }
+    return [ident](object::Environment *env) { return evalIdentifier(ident, env); };
+}
+
+std::vector<CompiledNode> compileAll(const std::vector<std::unique_ptr<ast::Expression>> &expressions) {
+    std::vector<CompiledNode> compiled;
+    compiled.reserve(expressions.size());
+    for (const auto &expression : expressions) {
+        compiled.push_back(compileClosure(expression.get()));
+    }
+    return compiled;
+}
+
+// Evaluates the arguments into a block of the argument stack, as
+// evalCallExpression does. A call in tail position hands the callee back
+// to applyCompiled as a TAIL_CALL result.
+CompiledNode compileCall(ast::CallExpression *call) {
+    CompiledNode function = compileClosure(call->function.get());
+    std::vector<CompiledNode> arguments = compileAll(call->arguments);
+    bool tail = call->tail;
+    return [function, arguments, tail](object::Environment *env) -> object::Result {
+        object::Result func = function(env);
+        if (func.isAbrupt()) {
+            return func;
+        }
+        std::size_t count = arguments.size();
+        ArgumentStack::Mark mark = argumentStack.mark();
+        object::Object **argv = argumentStack.reserve(count);
+        for (std::size_t i = 0; i < count; i++) {
+            object::Result evaluated = arguments[i](env);
+            if (evaluated.isAbrupt()) {
+                argumentStack.reset(mark);
+                return evaluated;
+            }
+            argv[i] = evaluated.value;
+        }
+        if (tail) {
+            tailArguments.assign(argv, argv + count);
+            argumentStack.reset(mark);
+            return object::Result(func.value, object::Result::Status::TAIL_CALL);
+        }
+        object::Result result = applyCompiled(func.value, object::Args{argv, count});
+        argumentStack.reset(mark);
+        return result;
+    };
+}
+
+CompiledNode compileBlock(ast::BlockStatement *block) {
+    std::vector<CompiledNode> statements;
+    for (const auto &statement : block->statements) {
+        statements.push_back(compileClosure(statement.get()));
+    }
+    if (statements.size() == 1) {
+        return statements[0];
+    }
+    return [statements](object::Environment *env) -> object::Result {
+        object::Result result = nullptr;
+        for (const auto &statement : statements) {
+            result = statement(env);
+            if (result.isAbrupt()) {
+                return result;
+            }
+        }
+        return result;
+    };
+}
+
+CompiledNode compileIf(ast::IfExpression *ifExpression) {
+    CompiledNode condition = compileClosure(ifExpression->condition.get());
+    CompiledNode consequence = compileClosure(ifExpression->consiquence.get());
+    CompiledNode alternative = ifExpression->alternative != nullptr
+                                   ? compileClosure(ifExpression->alternative.get())
+                                   : constant(&NULL_OBJECT);
+    return [condition, consequence, alternative](object::Environment *env) -> object::Result {
+        object::Result test = condition(env);
+        if (test.isAbrupt()) {
+            return test;
+        }
+        return isTruthy(test.value) ? consequence(env) : alternative(env);
+    };
+}
+
+CompiledNode compileAssign(ast::AssignExpression *assign) {
+    CompiledNode value = compileClosure(assign->value.get());
+    if (auto index = dynamic_cast<ast::IndexExpression *>(assign->target.get())) {
+        CompiledNode left = compileClosure(index->left.get());
+        CompiledNode key = compileClosure(index->index.get());
+        return [left, key, value](object::Environment *env) -> object::Result {
+            object::Result l = left(env);
+            if (l.isAbrupt()) {
+                return l;
+            }
+            object::Result k = key(env);
+            if (k.isAbrupt()) {
+                return k;
+            }
+            object::Result v = value(env);
+            if (v.isAbrupt()) {
+                return v;
+            }
+            return assignIndex(l.value, k.value, v.value);
+        };
+    }
+    auto ident = static_cast<ast::Identifier *>(assign->target.get());
+    return [ident, value](object::Environment *env) -> object::Result {
+        object::Result v = value(env);
+        if (v.isAbrupt()) {
+            return v;
+        }
+        return assignVariable(ident, v.value, env);
+    };
+}
+
+CompiledNode compileWhile(ast::WhileStatement *loop) {
+    CompiledNode condition = compileClosure(loop->condition.get());
+    CompiledNode body = compileClosure(loop->body.get());
+    return [condition, body](object::Environment *env) -> object::Result {
+        while (true) {
+            object::Result test = condition(env);
+            if (test.isAbrupt()) {
+                return test;
+            } else if (!isTruthy(test.value)) {
+                return nullptr;
+            }
+            object::Result result = body(env);
+            if (result.isBreak()) {
+                return nullptr;
+            } else if (result.isAbrupt() && !result.isContinue()) {
+                return result;
+            }
+        }
+    };
+}
+
+CompiledNode compileFor(ast::ForStatement *loop) {
+    CompiledNode iterable = compileClosure(loop->iterable.get());
+    CompiledNode body = compileClosure(loop->body.get());
+    ast::Identifier *variable = loop->variable.get();
+    return [iterable, body, variable](object::Environment *env) -> object::Result {
+        object::Result items = iterable(env);
+        if (items.isAbrupt()) {
+            return items;
+        }
+        object::Object *source = loopSource(items.value);
+        if (source == nullptr) {
+            return newError(object::ErrorCode::NOT_ITERABLE, "", items.value);
+        }
+        object::Object *element = nullptr;
+        for (std::size_t position = 0;; position++) {
+            object::Result next = loopNext(source, position, element);
+            if (next.isAbrupt()) {
+                return next;
+            } else if (next.value == nullptr) {
+                return nullptr;
+            }
+            element = next.value;
+            bindVariable(variable->binding, variable->value, element, env);
+            object::Result result = body(env);
+            if (result.isBreak()) {
+                return nullptr;
+            } else if (result.isAbrupt() && !result.isContinue()) {
+                return result;
+            }
+        }
+    };
+}
+
+CompiledNode compileHash(ast::HashLiteral *hash) {
+    std::vector<std::pair<CompiledNode, CompiledNode>> pairs;
+    for (const auto &pair : hash->pairs) {
+        pairs.emplace_back(compileClosure(pair.first.get()), compileClosure(pair.second.get()));
+    }
+    return [pairs](object::Environment *env) -> object::Result {
+        object::Hash *result = new object::Hash();
+        for (const auto &pair : pairs) {
+            object::Result key = pair.first(env);
+            if (key.isAbrupt()) {
+                return key;
+            } else if (!object::isHashable(key.value)) {
+                return newError(object::ErrorCode::UNUSABLE_AS_HASH_KEY, "", key.value);
+            }
+            object::Result value = pair.second(env);
+            if (value.isAbrupt()) {
+                return value;
+            }
+            result->set(key.value, value.value);
+        }
+        return result;
+    };
+}
+
+} // namespace
+
+CompiledNode compileClosure(ast::Node *node) {
+    if (auto program = dynamic_cast<ast::Program *>(node)) {
+        std::vector<CompiledNode> statements;
+        for (const auto &statement : program->statements) {
+            statements.push_back(compileClosure(statement.get()));
+        }
+        return [statements](object::Environment *env) -> object::Result {
+            object::Result result = nullptr;
+            for (const auto &statement : statements) {
+                result = statement(env);
+                if (result.isReturn()) {
+                    return result.value;
+                } else if (result.isError()) {
+                    return result;
+                }
+            }
+            return result;
+        };
+    } else if (auto expression = dynamic_cast<ast::ExpressionStatement *>(node)) {
+        return compileClosure(expression->expression.get());
+    } else if (auto intLiteral = dynamic_cast<ast::IntegerLiteral *>(node)) {
+        // integers are immutable, so every evaluation can share one
+        return constant(new object::Integer(intLiteral->valueInt));
+    } else if (auto boolLiteral = dynamic_cast<ast::Boolean *>(node)) {
+        return constant(nativeBoolToBooleanObject(boolLiteral->valueBool));
+    } else if (auto stringLit = dynamic_cast<ast::StringLiteral *>(node)) {
+        if (stringLit->interned == nullptr) {
+            stringLit->interned = object::String::intern(stringLit->valueString);
+        }
+        return constant(stringLit->interned);
+    } else if (auto prefix = dynamic_cast<ast::PrefixExpression *>(node)) {
+        CompiledNode right = compileClosure(prefix->right.get());
+        if (prefix->oper == "!") {
+            return [right](object::Environment *env) -> object::Result {
+                object::Result r = right(env);
+                return r.isAbrupt() ? r : object::Result(evalBangOperatorExpression(r.value));
+            };
+        }
+        const std::string &oper = prefix->oper;
+        return [right, &oper](object::Environment *env) -> object::Result {
+            object::Result r = right(env);
+            return r.isAbrupt() ? r : evalPrefixExpression(oper, r.value);
+        };
+    } else if (auto infix = dynamic_cast<ast::InfixExpression *>(node)) {
+        return compileInfix(infix);
+    } else if (auto block = dynamic_cast<ast::BlockStatement *>(node)) {
+        return compileBlock(block);
+    } else if (auto ifExpression = dynamic_cast<ast::IfExpression *>(node)) {
+        return compileIf(ifExpression);
+    } else if (auto ret = dynamic_cast<ast::ReturnStatement *>(node)) {
+        CompiledNode value = compileClosure(ret->returnValue.get());
+        return [value](object::Environment *env) -> object::Result {
+            object::Result v = value(env);
+            return v.isAbrupt() ? v : object::Result(v.value, object::Result::Status::RETURN);
+        };
+    } else if (auto let = dynamic_cast<ast::LetStatement *>(node)) {
+        CompiledNode value = compileClosure(let->value.get());
+        ast::Identifier *name = let->name.get();
+        return [value, name](object::Environment *env) -> object::Result {
+            object::Result v = value(env);
+            if (v.isAbrupt()) {
+                return v;
+            }
+            bindVariable(name->binding, name->value, v.value, env);
+            return nullptr;
+        };
+    } else if (auto ident = dynamic_cast<ast::Identifier *>(node)) {
+        return compileIdentifier(ident);
+    } else if (auto literal = dynamic_cast<ast::FunctionLiteral *>(node)) {
+        if (literal->prototype == nullptr) {
+            literal->prototype = resolveFunction(literal);
+        }
+        std::shared_ptr<const object::FunctionPrototype> prototype = literal->prototype;
+        return [prototype](object::Environment *env) -> object::Result { return makeClosure(prototype, env); };
+    } else if (auto call = dynamic_cast<ast::CallExpression *>(node)) {
+        return compileCall(call);
+    } else if (auto array = dynamic_cast<ast::ArrayLiteral *>(node)) {
+        std::vector<CompiledNode> elements = compileAll(array->elements);
+        return [elements](object::Environment *env) -> object::Result {
+            object::Array *result = new object::Array();
+            result->elements.reserve(elements.size());
+            for (const auto &element : elements) {
+                object::Result value = element(env);
+                if (value.isAbrupt()) {
+                    return value;
+                }
+                result->elements.push_back(value.value);
+            }
+            return result;
+        };
+    } else if (auto index = dynamic_cast<ast::IndexExpression *>(node)) {
+        CompiledNode left = compileClosure(index->left.get());
+        CompiledNode key = compileClosure(index->index.get());
+        return [left, key, index](object::Environment *env) -> object::Result {
+            object::Result l = left(env);
+            if (l.isAbrupt()) {
+                return l;
+            }
+            object::Result k = key(env);
+            if (k.isAbrupt()) {
+                return k;
+            }
+            return evalCachedIndexExpression(index, l.value, k.value);
+        };
+    } else if (auto hash = dynamic_cast<ast::HashLiteral *>(node)) {
+        return compileHash(hash);
+    } else if (auto assign = dynamic_cast<ast::AssignExpression *>(node)) {
+        return compileAssign(assign);
+    } else if (auto loop = dynamic_cast<ast::WhileStatement *>(node)) {
+        return compileWhile(loop);
+    } else if (auto loop = dynamic_cast<ast::ForStatement *>(node)) {
+        return compileFor(loop);
+    } else if (dynamic_cast<ast::BreakStatement *>(node)) {
+        return [](object::Environment *) { return object::Result(nullptr, object::Result::Status::BREAK); };
+    } else if (dynamic_cast<ast::ContinueStatement *>(node)) {
+        return [](object::Environment *) { return object::Result(nullptr, object::Result::Status::CONTINUE); };
+    }
+    return constant(nullptr);
+}
+
+const CompiledBody *compiledBody(const object::FunctionPrototype *prototype) {
+    FunctionProfile &profile = profileOf(prototype);
+    if (profile.compiled == nullptr) {
+        profile.compiled = std::make_shared<CompiledBody>(CompiledBody{compileClosure(prototype->body.get())});
+    }
+    return profile.compiled.get();
+}
+
+// Like applyFunction: runs `func`, then every call it makes in tail
+// position, in one loop reusing one frame.
+object::Result applyCompiled(object::Object *func, object::Args args) {
+    object::Environment *frame = nullptr;
+    while (true) {
+        if (func->type() == object::ObjectType::BUILTIN_OBJ) {
+            return applyBuiltin(static_cast<object::Builtin *>(func), args);
+        } else if (func->type() != object::ObjectType::FUNCTION_OBJ) {
+            return newError(object::ErrorCode::NOT_A_FUNCTION, "", func);
+        }
+        auto funcObj = static_cast<object::Function *>(func);
+        const object::FunctionPrototype *prototype = funcObj->prototype.get();
+        if (args.size() != prototype->arity) {
+            return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, prototype->arity, args.size());
+        }
+        if (frame == nullptr) {
+            frame = extendFunctionEnvironment(funcObj, args);
+        } else {
+            initFrame(frame, funcObj, args);
+        }
+        object::Result evaluated = compiledBody(prototype)->run(frame);
+        if (!evaluated.isTailCall()) {
+            return unwrapReturnValue(evaluated);
+        }
+        func = evaluated.value;
+        args = object::Args{tailArguments.data(), tailArguments.size()};
+    }
+}
+
+object::Object *evalClosureCompiled(ast::Program *program, object::Environment *env) {
+    object::Result result = compileClosure(program)(env);
+    if (result.isError()) {
+        return new object::Error(lastError.message());
+    }
+    return result.value;
+}
+
+} // namespace evaluator
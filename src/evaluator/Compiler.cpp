@@ -0,0 +1,525 @@
+#include "evaluator/Compiler.h"
+#include "ast/ArrayLiteral.h"
+#include "ast/AssignExpression.h"
+#include "ast/BlockStatement.h"
+#include "ast/Boolean.h"
+#include "ast/BreakStatement.h"
+#include "ast/CallExpression.h"
+#include "ast/ContinueStatement.h"
+#include "ast/ExpressionStatement.h"
+#include "ast/ForStatement.h"
+#include "ast/FunctionLiteral.h"
+#include "ast/HashLiteral.h"
+#include "ast/IfExpression.h"
+#include "ast/IndexExpression.h"
+#include "ast/InfixExpression.h"
+#include "ast/IntegerLiteral.h"
+#include "ast/LetStatement.h"
+#include "ast/PrefixExpression.h"
+#include "ast/ReturnStatement.h"
+#include "ast/StringLiteral.h"
+#include "ast/WhileStatement.h"
+#include "evaluator/FunctionProfile.h"
+#include "evaluator/Resolver.h"
+#include "evaluator/evaluator.h"
+#include "object/Integer.h"
+#include "object/String.h"
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace evaluator {
+
+namespace {
+
+// True if evaluating `node` may store to a local register: Monkey has no
+// block scope, so any let, assignment or for loop below it might.
+bool writesLocal(ast::Node *node) {
+    if (node == nullptr || dynamic_cast<ast::FunctionLiteral *>(node)) {
+        return false;
+    }
+    if (dynamic_cast<ast::AssignExpression *>(node) || dynamic_cast<ast::LetStatement *>(node) ||
+        dynamic_cast<ast::ForStatement *>(node)) {
+        return true;
+    }
+    bool writes = false;
+    forEachChild(node, [&](ast::Node *child) { writes = writes || writesLocal(child); });
+    return writes;
+}
+
+// Compiles one program or function body. Registers below localCount_ hold
+// the locals; temporaries are allocated stack-wise above them, so an
+// expression's temporaries are free again once it has been compiled.
+class Compiler {
+  public:
+    explicit Compiler(std::size_t localCount)
+        : block_(std::make_unique<CodeBlock>()), localCount_(static_cast<int>(localCount)),
+          next_(static_cast<int>(localCount)), assigned_(localCount, false) {
+        block_->registerCount = localCount;
+    }
+
+    std::unique_ptr<CodeBlock> program(ast::Program *program) {
+        bool produced = false;
+        for (std::size_t i = 0; i < program->statements.size(); i++) {
+            auto expression = dynamic_cast<ast::ExpressionStatement *>(program->statements[i].get());
+            if (i + 1 == program->statements.size() && expression != nullptr) {
+                int result = allocate();
+                compileExpression(expression->expression.get(), result);
+                emit(Opcode::RETURN, result);
+                produced = true;
+            } else {
+                compileStatement(program->statements[i].get(), -1);
+            }
+        }
+        if (!produced) {
+            // like eval(), a program that does not end in an expression has no value
+            emit(Opcode::RETURN, constant(nullptr));
+        }
+        return std::move(block_);
+    }
+
+    std::unique_ptr<CodeBlock> function(const object::FunctionPrototype &prototype) {
+        for (const auto &binding : prototype.parameterBindings) {
+            if (binding.kind == ast::BindingKind::LOCAL) {
+                assigned_[binding.index] = true;
+            }
+        }
+        int result = allocate();
+        compileBlock(prototype.body.get(), result);
+        emit(Opcode::RETURN, result);
+        return std::move(block_);
+    }
+
+  private:
+    struct Loop {
+        // where a continue jumps to
+        std::size_t start;
+        // jumps to patch to the loop's exit
+        std::vector<std::size_t> breaks;
+    };
+
+    std::unique_ptr<CodeBlock> block_;
+    const int localCount_;
+    int next_;
+    // Locals that are certainly set wherever code compiled from now on runs:
+    // the parameters, and lets and assignments that run unconditionally.
+    // Other locals may still be unset, which falls back to a global lookup.
+    std::vector<bool> assigned_;
+    // nesting of conditional code (if branches and loop bodies)
+    int depth_ = 0;
+    std::vector<Loop> loops_;
+    std::map<int, int> integers_;
+    std::map<object::Object *, int> objects_;
+    std::map<std::string, int> names_;
+    std::map<const object::FunctionPrototype *, int> functions_;
+
+    int allocate(int count = 1) {
+        int first = next_;
+        next_ += count;
+        block_->registerCount = std::max(block_->registerCount, static_cast<std::size_t>(next_));
+        return first;
+    }
+    bool isLocal(int operand) const { return operand >= 0 && operand < localCount_; }
+
+    std::size_t emit(Opcode op, int a = 0, int b = 0, int c = 0) {
+        block_->code.push_back(Instruction{op, 0, a, b, c});
+        return block_->code.size() - 1;
+    }
+    std::size_t here() const { return block_->code.size(); }
+    // points the jump at `jump` to the next instruction emitted
+    void patch(std::size_t jump) { block_->code[jump].b = static_cast<int>(here() - jump - 1); }
+    void jumpTo(std::size_t target) {
+        emit(Opcode::JMP, 0, static_cast<int>(target) - static_cast<int>(here()) - 1);
+    }
+
+    // constant operands are encoded as negative numbers, see Bytecode.h
+    int constant(object::Object *value) {
+        auto found = objects_.find(value);
+        if (found != objects_.end()) {
+            return found->second;
+        }
+        block_->constants.push_back(value);
+        int operand = -static_cast<int>(block_->constants.size());
+        objects_.emplace(value, operand);
+        return operand;
+    }
+    int integer(int value) {
+        auto found = integers_.find(value);
+        if (found != integers_.end()) {
+            return found->second;
+        }
+        int operand = constant(new object::Integer(value));
+        integers_.emplace(value, operand);
+        return operand;
+    }
+    int name(const std::string &value) {
+        auto found = names_.find(value);
+        if (found != names_.end()) {
+            return found->second;
+        }
+        block_->names.push_back(value);
+        return names_[value] = static_cast<int>(block_->names.size() - 1);
+    }
+    int functionIndex(const std::shared_ptr<const object::FunctionPrototype> &prototype) {
+        auto found = functions_.find(prototype.get());
+        if (found != functions_.end()) {
+            return found->second;
+        }
+        block_->functions.push_back(prototype);
+        return functions_[prototype.get()] = static_cast<int>(block_->functions.size() - 1);
+    }
+
+    // R(target) = RK(operand)
+    void load(int target, int operand) {
+        if (operand < 0) {
+            emit(Opcode::LOADK, target, -operand - 1);
+        } else if (operand != target) {
+            emit(Opcode::MOVE, target, operand);
+        }
+    }
+
+    // The value of `expression` as an RK operand: literals become constants
+    // and set locals are used in place; anything else goes to a temporary.
+    int operand(ast::Expression *expression) {
+        if (auto intLiteral = dynamic_cast<ast::IntegerLiteral *>(expression)) {
+            return integer(intLiteral->valueInt);
+        } else if (auto stringLiteral = dynamic_cast<ast::StringLiteral *>(expression)) {
+            return constant(internedString(stringLiteral));
+        } else if (auto boolLiteral = dynamic_cast<ast::Boolean *>(expression)) {
+            return constant(nativeBoolToBooleanObject(boolLiteral->valueBool));
+        } else if (auto ident = dynamic_cast<ast::Identifier *>(expression)) {
+            if (ident->binding.kind == ast::BindingKind::LOCAL && assigned_[ident->binding.index]) {
+                return ident->binding.index;
+            }
+        }
+        int temp = allocate();
+        compileExpression(expression, temp);
+        return temp;
+    }
+    // Like operand, but always a register.
+    int registerOf(ast::Expression *expression) {
+        int value = operand(expression);
+        if (value < 0) {
+            int temp = allocate();
+            load(temp, value);
+            return temp;
+        }
+        return value;
+    }
+    // `later` is evaluated after the operand `value` is taken but before it
+    // is used; if it could overwrite a local used in place, copy it first.
+    int protect(int value, ast::Node *later) {
+        if (isLocal(value) && writesLocal(later)) {
+            int temp = allocate();
+            emit(Opcode::MOVE, temp, value);
+            return temp;
+        }
+        return value;
+    }
+
+    static object::String *internedString(ast::StringLiteral *literal) {
+        if (literal->interned == nullptr) {
+            literal->interned = object::String::intern(literal->valueString);
+        }
+        return literal->interned;
+    }
+
+    // Stores RK(value) to a variable. A let of a global creates it; an
+    // assignment requires it to exist.
+    void store(const ast::Binding &binding, const std::string &variable, int value, bool let) {
+        switch (binding.kind) {
+        case ast::BindingKind::LOCAL:
+            load(binding.index, value);
+            break;
+        case ast::BindingKind::CELL:
+            emit(Opcode::SETCELL, binding.index, value);
+            break;
+        case ast::BindingKind::UPVALUE:
+            emit(Opcode::SETUPVAL, binding.index, value);
+            break;
+        case ast::BindingKind::GLOBAL:
+            emit(let ? Opcode::SETGLOBAL : Opcode::ASSIGNGLOBAL, name(variable), value);
+            break;
+        }
+    }
+
+    // Compiles `block` leaving its value in `target`, or dropping it if
+    // target is -1.
+    void compileBlock(ast::BlockStatement *block, int target) {
+        bool produced = false;
+        for (std::size_t i = 0; i < block->statements.size(); i++) {
+            bool last = i + 1 == block->statements.size();
+            produced = compileStatement(block->statements[i].get(), last ? target : -1);
+        }
+        if (target >= 0 && !produced) {
+            load(target, constant(&NULL_OBJECT));
+        }
+    }
+
+    // Returns true if the statement left a value in `target`.
+    bool compileStatement(ast::Statement *statement, int target) {
+        int mark = next_;
+        bool produced = false;
+        if (auto expression = dynamic_cast<ast::ExpressionStatement *>(statement)) {
+            compileExpression(expression->expression.get(), target);
+            produced = target >= 0;
+        } else if (auto let = dynamic_cast<ast::LetStatement *>(statement)) {
+            const ast::Binding &binding = let->name->binding;
+            if (binding.kind == ast::BindingKind::LOCAL) {
+                compileExpression(let->value.get(), binding.index);
+                assigned_[binding.index] = assigned_[binding.index] || depth_ == 0;
+            } else {
+                store(binding, let->name->value, operand(let->value.get()), true);
+            }
+        } else if (auto ret = dynamic_cast<ast::ReturnStatement *>(statement)) {
+            emit(Opcode::RETURN, operand(ret->returnValue.get()));
+        } else if (auto loop = dynamic_cast<ast::WhileStatement *>(statement)) {
+            compileWhile(loop);
+        } else if (auto loop = dynamic_cast<ast::ForStatement *>(statement)) {
+            compileFor(loop);
+        } else if (dynamic_cast<ast::BreakStatement *>(statement)) {
+            loops_.back().breaks.push_back(emit(Opcode::JMP));
+        } else if (dynamic_cast<ast::ContinueStatement *>(statement)) {
+            jumpTo(loops_.back().start);
+        } else if (auto block = dynamic_cast<ast::BlockStatement *>(statement)) {
+            compileBlock(block, target);
+            produced = target >= 0;
+        }
+        next_ = mark;
+        return produced;
+    }
+
+    void compileWhile(ast::WhileStatement *loop) {
+        depth_++;
+        std::size_t start = here();
+        int mark = next_;
+        std::size_t exit = jumpUnless(loop->condition.get());
+        next_ = mark;
+        loops_.push_back(Loop{start, {}});
+        compileBlock(loop->body.get(), -1);
+        jumpTo(start);
+        finishLoop(exit);
+        depth_--;
+    }
+
+    // The iterable, the current element and the position count take three
+    // registers for the whole loop.
+    void compileFor(ast::ForStatement *loop) {
+        depth_++;
+        int cursor = allocate(3);
+        compileExpression(loop->iterable.get(), cursor);
+        emit(Opcode::FORPREP, cursor);
+        std::size_t next = emit(Opcode::FORNEXT, cursor);
+        store(loop->variable->binding, loop->variable->value, cursor + 1, true);
+        loops_.push_back(Loop{next, {}});
+        compileBlock(loop->body.get(), -1);
+        jumpTo(next);
+        finishLoop(next);
+        depth_--;
+    }
+
+    void finishLoop(std::size_t exit) {
+        patch(exit);
+        for (std::size_t jump : loops_.back().breaks) {
+            patch(jump);
+        }
+        loops_.pop_back();
+    }
+
+    // Compiles `expression` leaving its value in `target`, or dropping it if
+    // target is -1. Every form writes `target` with its last instruction, so
+    // the target may be a local the expression itself reads.
+    void compileExpression(ast::Expression *expression, int target) {
+        int mark = next_;
+        if (auto ifExpression = dynamic_cast<ast::IfExpression *>(expression)) {
+            compileIf(ifExpression, target);
+        } else if (auto assign = dynamic_cast<ast::AssignExpression *>(expression)) {
+            compileAssign(assign, target);
+        } else {
+            if (target < 0) {
+                target = allocate();
+            }
+            compileValue(expression, target);
+        }
+        next_ = mark;
+    }
+
+    void compileValue(ast::Expression *expression, int target) {
+        if (auto ident = dynamic_cast<ast::Identifier *>(expression)) {
+            compileIdentifier(ident, target);
+        } else if (auto prefix = dynamic_cast<ast::PrefixExpression *>(expression)) {
+            int right = operand(prefix->right.get());
+            emit(prefix->oper == "!" ? Opcode::NOT : Opcode::NEG, target, right);
+        } else if (auto infix = dynamic_cast<ast::InfixExpression *>(expression)) {
+            int left = protect(operand(infix->left.get()), infix->right.get());
+            int right = operand(infix->right.get());
+            emit(infixOpcode(infix->oper), target, left, right);
+        } else if (auto literal = dynamic_cast<ast::FunctionLiteral *>(expression)) {
+            if (literal->prototype == nullptr) {
+                literal->prototype = resolveFunction(literal);
+            }
+            emit(Opcode::CLOSURE, target, functionIndex(literal->prototype));
+        } else if (auto call = dynamic_cast<ast::CallExpression *>(expression)) {
+            int count = static_cast<int>(call->arguments.size());
+            int base = allocate(1 + count);
+            compileExpression(call->function.get(), base);
+            if (call->fusion == ast::Fusion::CALL_LOCAL && !call->tail) {
+                emit(Opcode::CALL1, target, base, operand(call->arguments[0].get()));
+                return;
+            }
+            for (int i = 0; i < count; i++) {
+                compileExpression(call->arguments[i].get(), base + 1 + i);
+            }
+            if (call->tail) {
+                emit(Opcode::TAILCALL, 0, base, count);
+            } else {
+                emit(Opcode::CALL, target, base, count);
+            }
+        } else if (auto array = dynamic_cast<ast::ArrayLiteral *>(expression)) {
+            int count = static_cast<int>(array->elements.size());
+            int base = allocate(count);
+            for (int i = 0; i < count; i++) {
+                compileExpression(array->elements[i].get(), base + i);
+            }
+            emit(Opcode::NEWARRAY, target, base, count);
+        } else if (auto hash = dynamic_cast<ast::HashLiteral *>(expression)) {
+            int count = static_cast<int>(hash->pairs.size());
+            int base = allocate(2 * count);
+            int next = base;
+            for (const auto &pair : hash->pairs) {
+                compileExpression(pair.first.get(), next++);
+                compileExpression(pair.second.get(), next++);
+            }
+            emit(Opcode::NEWHASH, target, base, count);
+        } else if (auto index = dynamic_cast<ast::IndexExpression *>(expression)) {
+            int left = protect(operand(index->left.get()), index->index.get());
+            int key = operand(index->index.get());
+            emit(Opcode::INDEX, target, left, key);
+        } else {
+            load(target, operand(expression));
+        }
+    }
+
+    void compileIdentifier(ast::Identifier *ident, int target) {
+        const ast::Binding &binding = ident->binding;
+        switch (binding.kind) {
+        case ast::BindingKind::LOCAL:
+            if (assigned_[binding.index]) {
+                load(target, binding.index);
+            } else {
+                emit(Opcode::GETLOCAL, target, binding.index, name(ident->value));
+            }
+            break;
+        case ast::BindingKind::CELL:
+            emit(Opcode::GETCELL, target, binding.index, name(ident->value));
+            break;
+        case ast::BindingKind::UPVALUE:
+            emit(Opcode::GETUPVAL, target, binding.index, name(ident->value));
+            break;
+        case ast::BindingKind::GLOBAL:
+            emit(Opcode::GETGLOBAL, target, name(ident->value));
+            break;
+        }
+    }
+
+    static Opcode infixOpcode(const std::string &oper) {
+        static const std::map<std::string, Opcode> opcodes = {
+            {"+", Opcode::ADD}, {"-", Opcode::SUB}, {"*", Opcode::MUL}, {"/", Opcode::DIV},
+            {"==", Opcode::EQ}, {"!=", Opcode::NE}, {"<", Opcode::LT}, {">", Opcode::GT},
+        };
+        return opcodes.at(oper);
+    }
+
+    // Emits the jump taken when `condition` is falsy, to be patched. A fused
+    // comparison of locals and constants tests and jumps in one instruction.
+    std::size_t jumpUnless(ast::Expression *condition) {
+        static const std::map<std::string, Opcode> branches = {
+            {"==", Opcode::JMPIFNOTEQ},
+            {"!=", Opcode::JMPIFNOTNE},
+            {"<", Opcode::JMPIFNOTLT},
+            {">", Opcode::JMPIFNOTGT},
+        };
+        auto infix = dynamic_cast<ast::InfixExpression *>(condition);
+        if (infix != nullptr && infix->fusion != ast::Fusion::NONE) {
+            auto branch = branches.find(infix->oper);
+            if (branch != branches.end()) {
+                int left = operand(infix->left.get());
+                int right = operand(infix->right.get());
+                return emit(branch->second, left, 0, right);
+            }
+        }
+        return emit(Opcode::JMPIFNOT, operand(condition));
+    }
+
+    void compileIf(ast::IfExpression *ifExpression, int target) {
+        std::size_t skip = jumpUnless(ifExpression->condition.get());
+        depth_++;
+        compileBlock(ifExpression->consiquence.get(), target);
+        if (ifExpression->alternative != nullptr || target >= 0) {
+            std::size_t end = emit(Opcode::JMP);
+            patch(skip);
+            if (ifExpression->alternative != nullptr) {
+                compileBlock(ifExpression->alternative.get(), target);
+            } else {
+                load(target, constant(&NULL_OBJECT));
+            }
+            patch(end);
+        } else {
+            patch(skip);
+        }
+        depth_--;
+    }
+
+    void compileAssign(ast::AssignExpression *assign, int target) {
+        if (auto index = dynamic_cast<ast::IndexExpression *>(assign->target.get())) {
+            int left = registerOf(index->left.get());
+            if (!writesLocal(index->index.get())) {
+                left = protect(left, assign->value.get());
+            } else {
+                left = protect(left, index->index.get());
+            }
+            int key = protect(operand(index->index.get()), assign->value.get());
+            int value = operand(assign->value.get());
+            emit(Opcode::SETINDEX, left, key, value);
+            if (target >= 0) {
+                load(target, value);
+            }
+            return;
+        }
+        auto ident = static_cast<ast::Identifier *>(assign->target.get());
+        const ast::Binding &binding = ident->binding;
+        if (binding.kind == ast::BindingKind::LOCAL) {
+            compileExpression(assign->value.get(), binding.index);
+            assigned_[binding.index] = assigned_[binding.index] || depth_ == 0;
+            if (target >= 0) {
+                load(target, binding.index);
+            }
+            return;
+        }
+        int value = operand(assign->value.get());
+        store(binding, ident->value, value, false);
+        if (target >= 0) {
+            load(target, value);
+        }
+    }
+};
+
+} // namespace
+
+std::unique_ptr<CodeBlock> compileProgram(ast::Program *program) { return Compiler(0).program(program); }
+
+std::unique_ptr<CodeBlock> compileFunction(const object::FunctionPrototype &prototype) {
+    return Compiler(prototype.slotCount).function(prototype);
+}
+
+CodeBlock *functionCode(const object::FunctionPrototype *prototype) {
+    if (profileOf(prototype).code == nullptr) {
+        profileOf(prototype).code = compileFunction(*prototype);
+    }
+    return profileOf(prototype).code.get();
+}
+
+} // namespace evaluator
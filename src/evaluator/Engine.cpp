@@ -0,0 +1,48 @@
+#include "evaluator/Engine.h"
+#include "evaluator/ClosureCompiler.h"
+#include "evaluator/RegisterMachine.h"
+#include "evaluator/StacklessMachine.h"
+#include "evaluator/evaluator.h"
+#include <string>
+
+namespace evaluator {
+
+bool parseEngine(const std::string &name, Engine &engine) {
+    for (Engine candidate : {Engine::TREE, Engine::STACKLESS, Engine::REGISTER, Engine::CLOSURE}) {
+        if (name == engineName(candidate)) {
+            engine = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *engineName(Engine engine) {
+    switch (engine) {
+    case Engine::TREE:
+        return "tree";
+    case Engine::STACKLESS:
+        return "stackless";
+    case Engine::REGISTER:
+        return "register";
+    case Engine::CLOSURE:
+        return "closure";
+    }
+    return "?";
+}
+
+object::Object *evalWith(Engine engine, ast::Program *program, object::Environment *env) {
+    switch (engine) {
+    case Engine::TREE:
+        return eval(program, env);
+    case Engine::STACKLESS:
+        return evalStackless(program, env);
+    case Engine::REGISTER:
+        return evalRegisterMachine(program, env);
+    case Engine::CLOSURE:
+        return evalClosureCompiled(program, env);
+    }
+    return nullptr;
+}
+
+} // namespace evaluator
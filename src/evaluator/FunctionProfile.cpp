@@ -0,0 +1,23 @@
+#include "evaluator/FunctionProfile.h"
+#include "object/FunctionPrototype.h"
+#include <cstddef>
+#include <deque>
+
+namespace evaluator {
+
+namespace {
+
+// indexed by FunctionPrototype::id; a deque, so growing it leaves the
+// profiles already handed out where they are
+std::deque<FunctionProfile> profiles;
+
+} // namespace
+
+FunctionProfile &profileOf(const object::FunctionPrototype *prototype) {
+    if (prototype->id >= profiles.size()) {
+        profiles.resize(prototype->id + 1);
+    }
+    return profiles[prototype->id];
+}
+
+} // namespace evaluator
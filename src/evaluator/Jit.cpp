@@ -0,0 +1,646 @@
+#include "evaluator/Jit.h"
+#include "evaluator/Compiler.h"
+#include "evaluator/evaluator.h"
+#include "object/Array.h"
+#include "object/Builtin.h"
+#include "object/Hash.h"
+#include "object/Hashable.h"
+#include "object/Integer.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if MONKEY_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+namespace evaluator {
+
+namespace {
+
+bool jitEnabledByEnvironment() {
+    const char *setting = std::getenv("MONKEY_JIT");
+    return MONKEY_JIT_SUPPORTED && (setting == nullptr || std::string(setting) != "off");
+}
+
+} // namespace
+
+bool jitEnabled = jitEnabledByEnvironment();
+unsigned nativeDepth = 0;
+
+NativeCode::~NativeCode() {
+#if MONKEY_JIT_SUPPORTED
+    munmap(memory_, size_);
+#endif
+}
+
+namespace {
+
+// Runtime entry points the machine code calls. They follow the register
+// machine's handlers; a status of -1 is an error, 1 a branch taken.
+
+object::Object *rk(JitContext *context, object::Object **R, int operand) {
+    return operand >= 0 ? R[operand] : context->code->constants[-operand - 1];
+}
+
+object::Result lookup(JitContext *context, int name) {
+    const std::string &variable = context->code->names[name];
+    object::Object *value = context->closure->globals->get(variable);
+    if (value != nullptr) {
+        return value;
+    }
+    auto builtin = builtins.find(variable);
+    if (builtin != builtins.end()) {
+        return builtin->second;
+    }
+    return newError(object::ErrorCode::IDENTIFIER_NOT_FOUND, &variable);
+}
+
+// The generic opcode, ADD to GT, behind a quickened one.
+Opcode genericOpcode(Opcode op) {
+    if (op == Opcode::CONCAT_STR) {
+        return Opcode::ADD;
+    } else if (op >= Opcode::ADD_INT_INT && op <= Opcode::GT_INT_INT) {
+        return static_cast<Opcode>(static_cast<int>(op) - static_cast<int>(Opcode::ADD_INT_INT) +
+                                   static_cast<int>(Opcode::ADD));
+    }
+    return op;
+}
+
+object::Result genericInfix(Opcode op, object::Object *left, object::Object *right) {
+    static const std::string operators[] = {"+", "-", "*", "/", "==", "!=", "<", ">"};
+    return evalInfixExpression(operators[static_cast<int>(genericOpcode(op)) - static_cast<int>(Opcode::ADD)], left,
+                               right);
+}
+
+int store(object::Object **R, int target, object::Result result) {
+    if (result.isError()) {
+        return -1;
+    }
+    R[target] = result.value;
+    return 0;
+}
+
+int jitExecute(JitContext *context, object::Object **R, const Instruction *in) {
+    switch (in->op) {
+    case Opcode::GETLOCAL:
+    case Opcode::GETUPVAL: {
+        object::Object *value = in->op == Opcode::GETLOCAL ? R[in->b] : context->closure->upvalues[in->b]->value;
+        return store(R, in->a, value != nullptr ? object::Result(value) : lookup(context, in->c));
+    }
+    case Opcode::GETGLOBAL:
+        return store(R, in->a, lookup(context, in->b));
+    case Opcode::SETUPVAL:
+        context->closure->upvalues[in->a]->value = rk(context, R, in->b);
+        return 0;
+    case Opcode::SETGLOBAL:
+        context->closure->globals->set(context->code->names[in->a], rk(context, R, in->b));
+        return 0;
+    case Opcode::ASSIGNGLOBAL:
+        if (!context->closure->globals->assign(context->code->names[in->a], rk(context, R, in->b))) {
+            newError(object::ErrorCode::IDENTIFIER_NOT_FOUND, &context->code->names[in->a]);
+            return -1;
+        }
+        return 0;
+    case Opcode::ADD:
+    case Opcode::SUB:
+    case Opcode::MUL:
+    case Opcode::DIV:
+    case Opcode::EQ:
+    case Opcode::NE:
+    case Opcode::LT:
+    case Opcode::GT:
+    case Opcode::ADD_INT_INT:
+    case Opcode::SUB_INT_INT:
+    case Opcode::MUL_INT_INT:
+    case Opcode::DIV_INT_INT:
+    case Opcode::EQ_INT_INT:
+    case Opcode::NE_INT_INT:
+    case Opcode::LT_INT_INT:
+    case Opcode::GT_INT_INT:
+    case Opcode::CONCAT_STR:
+        return store(R, in->a, genericInfix(in->op, rk(context, R, in->b), rk(context, R, in->c)));
+    case Opcode::JMPIFNOTEQ:
+    case Opcode::JMPIFNOTNE:
+    case Opcode::JMPIFNOTLT:
+    case Opcode::JMPIFNOTGT: {
+        Opcode compare = static_cast<Opcode>(static_cast<int>(in->op) - static_cast<int>(Opcode::JMPIFNOTEQ) +
+                                             static_cast<int>(Opcode::EQ));
+        object::Result result = genericInfix(compare, rk(context, R, in->a), rk(context, R, in->c));
+        if (result.isError()) {
+            return -1;
+        }
+        return isTruthy(result.value) ? 0 : 1;
+    }
+    case Opcode::NOT:
+        R[in->a] = evalBangOperatorExpression(rk(context, R, in->b));
+        return 0;
+    case Opcode::NEG:
+        return store(R, in->a, evalMinusOperatorExpression(rk(context, R, in->b)));
+    case Opcode::NEWARRAY: {
+        object::Array *array = new object::Array();
+        array->elements.assign(R + in->b, R + in->b + in->c);
+        R[in->a] = array;
+        return 0;
+    }
+    case Opcode::NEWHASH: {
+        object::Hash *hash = new object::Hash();
+        for (int i = 0; i < in->c; i++) {
+            object::Object *key = R[in->b + 2 * i];
+            if (!object::isHashable(key)) {
+                newError(object::ErrorCode::UNUSABLE_AS_HASH_KEY, "", key);
+                return -1;
+            }
+            hash->set(key, R[in->b + 2 * i + 1]);
+        }
+        R[in->a] = hash;
+        return 0;
+    }
+    case Opcode::INDEX:
+        return store(R, in->a, evalIndexExpression(rk(context, R, in->b), rk(context, R, in->c)));
+    case Opcode::SETINDEX:
+        return assignIndex(R[in->a], rk(context, R, in->b), rk(context, R, in->c)).isError() ? -1 : 0;
+    case Opcode::CLOSURE: {
+        // compiled functions have no cells, so every capture is an upvalue
+        const auto &prototype = context->code->functions[in->b];
+        object::Function *func = new object::Function(prototype, context->closure->globals);
+        for (const auto &capture : prototype->captures) {
+            func->upvalues.push_back(context->closure->upvalues[capture.index]);
+        }
+        R[in->a] = func;
+        return 0;
+    }
+    case Opcode::CALL:
+        return store(R, in->a, applyFunction(R[in->b], object::Args{R + in->b + 1, static_cast<std::size_t>(in->c)}));
+    case Opcode::CALL1:
+        R[in->b + 1] = rk(context, R, in->c);
+        return store(R, in->a, applyFunction(R[in->b], object::Args{R + in->b + 1, 1}));
+    case Opcode::FORPREP: {
+        object::Object *source = loopSource(R[in->a]);
+        if (source == nullptr) {
+            newError(object::ErrorCode::NOT_ITERABLE, "", R[in->a]);
+            return -1;
+        }
+        R[in->a] = source;
+        R[in->a + 1] = nullptr;
+        R[in->a + 2] = new object::Integer(0);
+        return 0;
+    }
+    case Opcode::FORNEXT: {
+        auto position = static_cast<object::Integer *>(R[in->a + 2]);
+        object::Result next = loopNext(R[in->a], position->value, R[in->a + 1]);
+        if (next.isError()) {
+            return -1;
+        } else if (next.value == nullptr) {
+            return 1;
+        }
+        R[in->a + 1] = next.value;
+        position->value++;
+        return 0;
+    }
+    default:
+        return -1;
+    }
+}
+
+object::Object *jitTailCall(JitContext *context, object::Object **R, const Instruction *in) {
+    tailArguments.assign(R + in->b + 1, R + in->b + 1 + in->c);
+    context->tailCall = true;
+    return R[in->b];
+}
+
+object::Object *jitNewInteger(int value) { return new object::Integer(value); }
+
+#if MONKEY_JIT_SUPPORTED
+
+// Where the type tag and an Integer's value sit in the object.
+struct Layout {
+    int typeOffset;
+    int valueOffset;
+
+    Layout() {
+        object::Integer probe(0);
+        auto base = reinterpret_cast<const char *>(static_cast<object::Object *>(&probe));
+        typeOffset = static_cast<int>(reinterpret_cast<const char *>(&probe.objectType) - base);
+        valueOffset = static_cast<int>(reinterpret_cast<const char *>(&probe.value) - base);
+    }
+};
+
+enum Register { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7, R12 = 12 };
+
+enum Condition { EQUAL = 0x4, NOT_EQUAL = 0x5, SIGN = 0x8, LESS = 0xC, GREATER_EQUAL = 0xD, LESS_EQUAL = 0xE,
+                 GREATER = 0xF };
+
+// Just enough of an x86-64 encoder for the templates. Memory operands are
+// [base + disp32] with a base other than rsp or r12, which would need a SIB
+// byte.
+class Assembler {
+  public:
+    std::vector<unsigned char> code;
+
+    std::size_t here() const { return code.size(); }
+
+    void load(Register reg, Register base, int disp) { instruction(true, 0x8B, reg, base, disp); }
+    void store(Register base, int disp, Register reg) { instruction(true, 0x89, reg, base, disp); }
+    void load32(Register reg, Register base, int disp) { instruction(false, 0x8B, reg, base, disp); }
+    // cmp dword [base + disp], imm32
+    void compareMemory32(Register base, int disp, int value) {
+        instruction(false, 0x81, static_cast<Register>(7), base, disp);
+        int32(value);
+    }
+    void moveImmediate(Register reg, const void *value) {
+        rex(true, 0, reg);
+        byte(0xB8 + (reg & 7));
+        auto bits = reinterpret_cast<std::uint64_t>(value);
+        for (int i = 0; i < 8; i++) {
+            byte(static_cast<int>((bits >> (8 * i)) & 0xFF));
+        }
+    }
+    void move(Register dst, Register src) { registers(true, 0x89, src, dst); }
+    void move32(Register dst, Register src) { registers(false, 0x89, src, dst); }
+    void add32(Register dst, Register src) { registers(false, 0x01, src, dst); }
+    void sub32(Register dst, Register src) { registers(false, 0x29, src, dst); }
+    void compare32(Register left, Register right) { registers(false, 0x39, right, left); }
+    void compare(Register left, Register right) { registers(true, 0x39, right, left); }
+    void test32(Register reg) { registers(false, 0x85, reg, reg); }
+    void zero32(Register reg) { registers(false, 0x31, reg, reg); }
+    void imul32(Register dst, Register src) {
+        rex(false, dst, src);
+        byte(0x0F);
+        byte(0xAF);
+        byte(0xC0 | (dst & 7) << 3 | (src & 7));
+    }
+    void conditionalMove(Condition condition, Register dst, Register src) {
+        rex(true, dst, src);
+        byte(0x0F);
+        byte(0x40 + condition);
+        byte(0xC0 | (dst & 7) << 3 | (src & 7));
+    }
+    void call(const void *function) {
+        moveImmediate(RAX, function);
+        byte(0xFF);
+        byte(0xD0);
+    }
+    // Jumps return the position of their rel32 operand, for patch().
+    std::size_t jump() {
+        byte(0xE9);
+        return placeholder();
+    }
+    std::size_t jump(Condition condition) {
+        byte(0x0F);
+        byte(0x80 + condition);
+        return placeholder();
+    }
+    void patch(std::size_t operand, std::size_t target) {
+        auto rel = static_cast<std::int32_t>(static_cast<long>(target) - static_cast<long>(operand + 4));
+        std::memcpy(&code[operand], &rel, 4);
+    }
+    void push(Register reg) {
+        rex(false, 0, reg);
+        byte(0x50 + (reg & 7));
+    }
+    void pop(Register reg) {
+        rex(false, 0, reg);
+        byte(0x58 + (reg & 7));
+    }
+    void subtractFromStack(int bytes) {
+        byte(0x48);
+        byte(0x81);
+        byte(0xEC);
+        int32(bytes);
+    }
+    // lea rsp, [rbp - bytes]
+    void resetStack(int bytes) {
+        byte(0x48);
+        byte(0x8D);
+        byte(0xA5);
+        int32(-bytes);
+    }
+    void ret() { byte(0xC3); }
+
+  private:
+    void byte(int value) { code.push_back(static_cast<unsigned char>(value)); }
+    void int32(int value) {
+        auto bits = static_cast<std::uint32_t>(value);
+        for (int i = 0; i < 4; i++) {
+            byte(static_cast<int>((bits >> (8 * i)) & 0xFF));
+        }
+    }
+    std::size_t placeholder() {
+        std::size_t at = here();
+        int32(0);
+        return at;
+    }
+    void rex(bool wide, int reg, int rm) {
+        int prefix = 0x40 | (wide ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+        if (prefix != 0x40) {
+            byte(prefix);
+        }
+    }
+    void instruction(bool wide, int opcode, Register reg, Register base, int disp) {
+        rex(wide, reg, base);
+        byte(opcode);
+        byte(0x80 | (reg & 7) << 3 | (base & 7));
+        int32(disp);
+    }
+    // op r/m, reg with a register operand
+    void registers(bool wide, int opcode, Register reg, Register rm) {
+        rex(wide, reg, rm);
+        byte(opcode);
+        byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+    }
+};
+
+// Translates one function. In the generated code rbx points at the
+// registers, which live in the native frame, and r12 holds the context.
+class Translator {
+  public:
+    Translator(const object::FunctionPrototype *prototype, CodeBlock *code) : prototype_(prototype), code_(code) {}
+
+    std::vector<unsigned char> translate() {
+        static const Layout layout;
+        layout_ = &layout;
+        prologue();
+        const std::vector<Instruction> &instructions = code_->code;
+        starts_.resize(instructions.size() + 1);
+        for (std::size_t pc = 0; pc < instructions.size(); pc++) {
+            starts_[pc] = as_.here();
+            emit(pc, instructions[pc]);
+        }
+        starts_[instructions.size()] = as_.here();
+        for (const auto &jump : jumps_) {
+            as_.patch(jump.first, starts_[jump.second]);
+        }
+        std::size_t error = as_.here();
+        as_.zero32(RAX);
+        std::size_t exit = as_.here();
+        as_.resetStack(16);
+        as_.pop(R12);
+        as_.pop(RBX);
+        as_.pop(RBP);
+        as_.ret();
+        for (std::size_t jump : errors_) {
+            as_.patch(jump, error);
+        }
+        for (std::size_t jump : exits_) {
+            as_.patch(jump, exit);
+        }
+        return as_.code;
+    }
+
+  private:
+    const object::FunctionPrototype *prototype_;
+    CodeBlock *code_;
+    const Layout *layout_ = nullptr;
+    Assembler as_;
+    // native offset of each instruction
+    std::vector<std::size_t> starts_;
+    // (operand, target instruction) of each jump between instructions
+    std::vector<std::pair<std::size_t, std::size_t>> jumps_;
+    std::vector<std::size_t> errors_;
+    std::vector<std::size_t> exits_;
+
+    static int slot(int index) { return 8 * index; }
+
+    void prologue() {
+        as_.push(RBP);
+        as_.move(RBP, RSP);
+        as_.push(RBX);
+        as_.push(R12);
+        int frame = static_cast<int>((8 * code_->registerCount + 15) / 16 * 16);
+        if (frame > 0) {
+            as_.subtractFromStack(frame);
+        }
+        as_.move(RBX, RSP);
+        as_.move(R12, RDI);
+        as_.zero32(RAX);
+        for (std::size_t i = 0; i < code_->registerCount; i++) {
+            as_.store(RBX, slot(static_cast<int>(i)), RAX);
+        }
+        for (std::size_t i = 0; i < prototype_->arity; i++) {
+            as_.load(RAX, RSI, slot(static_cast<int>(i)));
+            as_.store(RBX, slot(prototype_->parameterBindings[i].index), RAX);
+        }
+    }
+
+    void loadOperand(Register reg, int operand) {
+        if (operand >= 0) {
+            as_.load(reg, RBX, slot(operand));
+        } else {
+            as_.moveImmediate(reg, code_->constants[-operand - 1]);
+        }
+    }
+
+    void jumpTo(std::size_t operand, std::size_t target) { jumps_.emplace_back(operand, target); }
+
+    // Calls jitExecute for `in`; a -1 status leaves through the error exit.
+    void callRuntime(const Instruction &in) {
+        as_.move(RDI, R12);
+        as_.move(RSI, RBX);
+        as_.moveImmediate(RDX, &in);
+        as_.call(reinterpret_cast<const void *>(&jitExecute));
+        as_.test32(RAX);
+        errors_.push_back(as_.jump(SIGN));
+    }
+
+    // Jumps to `slow` unless both operands, in rsi and rdx, are integers;
+    // otherwise leaves their values in eax and ecx.
+    void integerOperands(std::vector<std::size_t> &slow) {
+        as_.compareMemory32(RSI, layout_->typeOffset, static_cast<int>(object::ObjectType::INTEGER_OBJ));
+        slow.push_back(as_.jump(NOT_EQUAL));
+        as_.compareMemory32(RDX, layout_->typeOffset, static_cast<int>(object::ObjectType::INTEGER_OBJ));
+        slow.push_back(as_.jump(NOT_EQUAL));
+        as_.load32(RAX, RSI, layout_->valueOffset);
+        as_.load32(RCX, RDX, layout_->valueOffset);
+    }
+
+    static Condition condition(Opcode compare) {
+        switch (compare) {
+        case Opcode::EQ:
+            return EQUAL;
+        case Opcode::NE:
+            return NOT_EQUAL;
+        case Opcode::LT:
+            return LESS;
+        default:
+            return GREATER;
+        }
+    }
+
+    static Condition negate(Condition condition) {
+        switch (condition) {
+        case EQUAL:
+            return NOT_EQUAL;
+        case NOT_EQUAL:
+            return EQUAL;
+        case LESS:
+            return GREATER_EQUAL;
+        default:
+            return LESS_EQUAL;
+        }
+    }
+
+    void arithmetic(const Instruction &in, Opcode op) {
+        std::vector<std::size_t> slow;
+        loadOperand(RSI, in.b);
+        loadOperand(RDX, in.c);
+        integerOperands(slow);
+        switch (op) {
+        case Opcode::ADD:
+        case Opcode::SUB:
+        case Opcode::MUL:
+            if (op == Opcode::ADD) {
+                as_.add32(RAX, RCX);
+            } else if (op == Opcode::SUB) {
+                as_.sub32(RAX, RCX);
+            } else {
+                as_.imul32(RAX, RCX);
+            }
+            as_.move32(RDI, RAX);
+            as_.call(reinterpret_cast<const void *>(&jitNewInteger));
+            break;
+        default:
+            as_.compare32(RAX, RCX);
+            as_.moveImmediate(RAX, &FALSE);
+            as_.moveImmediate(RDX, &TRUE);
+            as_.conditionalMove(condition(op), RAX, RDX);
+            break;
+        }
+        as_.store(RBX, slot(in.a), RAX);
+        std::size_t done = as_.jump();
+        for (std::size_t jump : slow) {
+            as_.patch(jump, as_.here());
+        }
+        callRuntime(in);
+        as_.patch(done, as_.here());
+    }
+
+    void compareAndBranch(std::size_t pc, const Instruction &in) {
+        std::size_t target = pc + 1 + in.b;
+        Opcode compare = static_cast<Opcode>(static_cast<int>(in.op) - static_cast<int>(Opcode::JMPIFNOTEQ) +
+                                             static_cast<int>(Opcode::EQ));
+        std::vector<std::size_t> slow;
+        loadOperand(RSI, in.a);
+        loadOperand(RDX, in.c);
+        integerOperands(slow);
+        as_.compare32(RAX, RCX);
+        jumpTo(as_.jump(negate(condition(compare))), target);
+        std::size_t done = as_.jump();
+        for (std::size_t jump : slow) {
+            as_.patch(jump, as_.here());
+        }
+        callRuntime(in);
+        jumpTo(as_.jump(NOT_EQUAL), target);
+        as_.patch(done, as_.here());
+    }
+
+    void emit(std::size_t pc, const Instruction &in) {
+        Opcode op = genericOpcode(in.op);
+        switch (op) {
+        case Opcode::MOVE:
+            as_.load(RAX, RBX, slot(in.b));
+            as_.store(RBX, slot(in.a), RAX);
+            break;
+        case Opcode::LOADK:
+            as_.moveImmediate(RAX, code_->constants[in.b]);
+            as_.store(RBX, slot(in.a), RAX);
+            break;
+        case Opcode::ADD:
+        case Opcode::SUB:
+        case Opcode::MUL:
+        case Opcode::EQ:
+        case Opcode::NE:
+        case Opcode::LT:
+        case Opcode::GT:
+            if (in.op == Opcode::CONCAT_STR) {
+                callRuntime(in);
+            } else {
+                arithmetic(in, op);
+            }
+            break;
+        case Opcode::JMP:
+            jumpTo(as_.jump(), pc + 1 + in.b);
+            break;
+        case Opcode::JMPIFNOT:
+            loadOperand(RAX, in.a);
+            as_.moveImmediate(RCX, &FALSE);
+            as_.compare(RAX, RCX);
+            jumpTo(as_.jump(EQUAL), pc + 1 + in.b);
+            as_.moveImmediate(RCX, &NULL_OBJECT);
+            as_.compare(RAX, RCX);
+            jumpTo(as_.jump(EQUAL), pc + 1 + in.b);
+            break;
+        case Opcode::JMPIFNOTEQ:
+        case Opcode::JMPIFNOTNE:
+        case Opcode::JMPIFNOTLT:
+        case Opcode::JMPIFNOTGT:
+            compareAndBranch(pc, in);
+            break;
+        case Opcode::FORNEXT:
+            callRuntime(in);
+            jumpTo(as_.jump(NOT_EQUAL), pc + 1 + in.b);
+            break;
+        case Opcode::TAILCALL:
+            as_.move(RDI, R12);
+            as_.move(RSI, RBX);
+            as_.moveImmediate(RDX, &in);
+            as_.call(reinterpret_cast<const void *>(&jitTailCall));
+            exits_.push_back(as_.jump());
+            break;
+        case Opcode::RETURN:
+            loadOperand(RAX, in.a);
+            exits_.push_back(as_.jump());
+            break;
+        default:
+            callRuntime(in);
+            break;
+        }
+    }
+};
+
+#endif
+
+} // namespace
+
+std::unique_ptr<NativeCode> compileNative(const object::FunctionPrototype *prototype) {
+#if MONKEY_JIT_SUPPORTED
+    if (prototype->cellCount > 0) {
+        return nullptr;
+    }
+    std::shared_ptr<CodeBlock> code = compileFunction(*prototype);
+    std::vector<unsigned char> machineCode = Translator(prototype, code.get()).translate();
+    std::size_t size = machineCode.size();
+    void *memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return nullptr;
+    }
+    std::memcpy(memory, machineCode.data(), size);
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return nullptr;
+    }
+    return std::make_unique<NativeCode>(memory, size, std::move(code));
+#else
+    (void)prototype;
+    return nullptr;
+#endif
+}
+
+object::Result runNative(const NativeCode *native, object::Function *func, object::Args args) {
+    JitContext context{func, native->code()};
+    nativeDepth++;
+    object::Object *value = native->entry()(&context, args.data);
+    nativeDepth--;
+    if (context.tailCall) {
+        return object::Result(value, object::Result::Status::TAIL_CALL);
+    } else if (value == nullptr) {
+        return object::Result::error();
+    }
+    return value;
+}
+
+} // namespace evaluator
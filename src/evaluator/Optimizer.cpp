@@ -0,0 +1,603 @@
+#include "evaluator/Optimizer.h"
+#include "evaluator/Bytecode.h"
+#include "evaluator/Compiler.h"
+#include "evaluator/evaluator.h"
+#include "object/Boolean.h"
+#include "object/Integer.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef MONKEY_LLVM
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/TargetSelect.h>
+#endif
+
+namespace evaluator {
+
+#ifdef MONKEY_LLVM
+
+namespace {
+
+// What a register holds at some point of the function.
+enum class Kind : unsigned char {
+    // not written, at least on one path here
+    UNSET,
+    INTEGER,
+    BOOLEAN,
+    // the function itself, read from a global to call it
+    SELF,
+    // different kinds on different paths
+    MIXED,
+};
+
+using State = std::vector<Kind>;
+
+// Flow-sensitive kinds of every register before every instruction, for a
+// guess of what the function returns. Fails on anything the tier does not
+// lower.
+class Analysis {
+  public:
+    Analysis(const object::FunctionPrototype *prototype, const CodeBlock *code, Kind returnKind)
+        : prototype_(prototype), code_(code), returnKind_(returnKind), before_(code->code.size()),
+          reached_(code->code.size(), false) {}
+
+    bool run() {
+        if (prototype_->arity > MAX_OPTIMIZED_PARAMETERS || code_->code.empty()) {
+            return false;
+        }
+        State entry(code_->registerCount, Kind::UNSET);
+        for (const ast::Binding &binding : prototype_->parameterBindings) {
+            entry[binding.index] = Kind::INTEGER;
+        }
+        if (!flow(0, entry)) {
+            return false;
+        }
+        while (!worklist_.empty()) {
+            std::size_t pc = worklist_.back();
+            worklist_.pop_back();
+            State state = before_[pc];
+            if (!transfer(code_->code[pc], state)) {
+                return false;
+            }
+            for (std::size_t next : successors(pc)) {
+                if (!flow(next, state)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool reached(std::size_t pc) const { return reached_[pc]; }
+    const State &before(std::size_t pc) const { return before_[pc]; }
+    const std::vector<std::string> &selfNames() const { return selfNames_; }
+
+    Kind operand(const State &state, int x) const {
+        if (x >= 0) {
+            return state[x];
+        }
+        object::Object *constant = code_->constants[-x - 1];
+        if (constant->type() == object::ObjectType::INTEGER_OBJ) {
+            return Kind::INTEGER;
+        } else if (constant->type() == object::ObjectType::BOOLEAN_OBJ) {
+            return Kind::BOOLEAN;
+        }
+        return Kind::MIXED;
+    }
+
+    std::vector<std::size_t> successors(std::size_t pc) const {
+        const Instruction &in = code_->code[pc];
+        std::size_t target = pc + 1 + in.b;
+        switch (in.op) {
+        case Opcode::JMP:
+            return {target};
+        case Opcode::JMPIFNOT:
+        case Opcode::JMPIFNOTEQ:
+        case Opcode::JMPIFNOTNE:
+        case Opcode::JMPIFNOTLT:
+        case Opcode::JMPIFNOTGT:
+            return {pc + 1, target};
+        case Opcode::RETURN:
+        case Opcode::TAILCALL:
+            return {};
+        default:
+            return {pc + 1};
+        }
+    }
+
+  private:
+    const object::FunctionPrototype *prototype_;
+    const CodeBlock *code_;
+    Kind returnKind_;
+    std::vector<State> before_;
+    std::vector<bool> reached_;
+    std::vector<std::size_t> worklist_;
+    std::vector<std::string> selfNames_;
+
+    bool flow(std::size_t pc, const State &state) {
+        if (pc >= before_.size()) {
+            return false;
+        }
+        if (!reached_[pc]) {
+            reached_[pc] = true;
+            before_[pc] = state;
+            worklist_.push_back(pc);
+            return true;
+        }
+        bool changed = false;
+        for (std::size_t i = 0; i < state.size(); i++) {
+            if (before_[pc][i] != state[i] && before_[pc][i] != Kind::MIXED) {
+                before_[pc][i] = Kind::MIXED;
+                changed = true;
+            }
+        }
+        if (changed) {
+            worklist_.push_back(pc);
+        }
+        return true;
+    }
+
+    static bool comparable(Kind left, Kind right) {
+        return left == right && (left == Kind::INTEGER || left == Kind::BOOLEAN);
+    }
+
+    bool transfer(const Instruction &in, State &state) {
+        auto kind = [&](int x) { return operand(state, x); };
+        switch (in.op) {
+        case Opcode::MOVE:
+        case Opcode::GETLOCAL:
+            // a local read before its let runs would fall back to the globals
+            if (state[in.b] == Kind::UNSET || state[in.b] == Kind::MIXED) {
+                return false;
+            }
+            state[in.a] = state[in.b];
+            return true;
+        case Opcode::LOADK:
+            state[in.a] = kind(-in.b - 1);
+            return state[in.a] != Kind::MIXED;
+        case Opcode::GETGLOBAL:
+            if (std::find(selfNames_.begin(), selfNames_.end(), code_->names[in.b]) == selfNames_.end()) {
+                selfNames_.push_back(code_->names[in.b]);
+            }
+            state[in.a] = Kind::SELF;
+            return true;
+        case Opcode::ADD:
+        case Opcode::SUB:
+        case Opcode::MUL:
+        case Opcode::DIV:
+            state[in.a] = Kind::INTEGER;
+            return kind(in.b) == Kind::INTEGER && kind(in.c) == Kind::INTEGER;
+        case Opcode::EQ:
+        case Opcode::NE:
+            if (!comparable(kind(in.b), kind(in.c))) {
+                return false;
+            }
+            state[in.a] = Kind::BOOLEAN;
+            return true;
+        case Opcode::LT:
+        case Opcode::GT:
+            if (kind(in.b) != Kind::INTEGER || kind(in.c) != Kind::INTEGER) {
+                return false;
+            }
+            state[in.a] = Kind::BOOLEAN;
+            return true;
+        case Opcode::NOT:
+            if (kind(in.b) != Kind::INTEGER && kind(in.b) != Kind::BOOLEAN) {
+                return false;
+            }
+            state[in.a] = Kind::BOOLEAN;
+            return true;
+        case Opcode::NEG:
+            if (kind(in.b) != Kind::INTEGER) {
+                return false;
+            }
+            state[in.a] = Kind::INTEGER;
+            return true;
+        case Opcode::JMP:
+            return true;
+        case Opcode::JMPIFNOT:
+            return kind(in.a) == Kind::INTEGER || kind(in.a) == Kind::BOOLEAN;
+        case Opcode::JMPIFNOTEQ:
+        case Opcode::JMPIFNOTNE:
+            return comparable(kind(in.a), kind(in.c));
+        case Opcode::JMPIFNOTLT:
+        case Opcode::JMPIFNOTGT:
+            return kind(in.a) == Kind::INTEGER && kind(in.c) == Kind::INTEGER;
+        case Opcode::CALL:
+        case Opcode::CALL1:
+        case Opcode::TAILCALL: {
+            if (state[in.b] != Kind::SELF) {
+                return false;
+            }
+            if (in.op == Opcode::CALL1) {
+                state[in.b + 1] = kind(in.c);
+            } else if (static_cast<std::size_t>(in.c) != prototype_->arity) {
+                return false;
+            }
+            for (std::size_t i = 0; i < prototype_->arity; i++) {
+                if (state[in.b + 1 + i] != Kind::INTEGER) {
+                    return false;
+                }
+            }
+            if (in.op == Opcode::CALL1 && prototype_->arity != 1) {
+                return false;
+            } else if (in.op != Opcode::TAILCALL) {
+                state[in.a] = returnKind_;
+            }
+            return true;
+        }
+        case Opcode::RETURN:
+            return kind(in.a) == returnKind_;
+        default:
+            return false;
+        }
+    }
+};
+
+// Emits the function as `kernel`, taking its integer parameters, a flag to
+// set when a guard fails and the recursion depth left, and `entry`, which
+// takes the parameters as an array.
+class Lowering {
+  public:
+    Lowering(const object::FunctionPrototype *prototype, const CodeBlock *code, const Analysis &analysis,
+             llvm::Module &module, const std::string &name)
+        : prototype_(prototype), code_(code), analysis_(analysis), context_(module.getContext()), module_(module),
+          builder_(context_), int32_(llvm::Type::getInt32Ty(context_)), int8_(llvm::Type::getInt8Ty(context_)),
+          name_(name) {}
+
+    void lower() {
+        std::vector<llvm::Type *> parameters(prototype_->arity, int32_);
+        parameters.push_back(int8_->getPointerTo());
+        parameters.push_back(int32_);
+        auto type = llvm::FunctionType::get(int32_, parameters, false);
+        kernel_ = llvm::Function::Create(type, llvm::Function::InternalLinkage, name_ + "_kernel", module_);
+        failed_ = kernel_->getArg(static_cast<unsigned>(prototype_->arity));
+        depth_ = kernel_->getArg(static_cast<unsigned>(prototype_->arity + 1));
+
+        llvm::BasicBlock *entry = llvm::BasicBlock::Create(context_, "entry", kernel_);
+        bail_ = llvm::BasicBlock::Create(context_, "bail", kernel_);
+        unwind_ = llvm::BasicBlock::Create(context_, "unwind", kernel_);
+        blocks_.resize(code_->code.size(), nullptr);
+        for (std::size_t pc = 0; pc < code_->code.size(); pc++) {
+            if (analysis_.reached(pc)) {
+                blocks_[pc] = llvm::BasicBlock::Create(context_, "pc" + std::to_string(pc), kernel_);
+            }
+        }
+
+        builder_.SetInsertPoint(entry);
+        for (std::size_t i = 0; i < code_->registerCount; i++) {
+            registers_.push_back(builder_.CreateAlloca(int32_));
+            builder_.CreateStore(builder_.getInt32(0), registers_.back());
+        }
+        for (std::size_t i = 0; i < prototype_->arity; i++) {
+            builder_.CreateStore(kernel_->getArg(static_cast<unsigned>(i)),
+                                 registers_[prototype_->parameterBindings[i].index]);
+        }
+        builder_.CreateCondBr(builder_.CreateICmpSLE(depth_, builder_.getInt32(0)), bail_, blocks_[0]);
+
+        builder_.SetInsertPoint(bail_);
+        builder_.CreateStore(builder_.getInt8(1), failed_);
+        builder_.CreateRet(builder_.getInt32(0));
+        builder_.SetInsertPoint(unwind_);
+        builder_.CreateRet(builder_.getInt32(0));
+
+        for (std::size_t pc = 0; pc < code_->code.size(); pc++) {
+            if (blocks_[pc] != nullptr) {
+                builder_.SetInsertPoint(blocks_[pc]);
+                lowerInstruction(pc);
+            }
+        }
+        lowerEntry();
+    }
+
+  private:
+    const object::FunctionPrototype *prototype_;
+    const CodeBlock *code_;
+    const Analysis &analysis_;
+    llvm::LLVMContext &context_;
+    llvm::Module &module_;
+    llvm::IRBuilder<> builder_;
+    llvm::Type *int32_;
+    llvm::Type *int8_;
+    std::string name_;
+    llvm::Function *kernel_ = nullptr;
+    llvm::Value *failed_ = nullptr;
+    llvm::Value *depth_ = nullptr;
+    // sets the failed flag and returns
+    llvm::BasicBlock *bail_ = nullptr;
+    // returns after a callee failed
+    llvm::BasicBlock *unwind_ = nullptr;
+    std::vector<llvm::BasicBlock *> blocks_;
+    std::vector<llvm::AllocaInst *> registers_;
+
+    // RK(x): booleans are 0 or 1
+    llvm::Value *value(int x) {
+        if (x >= 0) {
+            return builder_.CreateLoad(int32_, registers_[x]);
+        }
+        object::Object *constant = code_->constants[-x - 1];
+        if (constant->type() == object::ObjectType::INTEGER_OBJ) {
+            return builder_.getInt32(static_cast<std::uint32_t>(static_cast<object::Integer *>(constant)->value));
+        }
+        return builder_.getInt32(constant == &TRUE ? 1 : 0);
+    }
+
+    void store(int target, llvm::Value *value) { builder_.CreateStore(value, registers_[target]); }
+
+    llvm::Value *compare(Opcode op, llvm::Value *left, llvm::Value *right) {
+        switch (op) {
+        case Opcode::EQ:
+            return builder_.CreateICmpEQ(left, right);
+        case Opcode::NE:
+            return builder_.CreateICmpNE(left, right);
+        case Opcode::LT:
+            return builder_.CreateICmpSLT(left, right);
+        default:
+            return builder_.CreateICmpSGT(left, right);
+        }
+    }
+
+    llvm::Value *call(const Instruction &in, llvm::Value *depth) {
+        std::vector<llvm::Value *> args;
+        if (in.op == Opcode::CALL1) {
+            store(in.b + 1, value(in.c));
+            args.push_back(value(in.c));
+        } else {
+            for (std::size_t i = 0; i < prototype_->arity; i++) {
+                args.push_back(value(in.b + 1 + static_cast<int>(i)));
+            }
+        }
+        args.push_back(failed_);
+        args.push_back(depth);
+        return builder_.CreateCall(kernel_, args);
+    }
+
+    void lowerInstruction(std::size_t pc) {
+        const Instruction &in = code_->code[pc];
+        const State &state = analysis_.before(pc);
+        llvm::BasicBlock *next = pc + 1 < blocks_.size() ? blocks_[pc + 1] : nullptr;
+        llvm::BasicBlock *target = pc + 1 + in.b < blocks_.size() ? blocks_[pc + 1 + in.b] : nullptr;
+        switch (in.op) {
+        case Opcode::MOVE:
+        case Opcode::GETLOCAL:
+            store(in.a, value(in.b));
+            break;
+        case Opcode::LOADK:
+            store(in.a, value(-in.b - 1));
+            break;
+        case Opcode::GETGLOBAL:
+            break;
+        case Opcode::ADD:
+            store(in.a, builder_.CreateAdd(value(in.b), value(in.c)));
+            break;
+        case Opcode::SUB:
+            store(in.a, builder_.CreateSub(value(in.b), value(in.c)));
+            break;
+        case Opcode::MUL:
+            store(in.a, builder_.CreateMul(value(in.b), value(in.c)));
+            break;
+        case Opcode::DIV: {
+            llvm::Value *left = value(in.b);
+            llvm::Value *right = value(in.c);
+            llvm::Value *overflow = builder_.CreateAnd(builder_.CreateICmpEQ(left, builder_.getInt32(INT_MIN)),
+                                                       builder_.CreateICmpEQ(right, builder_.getInt32(-1)));
+            llvm::Value *invalid = builder_.CreateOr(builder_.CreateICmpEQ(right, builder_.getInt32(0)), overflow);
+            llvm::BasicBlock *divide = llvm::BasicBlock::Create(context_, "", kernel_);
+            builder_.CreateCondBr(invalid, bail_, divide);
+            builder_.SetInsertPoint(divide);
+            store(in.a, builder_.CreateSDiv(left, right));
+            break;
+        }
+        case Opcode::EQ:
+        case Opcode::NE:
+        case Opcode::LT:
+        case Opcode::GT:
+            store(in.a, builder_.CreateZExt(compare(in.op, value(in.b), value(in.c)), int32_));
+            break;
+        case Opcode::NOT:
+            // !integer is false
+            store(in.a, analysis_.operand(state, in.b) == Kind::BOOLEAN
+                            ? builder_.CreateXor(value(in.b), builder_.getInt32(1))
+                            : builder_.getInt32(0));
+            break;
+        case Opcode::NEG:
+            store(in.a, builder_.CreateNeg(value(in.b)));
+            break;
+        case Opcode::JMP:
+            builder_.CreateBr(target);
+            return;
+        case Opcode::JMPIFNOT:
+            // integers are truthy
+            if (analysis_.operand(state, in.a) == Kind::BOOLEAN) {
+                builder_.CreateCondBr(builder_.CreateICmpNE(value(in.a), builder_.getInt32(0)), next, target);
+            } else {
+                builder_.CreateBr(next);
+            }
+            return;
+        case Opcode::JMPIFNOTEQ:
+        case Opcode::JMPIFNOTNE:
+        case Opcode::JMPIFNOTLT:
+        case Opcode::JMPIFNOTGT: {
+            Opcode op = static_cast<Opcode>(static_cast<int>(in.op) - static_cast<int>(Opcode::JMPIFNOTEQ) +
+                                            static_cast<int>(Opcode::EQ));
+            builder_.CreateCondBr(compare(op, value(in.a), value(in.c)), next, target);
+            return;
+        }
+        case Opcode::CALL:
+        case Opcode::CALL1: {
+            llvm::Value *result = call(in, builder_.CreateSub(depth_, builder_.getInt32(1)));
+            llvm::BasicBlock *done = llvm::BasicBlock::Create(context_, "", kernel_);
+            llvm::Value *failed = builder_.CreateICmpNE(builder_.CreateLoad(int8_, failed_), builder_.getInt8(0));
+            builder_.CreateCondBr(failed, unwind_, done);
+            builder_.SetInsertPoint(done);
+            store(in.a, result);
+            break;
+        }
+        case Opcode::TAILCALL: {
+            // a failed callee has set the flag, so its value goes back unchecked
+            llvm::CallInst *result = static_cast<llvm::CallInst *>(call(in, depth_));
+            result->setTailCallKind(llvm::CallInst::TCK_MustTail);
+            builder_.CreateRet(result);
+            return;
+        }
+        case Opcode::RETURN:
+            builder_.CreateRet(value(in.a));
+            return;
+        default:
+            // the analysis lets nothing else through
+            builder_.CreateBr(bail_);
+            return;
+        }
+        builder_.CreateBr(next != nullptr ? next : bail_);
+    }
+
+    void lowerEntry() {
+        llvm::Type *args = int32_->getPointerTo();
+        auto type = llvm::FunctionType::get(int32_, {args, int8_->getPointerTo()}, false);
+        llvm::Function *entry = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name_, module_);
+        builder_.SetInsertPoint(llvm::BasicBlock::Create(context_, "entry", entry));
+        std::vector<llvm::Value *> values;
+        for (std::size_t i = 0; i < prototype_->arity; i++) {
+            llvm::Value *address = builder_.CreateConstGEP1_32(int32_, entry->getArg(0), static_cast<unsigned>(i));
+            values.push_back(builder_.CreateLoad(int32_, address));
+        }
+        values.push_back(entry->getArg(1));
+        values.push_back(builder_.getInt32(MAX_OPTIMIZED_DEPTH));
+        builder_.CreateRet(builder_.CreateCall(kernel_, values));
+    }
+};
+
+// The process-wide ORC JIT; null if LLVM could not set it up. Compiled code
+// is never removed, like the functions it belongs to.
+llvm::orc::LLJIT *orcJit() {
+    static std::unique_ptr<llvm::orc::LLJIT> jit = [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        auto created = llvm::orc::LLJITBuilder().create();
+        if (!created) {
+            llvm::consumeError(created.takeError());
+            return std::unique_ptr<llvm::orc::LLJIT>();
+        }
+        return std::move(*created);
+    }();
+    return jit.get();
+}
+
+void optimize(llvm::Module &module) {
+    llvm::LoopAnalysisManager loops;
+    llvm::FunctionAnalysisManager functions;
+    llvm::CGSCCAnalysisManager cgscc;
+    llvm::ModuleAnalysisManager modules;
+    llvm::PassBuilder builder;
+    builder.registerModuleAnalyses(modules);
+    builder.registerCGSCCAnalyses(cgscc);
+    builder.registerFunctionAnalyses(functions);
+    builder.registerLoopAnalyses(loops);
+    builder.crossRegisterProxies(loops, functions, cgscc, modules);
+    builder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2).run(module, modules);
+}
+
+OptimizedCode::Entry addToJit(std::unique_ptr<llvm::Module> module, std::unique_ptr<llvm::LLVMContext> context,
+                              const std::string &name) {
+    llvm::orc::LLJIT *jit = orcJit();
+    llvm::Error added = jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context)));
+    if (added) {
+        llvm::consumeError(std::move(added));
+        return nullptr;
+    }
+    auto symbol = jit->lookup(name);
+    if (!symbol) {
+        llvm::consumeError(symbol.takeError());
+        return nullptr;
+    }
+#if LLVM_VERSION_MAJOR >= 15
+    return symbol->toPtr<OptimizedCode::Entry>();
+#else
+    return reinterpret_cast<OptimizedCode::Entry>(symbol->getAddress());
+#endif
+}
+
+} // namespace
+
+bool optimizerAvailable() { return orcJit() != nullptr; }
+
+std::unique_ptr<OptimizedCode> compileOptimized(const object::FunctionPrototype *prototype) {
+    static std::atomic<unsigned> compiled{0};
+    llvm::orc::LLJIT *jit = orcJit();
+    if (jit == nullptr) {
+        return nullptr;
+    }
+    std::unique_ptr<CodeBlock> code = compileFunction(*prototype);
+    for (Kind returnKind : {Kind::INTEGER, Kind::BOOLEAN}) {
+        Analysis analysis(prototype, code.get(), returnKind);
+        if (!analysis.run()) {
+            continue;
+        }
+        std::string name = "monkey_optimized_" + std::to_string(compiled++);
+        auto context = std::make_unique<llvm::LLVMContext>();
+        auto module = std::make_unique<llvm::Module>(name, *context);
+        module->setDataLayout(jit->getDataLayout());
+        module->setTargetTriple(jit->getTargetTriple().str());
+        Lowering(prototype, code.get(), analysis, *module, name).lower();
+        if (llvm::verifyModule(*module)) {
+            return nullptr;
+        }
+        optimize(*module);
+        OptimizedCode::Entry entry = addToJit(std::move(module), std::move(context), name);
+        if (entry == nullptr) {
+            return nullptr;
+        }
+        return std::make_unique<OptimizedCode>(entry, returnKind == Kind::BOOLEAN, analysis.selfNames());
+    }
+    return nullptr;
+}
+
+#else
+
+bool optimizerAvailable() { return false; }
+
+std::unique_ptr<OptimizedCode> compileOptimized(const object::FunctionPrototype *) { return nullptr; }
+
+#endif
+
+bool runOptimized(const OptimizedCode *code, object::Function *func, object::Args args, object::Result &result) {
+    std::int32_t values[MAX_OPTIMIZED_PARAMETERS];
+    for (std::size_t i = 0; i < args.size(); i++) {
+        if (args[i]->type() != object::ObjectType::INTEGER_OBJ) {
+            return false;
+        }
+        values[i] = static_cast<object::Integer *>(args[i])->value;
+    }
+    for (const std::string &name : code->selfNames()) {
+        if (func->globals->get(name) != func) {
+            return false;
+        }
+    }
+    unsigned char failed = 0;
+    std::int32_t value = code->entry()(values, &failed);
+    if (failed != 0) {
+        return false;
+    }
+    if (code->returnsBoolean()) {
+        result = nativeBoolToBooleanObject(value != 0);
+    } else {
+        result = new object::Integer(value);
+    }
+    return true;
+}
+
+} // namespace evaluator
@@ -0,0 +1,517 @@
+#include "evaluator/RegisterMachine.h"
+#include "evaluator/Compiler.h"
+#include "evaluator/Tiering.h"
+#include "evaluator/evaluator.h"
+#include "object/Array.h"
+#include "object/Builtin.h"
+#include "object/Hash.h"
+#include "object/Hashable.h"
+#include "object/Integer.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace evaluator {
+
+namespace {
+
+RegisterMachine machine;
+
+bool bothIntegers(object::Object *left, object::Object *right) {
+    return left->type() == object::ObjectType::INTEGER_OBJ && right->type() == object::ObjectType::INTEGER_OBJ;
+}
+
+bool bothStrings(object::Object *left, object::Object *right) {
+    return left->type() == object::ObjectType::STRING_OBJ && right->type() == object::ObjectType::STRING_OBJ;
+}
+
+int intValue(object::Object *integer) { return static_cast<object::Integer *>(integer)->value; }
+
+// Rewrites a generic ADD to GT in place to the form for these operand
+// types, unless it has already fallen back from one too often.
+void quicken(Instruction *in, object::Object *left, object::Object *right) {
+    if (in->deopts >= MAX_DEOPTS) {
+        return;
+    } else if (bothIntegers(left, right)) {
+        in->op = quickenedInteger(in->op);
+    } else if (in->op == Opcode::ADD && bothStrings(left, right)) {
+        in->op = Opcode::CONCAT_STR;
+    }
+}
+
+void deoptimize(Instruction *in, Opcode generic) {
+    in->op = generic;
+    in->deopts++;
+}
+
+// Operands that are not both integers take the tree walker's path.
+object::Result genericInfix(Opcode op, object::Object *left, object::Object *right) {
+    static const std::string operators[] = {"+", "-", "*", "/", "==", "!=", "<", ">"};
+    return evalInfixExpression(operators[static_cast<int>(op) - static_cast<int>(Opcode::ADD)], left, right);
+}
+
+} // namespace
+
+object::Result RegisterMachine::run(CodeBlock *code, object::Environment *globals) {
+    std::size_t depth = frames_.size();
+    enter(code, top(), nullptr, globals, 0);
+    return execute(depth);
+}
+
+object::Result RegisterMachine::call(object::Function *func, object::Args args) {
+    const object::FunctionPrototype *prototype = func->prototype.get();
+    if (args.size() != prototype->arity) {
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, prototype->arity, args.size());
+    }
+    std::size_t depth = frames_.size();
+    arguments_.assign(args.begin(), args.end());
+    enter(functionCode(prototype), top(), func, func->globals, 0);
+    bindArguments(frames_.back(), arguments_.data());
+    return execute(depth);
+}
+
+std::size_t RegisterMachine::top() const {
+    if (frames_.empty()) {
+        return 0;
+    }
+    return frames_.back().base + frames_.back().code->registerCount;
+}
+
+// Pushes a frame with cleared registers and, for a function, fresh cells.
+void RegisterMachine::enter(CodeBlock *code, std::size_t base, object::Function *closure,
+                            object::Environment *globals, int result) {
+    std::size_t end = base + code->registerCount;
+    if (registers_.size() < end) {
+        registers_.resize(end);
+    }
+    std::fill(registers_.begin() + base, registers_.begin() + end, nullptr);
+    std::size_t cellBase = cells_.size();
+    if (closure != nullptr) {
+        for (std::size_t i = 0; i < closure->prototype->cellCount; i++) {
+            cells_.push_back(new object::Cell());
+        }
+    }
+    frames_.push_back(Frame{code, code->code.data(), base, cellBase, closure, globals, result});
+}
+
+void RegisterMachine::bindArguments(const Frame &frame, object::Object *const *args) {
+    const object::FunctionPrototype *prototype = frame.closure->prototype.get();
+    for (std::size_t i = 0; i < prototype->arity; i++) {
+        const ast::Binding &binding = prototype->parameterBindings[i];
+        if (binding.kind == ast::BindingKind::CELL) {
+            cells_[frame.cellBase + binding.index]->value = args[i];
+        } else {
+            registers_[frame.base + binding.index] = args[i];
+        }
+    }
+}
+
+// Pops the current frame and hands `value` to its caller. Returns true if
+// the frame was the one execute() was started for.
+bool RegisterMachine::leave(object::Object *value, std::size_t depth) {
+    Frame done = frames_.back();
+    frames_.pop_back();
+    cells_.resize(done.cellBase);
+    if (frames_.size() == depth) {
+        return true;
+    }
+    registers_[frames_.back().base + done.result] = value;
+    return false;
+}
+
+// Drops every frame execute() pushed; the error is in lastError.
+object::Result RegisterMachine::fail(std::size_t depth) {
+    cells_.resize(frames_[depth].cellBase);
+    frames_.resize(depth);
+    return object::Result::error();
+}
+
+object::Result RegisterMachine::lookup(const Frame &frame, int name) {
+    const std::string &variable = frame.code->names[name];
+    object::Object *value = frame.globals->get(variable);
+    if (value != nullptr) {
+        return value;
+    }
+    auto builtin = builtins.find(variable);
+    if (builtin != builtins.end()) {
+        return builtin->second;
+    }
+    return newError(object::ErrorCode::IDENTIFIER_NOT_FOUND, &variable);
+}
+
+object::Function *RegisterMachine::makeClosure(const Frame &frame, int function) {
+    const auto &prototype = frame.code->functions[function];
+    object::Function *func = new object::Function(prototype, frame.globals);
+    func->upvalues.reserve(prototype->captures.size());
+    for (const auto &capture : prototype->captures) {
+        func->upvalues.push_back(capture.fromCell ? cells_[frame.cellBase + capture.index]
+                                                  : frame.closure->upvalues[capture.index]);
+    }
+    return func;
+}
+
+// Dispatch. With GCC or Clang each handler ends by jumping straight to the
+// next instruction's handler through a table of label addresses (computed
+// goto), so every handler has its own indirect branch, which the CPU
+// predicts separately; a single `switch` funnels all of them through one
+// hard-to-predict branch. `make DISPATCH=switch` (or another compiler)
+// builds the portable switch loop instead.
+#if defined(__GNUC__) && !defined(MONKEY_SWITCH_DISPATCH)
+#define MONKEY_THREADED_DISPATCH 1
+#else
+#define MONKEY_THREADED_DISPATCH 0
+#endif
+
+#if MONKEY_THREADED_DISPATCH
+#define TARGET(name)                                                                                                   \
+    case Opcode::name:                                                                                                 \
+    target_##name:
+#define DISPATCH()                                                                                                     \
+    do {                                                                                                               \
+        in = pc++;                                                                                                     \
+        goto *targets[static_cast<int>(in->op)];                                                                       \
+    } while (0)
+#else
+#define TARGET(name) case Opcode::name:
+#define DISPATCH() continue
+#endif
+
+// A generic arithmetic or comparison handler: the tree walker's full type
+// dispatch, after which the instruction is quickened for the types it saw.
+#define GENERIC_BINARY(name)                                                                                           \
+    TARGET(name) {                                                                                                     \
+        object::Object *left = rk(in->b);                                                                              \
+        object::Object *right = rk(in->c);                                                                             \
+        object::Result result = genericInfix(in->op, left, right);                                                     \
+        if (result.isError()) {                                                                                        \
+            return fail(depth);                                                                                        \
+        }                                                                                                              \
+        R[in->a] = result.value;                                                                                       \
+        quicken(in, left, right);                                                                                      \
+        DISPATCH();                                                                                                    \
+    }
+
+// A quickened integer handler: one check of both type tags, then the
+// operation. Other operands put the generic opcode back and rerun it.
+#define INTEGER_BINARY(name, make, oper)                                                                               \
+    TARGET(name##_INT_INT) {                                                                                           \
+        object::Object *left = rk(in->b);                                                                              \
+        object::Object *right = rk(in->c);                                                                             \
+        if (bothIntegers(left, right)) {                                                                               \
+            R[in->a] = make(intValue(left) oper intValue(right));                                                      \
+            DISPATCH();                                                                                                \
+        }                                                                                                              \
+        deoptimize(in, Opcode::name);                                                                                  \
+        pc--;                                                                                                          \
+        DISPATCH();                                                                                                    \
+    }
+
+// A comparison fused with the conditional jump on its result.
+#define COMPARE_BRANCH(name, oper)                                                                                     \
+    TARGET(JMPIFNOT##name) {                                                                                           \
+        object::Object *left = rk(in->a);                                                                              \
+        object::Object *right = rk(in->c);                                                                             \
+        bool holds;                                                                                                    \
+        if (bothIntegers(left, right)) {                                                                               \
+            holds = intValue(left) oper intValue(right);                                                               \
+        } else {                                                                                                       \
+            object::Result result = genericInfix(Opcode::name, left, right);                                           \
+            if (result.isError()) {                                                                                    \
+                return fail(depth);                                                                                    \
+            }                                                                                                          \
+            holds = isTruthy(result.value);                                                                            \
+        }                                                                                                              \
+        if (!holds) {                                                                                                  \
+            pc += in->b;                                                                                               \
+        }                                                                                                              \
+        DISPATCH();                                                                                                    \
+    }
+
+// Runs until the frame on top of the stack when called returns. Calls
+// between Monkey functions push frames inside this loop; only builtins
+// calling back into Monkey code re-enter it.
+object::Result RegisterMachine::execute(std::size_t depth) {
+#if MONKEY_THREADED_DISPATCH
+    static void *const targets[] = {
+#define MONKEY_OPCODE_TARGET(name) &&target_##name,
+        MONKEY_OPCODES(MONKEY_OPCODE_TARGET)
+#undef MONKEY_OPCODE_TARGET
+    };
+#endif
+    Frame *frame;
+    Instruction *pc;
+    Instruction *in;
+    object::Object **R;
+    object::Object *const *K;
+    // after the frame changes, or after code that may have re-entered the
+    // machine and moved the frame stack or the register file
+    auto reload = [&]() {
+        frame = &frames_.back();
+        pc = frame->pc;
+        R = registers_.data() + frame->base;
+        K = frame->code->constants.data();
+    };
+    auto rk = [&](int operand) { return operand >= 0 ? R[operand] : K[-operand - 1]; };
+    auto newInteger = [](int value) -> object::Object * { return new object::Integer(value); };
+    reload();
+
+    while (true) {
+        in = pc++;
+        switch (in->op) {
+        TARGET(MOVE) {
+            R[in->a] = R[in->b];
+            DISPATCH();
+        }
+        TARGET(LOADK) {
+            R[in->a] = K[in->b];
+            DISPATCH();
+        }
+        TARGET(GETLOCAL)
+        TARGET(GETCELL)
+        TARGET(GETUPVAL) {
+            object::Object *value = in->op == Opcode::GETLOCAL  ? R[in->b]
+                                    : in->op == Opcode::GETCELL ? cells_[frame->cellBase + in->b]->value
+                                                                : frame->closure->upvalues[in->b]->value;
+            if (value == nullptr) {
+                // read before its let ran: fall back to the globals, like evalIdentifier
+                object::Result global = lookup(*frame, in->c);
+                if (global.isError()) {
+                    return fail(depth);
+                }
+                value = global.value;
+            }
+            R[in->a] = value;
+            DISPATCH();
+        }
+        TARGET(GETGLOBAL) {
+            object::Result global = lookup(*frame, in->b);
+            if (global.isError()) {
+                return fail(depth);
+            }
+            R[in->a] = global.value;
+            DISPATCH();
+        }
+        TARGET(SETCELL) {
+            cells_[frame->cellBase + in->a]->value = rk(in->b);
+            DISPATCH();
+        }
+        TARGET(SETUPVAL) {
+            frame->closure->upvalues[in->a]->value = rk(in->b);
+            DISPATCH();
+        }
+        TARGET(SETGLOBAL) {
+            frame->globals->set(frame->code->names[in->a], rk(in->b));
+            DISPATCH();
+        }
+        TARGET(ASSIGNGLOBAL) {
+            if (!frame->globals->assign(frame->code->names[in->a], rk(in->b))) {
+                newError(object::ErrorCode::IDENTIFIER_NOT_FOUND, &frame->code->names[in->a]);
+                return fail(depth);
+            }
+            DISPATCH();
+        }
+        GENERIC_BINARY(ADD)
+        GENERIC_BINARY(SUB)
+        GENERIC_BINARY(MUL)
+        GENERIC_BINARY(DIV)
+        GENERIC_BINARY(EQ)
+        GENERIC_BINARY(NE)
+        GENERIC_BINARY(LT)
+        GENERIC_BINARY(GT)
+        INTEGER_BINARY(ADD, newInteger, +)
+        INTEGER_BINARY(SUB, newInteger, -)
+        INTEGER_BINARY(MUL, newInteger, *)
+        INTEGER_BINARY(DIV, newInteger, /)
+        INTEGER_BINARY(EQ, nativeBoolToBooleanObject, ==)
+        INTEGER_BINARY(NE, nativeBoolToBooleanObject, !=)
+        INTEGER_BINARY(LT, nativeBoolToBooleanObject, <)
+        INTEGER_BINARY(GT, nativeBoolToBooleanObject, >)
+        TARGET(CONCAT_STR) {
+            object::Object *left = rk(in->b);
+            object::Object *right = rk(in->c);
+            if (bothStrings(left, right)) {
+                R[in->a] = concatStrings(left, right);
+                DISPATCH();
+            }
+            deoptimize(in, Opcode::ADD);
+            pc--;
+            DISPATCH();
+        }
+        TARGET(NOT) {
+            R[in->a] = evalBangOperatorExpression(rk(in->b));
+            DISPATCH();
+        }
+        TARGET(NEG) {
+            object::Result result = evalMinusOperatorExpression(rk(in->b));
+            if (result.isError()) {
+                return fail(depth);
+            }
+            R[in->a] = result.value;
+            DISPATCH();
+        }
+        TARGET(JMP) {
+            pc += in->b;
+            DISPATCH();
+        }
+        TARGET(JMPIFNOT) {
+            if (!isTruthy(rk(in->a))) {
+                pc += in->b;
+            }
+            DISPATCH();
+        }
+        COMPARE_BRANCH(EQ, ==)
+        COMPARE_BRANCH(NE, !=)
+        COMPARE_BRANCH(LT, <)
+        COMPARE_BRANCH(GT, >)
+        TARGET(NEWARRAY) {
+            object::Array *array = new object::Array();
+            array->elements.assign(R + in->b, R + in->b + in->c);
+            R[in->a] = array;
+            DISPATCH();
+        }
+        TARGET(NEWHASH) {
+            object::Hash *hash = new object::Hash();
+            for (int i = 0; i < in->c; i++) {
+                object::Object *key = R[in->b + 2 * i];
+                if (!object::isHashable(key)) {
+                    newError(object::ErrorCode::UNUSABLE_AS_HASH_KEY, "", key);
+                    return fail(depth);
+                }
+                hash->set(key, R[in->b + 2 * i + 1]);
+            }
+            R[in->a] = hash;
+            DISPATCH();
+        }
+        TARGET(INDEX) {
+            object::Result result = evalIndexExpression(rk(in->b), rk(in->c));
+            if (result.isError()) {
+                return fail(depth);
+            }
+            R[in->a] = result.value;
+            DISPATCH();
+        }
+        TARGET(SETINDEX) {
+            if (assignIndex(R[in->a], rk(in->b), rk(in->c)).isError()) {
+                return fail(depth);
+            }
+            DISPATCH();
+        }
+        TARGET(CLOSURE) {
+            R[in->a] = makeClosure(*frame, in->b);
+            DISPATCH();
+        }
+        TARGET(CALL)
+        TARGET(TAILCALL)
+        TARGET(CALL1) {
+            std::size_t count = static_cast<std::size_t>(in->c);
+            if (in->op == Opcode::CALL1) {
+                R[in->b + 1] = rk(in->c);
+                count = 1;
+            }
+            bool tail = in->op == Opcode::TAILCALL;
+            object::Object *callee = R[in->b];
+            frame->pc = pc;
+            object::Result result = nullptr;
+            if (callee->type() == object::ObjectType::BUILTIN_OBJ) {
+                result = applyBuiltin(static_cast<object::Builtin *>(callee), object::Args{R + in->b + 1, count});
+            } else if (callee->type() != object::ObjectType::FUNCTION_OBJ) {
+                newError(object::ErrorCode::NOT_A_FUNCTION, "", callee);
+                return fail(depth);
+            } else {
+                auto func = static_cast<object::Function *>(callee);
+                const object::FunctionPrototype *prototype = func->prototype.get();
+                if (count != prototype->arity) {
+                    newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, prototype->arity, count);
+                    return fail(depth);
+                }
+                if (enterTier(prototype) < Tier::NATIVE) {
+                    if (!tail) {
+                        std::size_t arguments = frame->base + in->b + 1;
+                        enter(functionCode(prototype), top(), func, func->globals, in->a);
+                        bindArguments(frames_.back(), registers_.data() + arguments);
+                    } else {
+                        // the callee takes over this frame's registers and result
+                        arguments_.assign(R + in->b + 1, R + in->b + 1 + count);
+                        Frame done = frames_.back();
+                        frames_.pop_back();
+                        cells_.resize(done.cellBase);
+                        enter(functionCode(prototype), done.base, func, func->globals, done.result);
+                        bindArguments(frames_.back(), arguments_.data());
+                    }
+                    reload();
+                    DISPATCH();
+                }
+                result = callCompiled(func, object::Args{R + in->b + 1, count});
+            }
+            if (result.isError()) {
+                return fail(depth);
+            }
+            reload();
+            if (!tail) {
+                R[in->a] = result.value;
+            } else if (leave(result.value, depth)) {
+                return result.value;
+            } else {
+                reload();
+            }
+            DISPATCH();
+        }
+        TARGET(RETURN) {
+            object::Object *value = rk(in->a);
+            if (leave(value, depth)) {
+                return value;
+            }
+            reload();
+            DISPATCH();
+        }
+        TARGET(FORPREP) {
+            object::Object *source = loopSource(R[in->a]);
+            if (source == nullptr) {
+                newError(object::ErrorCode::NOT_ITERABLE, "", R[in->a]);
+                return fail(depth);
+            }
+            R[in->a] = source;
+            R[in->a + 1] = nullptr;
+            // a private counter, never seen by Monkey code, so it is updated in place
+            R[in->a + 2] = new object::Integer(0);
+            DISPATCH();
+        }
+        TARGET(FORNEXT) {
+            auto position = static_cast<object::Integer *>(R[in->a + 2]);
+            frame->pc = pc;
+            object::Result next = loopNext(R[in->a], position->value, R[in->a + 1]);
+            if (next.isError()) {
+                return fail(depth);
+            }
+            reload();
+            if (next.value == nullptr) {
+                pc += in->b;
+            } else {
+                R[in->a + 1] = next.value;
+                position->value++;
+            }
+            DISPATCH();
+        }
+        }
+    }
+}
+
+#undef INTEGER_BINARY
+#undef GENERIC_BINARY
+#undef COMPARE_BRANCH
+#undef DISPATCH
+#undef TARGET
+
+object::Object *evalRegisterMachine(ast::Program *program, object::Environment *env) {
+    std::unique_ptr<CodeBlock> code = compileProgram(program);
+    object::Result result = machine.run(code.get(), env);
+    if (result.isError()) {
+        return new object::Error(lastError.message());
+    }
+    return result.value;
+}
+
+object::Result callRegisterMachine(object::Function *func, object::Args args) { return machine.call(func, args); }
+
+} // namespace evaluator
@@ -0,0 +1,219 @@
+#include "evaluator/Resolver.h"
+#include "evaluator/Superinstructions.h"
+#include "ast/ArrayLiteral.h"
+#include "ast/AssignExpression.h"
+#include "ast/CallExpression.h"
+#include "ast/ExpressionStatement.h"
+#include "ast/ForStatement.h"
+#include "ast/HashLiteral.h"
+#include "ast/IfExpression.h"
+#include "ast/IndexExpression.h"
+#include "ast/InfixExpression.h"
+#include "ast/LetStatement.h"
+#include "ast/PrefixExpression.h"
+#include "ast/ReturnStatement.h"
+#include "ast/WhileStatement.h"
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace evaluator {
+
+namespace {
+
+// One function being resolved. Locals are numbered in declaration order;
+// whether a local needs a cell is only known once every nested function
+// has been visited, so slot and cell indexes are assigned afterwards.
+struct Scope {
+    ast::FunctionLiteral *literal;
+    Scope *parent;
+    std::map<std::string, int> locals;
+    std::vector<bool> captured;
+    // slot or cell index of each local, filled in by finish()
+    std::vector<int> index;
+    // while resolving, a fromCell capture holds the parent's local number
+    std::vector<object::FunctionPrototype::Capture> captures;
+    std::vector<std::pair<ast::Identifier *, int>> localUses;
+    std::size_t slotCount = 0;
+    std::size_t cellCount = 0;
+};
+
+class Resolver {
+  public:
+    std::shared_ptr<const object::FunctionPrototype> resolve(ast::FunctionLiteral *literal) {
+        Scope *root = enter(literal, nullptr);
+        finish();
+        return root->literal->prototype;
+    }
+
+  private:
+    // parents are always created before their children
+    std::vector<std::unique_ptr<Scope>> scopes_;
+
+    Scope *enter(ast::FunctionLiteral *literal, Scope *parent) {
+        scopes_.push_back(std::make_unique<Scope>());
+        Scope *scope = scopes_.back().get();
+        scope->literal = literal;
+        scope->parent = parent;
+        for (const auto &param : literal->parameters) {
+            declare(scope, param->value);
+        }
+        declareLets(scope, literal->body.get());
+        visit(scope, literal->body.get());
+        markTailCalls(literal->body.get(), true);
+        return scope;
+    }
+
+    static void declare(Scope *scope, const std::string &name) {
+        if (scope->locals.emplace(name, static_cast<int>(scope->captured.size())).second) {
+            scope->captured.push_back(false);
+        }
+    }
+
+    // Monkey has no block scope: a `let` or a loop variable anywhere in the
+    // body, including inside if-blocks and loops, binds a local of the
+    // enclosing function.
+    void declareLets(Scope *scope, ast::Node *node) {
+        if (node == nullptr || dynamic_cast<ast::FunctionLiteral *>(node)) {
+            return;
+        }
+        if (auto let = dynamic_cast<ast::LetStatement *>(node)) {
+            declare(scope, let->name->value);
+        } else if (auto forStatement = dynamic_cast<ast::ForStatement *>(node)) {
+            declare(scope, forStatement->variable->value);
+        }
+        forEachChild(node, [&](ast::Node *child) { declareLets(scope, child); });
+    }
+
+    // Flags the calls whose value becomes the function's return value: the
+    // operand of any `return`, and the last expression of the body, looking
+    // through the last statement of if branches. Nested functions are marked
+    // when they are entered.
+    static void markTailCalls(ast::Node *node, bool tail) {
+        if (node == nullptr || dynamic_cast<ast::FunctionLiteral *>(node)) {
+            return;
+        }
+        if (auto call = dynamic_cast<ast::CallExpression *>(node)) {
+            call->tail = tail;
+        }
+        if (auto ret = dynamic_cast<ast::ReturnStatement *>(node)) {
+            markTailCalls(ret->returnValue.get(), true);
+        } else if (auto block = dynamic_cast<ast::BlockStatement *>(node)) {
+            for (std::size_t i = 0; i < block->statements.size(); i++) {
+                markTailCalls(block->statements[i].get(), tail && i == block->statements.size() - 1);
+            }
+        } else if (auto expression = dynamic_cast<ast::ExpressionStatement *>(node)) {
+            markTailCalls(expression->expression.get(), tail);
+        } else if (auto ifExpression = dynamic_cast<ast::IfExpression *>(node)) {
+            markTailCalls(ifExpression->condition.get(), false);
+            markTailCalls(ifExpression->consiquence.get(), tail);
+            markTailCalls(ifExpression->alternative.get(), tail);
+        } else {
+            forEachChild(node, [](ast::Node *child) { markTailCalls(child, false); });
+        }
+    }
+
+    void visit(Scope *scope, ast::Node *node) {
+        if (node == nullptr) {
+            return;
+        }
+        if (auto ident = dynamic_cast<ast::Identifier *>(node)) {
+            use(scope, ident);
+        } else if (auto function = dynamic_cast<ast::FunctionLiteral *>(node)) {
+            enter(function, scope);
+        } else {
+            forEachChild(node, [&](ast::Node *child) { visit(scope, child); });
+        }
+    }
+
+    void use(Scope *scope, ast::Identifier *ident) {
+        auto local = scope->locals.find(ident->value);
+        if (local != scope->locals.end()) {
+            scope->localUses.emplace_back(ident, local->second);
+            return;
+        }
+        int upvalue = upvalueOf(scope, ident->value);
+        if (upvalue >= 0) {
+            ident->binding = ast::Binding{ast::BindingKind::UPVALUE, upvalue};
+        } else {
+            ident->binding = ast::Binding{};
+        }
+    }
+
+    // Returns the index of the upvalue through which `scope` reaches `name`
+    // in an enclosing function, threading it through every function in
+    // between, or -1 if no enclosing function binds `name`.
+    static int upvalueOf(Scope *scope, const std::string &name) {
+        Scope *parent = scope->parent;
+        if (parent == nullptr) {
+            return -1;
+        }
+        auto local = parent->locals.find(name);
+        if (local != parent->locals.end()) {
+            parent->captured[local->second] = true;
+            return addCapture(scope, {true, local->second});
+        }
+        int upvalue = upvalueOf(parent, name);
+        if (upvalue < 0) {
+            return -1;
+        }
+        return addCapture(scope, {false, upvalue});
+    }
+
+    static int addCapture(Scope *scope, object::FunctionPrototype::Capture capture) {
+        for (std::size_t i = 0; i < scope->captures.size(); i++) {
+            if (scope->captures[i].fromCell == capture.fromCell && scope->captures[i].index == capture.index) {
+                return static_cast<int>(i);
+            }
+        }
+        scope->captures.push_back(capture);
+        return static_cast<int>(scope->captures.size() - 1);
+    }
+
+    void finish() {
+        for (const auto &scope : scopes_) {
+            for (bool captured : scope->captured) {
+                scope->index.push_back(static_cast<int>(captured ? scope->cellCount++ : scope->slotCount++));
+            }
+            for (auto &capture : scope->captures) {
+                if (capture.fromCell) {
+                    capture.index = scope->parent->index[capture.index];
+                }
+            }
+            for (const auto &use : scope->localUses) {
+                use.first->binding = bindingOf(scope.get(), use.second);
+            }
+
+            std::vector<std::string> parameters;
+            std::vector<ast::Binding> parameterBindings;
+            for (const auto &param : scope->literal->parameters) {
+                param->binding = bindingOf(scope.get(), scope->locals[param->value]);
+                parameters.push_back(param->value);
+                parameterBindings.push_back(param->binding);
+            }
+            scope->literal->prototype = std::make_shared<object::FunctionPrototype>(
+                std::move(parameters), std::move(parameterBindings), scope->literal->body, scope->captures,
+                scope->slotCount, scope->cellCount);
+        }
+    }
+
+    static ast::Binding bindingOf(Scope *scope, int local) {
+        if (scope->captured[local]) {
+            return ast::Binding{ast::BindingKind::CELL, scope->index[local]};
+        }
+        return ast::Binding{ast::BindingKind::LOCAL, scope->index[local]};
+    }
+};
+
+} // namespace
+
+std::shared_ptr<const object::FunctionPrototype> resolveFunction(ast::FunctionLiteral *literal) {
+    auto prototype = Resolver().resolve(literal);
+    fuseSuperinstructions(literal);
+    return prototype;
+}
+
+} // namespace evaluator
@@ -0,0 +1,379 @@
+#include "evaluator/StacklessMachine.h"
+#include "ast/ArrayLiteral.h"
+#include "ast/AssignExpression.h"
+#include "ast/BlockStatement.h"
+#include "ast/Boolean.h"
+#include "ast/BreakStatement.h"
+#include "ast/CallExpression.h"
+#include "ast/ContinueStatement.h"
+#include "ast/ExpressionStatement.h"
+#include "ast/ForStatement.h"
+#include "ast/FunctionLiteral.h"
+#include "ast/HashLiteral.h"
+#include "ast/IfExpression.h"
+#include "ast/IndexExpression.h"
+#include "ast/InfixExpression.h"
+#include "ast/IntegerLiteral.h"
+#include "ast/LetStatement.h"
+#include "ast/PrefixExpression.h"
+#include "ast/Program.h"
+#include "ast/ReturnStatement.h"
+#include "ast/StringLiteral.h"
+#include "ast/WhileStatement.h"
+#include "evaluator/Resolver.h"
+#include "evaluator/evaluator.h"
+#include "object/Array.h"
+#include "object/Builtin.h"
+#include "object/Function.h"
+#include "object/Hash.h"
+#include "object/Hashable.h"
+#include "object/Integer.h"
+#include "object/String.h"
+#include <cstddef>
+
+namespace evaluator {
+
+void StacklessMachine::start(ast::Node *node, object::Environment *env) {
+    tasks_.clear();
+    values_.clear();
+    acc_ = nullptr;
+    push(Op::EVAL, node, env);
+}
+
+bool StacklessMachine::run(std::size_t steps) {
+    for (std::size_t n = 0; !tasks_.empty() && (steps == 0 || n < steps); n++) {
+        Task task = tasks_.back();
+        tasks_.pop_back();
+        step(task);
+        if (acc_.isAbrupt()) {
+            unwind();
+        }
+    }
+    return tasks_.empty();
+}
+
+object::Object *StacklessMachine::result() const {
+    if (acc_.isError()) {
+        return new object::Error(error_.message());
+    }
+    return acc_.value;
+}
+
+std::size_t StacklessMachine::memoryUsage() const {
+    return tasks_.size() * sizeof(Task) + values_.size() * sizeof(object::Object *);
+}
+
+// An error abandons everything; a return drops the rest of its function and
+// resumes at the CALL_RETURN of the call, or ends a top-level program. A
+// break or continue drops the rest of the loop body and resumes at the
+// loop's WHILE_NEXT or FOR_NEXT, which a break then discards.
+void StacklessMachine::unwind() {
+    if (acc_.isError()) {
+        error_ = lastError;
+        tasks_.clear();
+        values_.clear();
+        return;
+    }
+    bool loopControl = acc_.isBreak() || acc_.isContinue();
+    while (!tasks_.empty()) {
+        Task task = tasks_.back();
+        tasks_.pop_back();
+        if (loopControl && (task.op == Op::WHILE_NEXT || task.op == Op::FOR_NEXT)) {
+            if (acc_.isContinue()) {
+                tasks_.push_back(task);
+            } else {
+                values_.resize(task.base);
+            }
+            acc_ = nullptr;
+            return;
+        } else if (!loopControl && task.op == Op::CALL_RETURN) {
+            acc_.status = object::Result::Status::VALUE;
+            values_.resize(task.base);
+            return;
+        }
+    }
+}
+
+// Tasks are pushed in reverse: the last one pushed runs first.
+void StacklessMachine::eval(ast::Node *node, object::Environment *env) {
+    if (auto program = dynamic_cast<ast::Program *>(node)) {
+        acc_ = nullptr;
+        for (auto it = program->statements.rbegin(); it != program->statements.rend(); ++it) {
+            push(Op::EVAL, it->get(), env);
+        }
+    } else if (auto expression = dynamic_cast<ast::ExpressionStatement *>(node)) {
+        push(Op::EVAL, expression->expression.get(), env);
+    } else if (auto intLiteral = dynamic_cast<ast::IntegerLiteral *>(node)) {
+        acc_ = new object::Integer(intLiteral->valueInt);
+    } else if (auto boolLiteral = dynamic_cast<ast::Boolean *>(node)) {
+        acc_ = nativeBoolToBooleanObject(boolLiteral->valueBool);
+    } else if (auto prefixExpression = dynamic_cast<ast::PrefixExpression *>(node)) {
+        push(Op::PREFIX, node);
+        push(Op::EVAL, prefixExpression->right.get(), env);
+    } else if (auto infixExpression = dynamic_cast<ast::InfixExpression *>(node)) {
+        push(Op::INFIX, node);
+        push(Op::EVAL, infixExpression->right.get(), env);
+        push(Op::PUSH, nullptr);
+        push(Op::EVAL, infixExpression->left.get(), env);
+    } else if (auto blockStatement = dynamic_cast<ast::BlockStatement *>(node)) {
+        acc_ = nullptr;
+        for (auto it = blockStatement->statements.rbegin(); it != blockStatement->statements.rend(); ++it) {
+            push(Op::EVAL, it->get(), env);
+        }
+    } else if (auto ifExpression = dynamic_cast<ast::IfExpression *>(node)) {
+        push(Op::IF, node, env);
+        push(Op::EVAL, ifExpression->condition.get(), env);
+    } else if (auto returnStatement = dynamic_cast<ast::ReturnStatement *>(node)) {
+        push(Op::RETURN, node);
+        push(Op::EVAL, returnStatement->returnValue.get(), env);
+    } else if (auto letStatement = dynamic_cast<ast::LetStatement *>(node)) {
+        push(Op::LET, node, env);
+        push(Op::EVAL, letStatement->value.get(), env);
+    } else if (auto ident = dynamic_cast<ast::Identifier *>(node)) {
+        acc_ = evalIdentifier(ident, env);
+    } else if (auto funcLit = dynamic_cast<ast::FunctionLiteral *>(node)) {
+        if (funcLit->prototype == nullptr) {
+            funcLit->prototype = resolveFunction(funcLit);
+        }
+        acc_ = makeClosure(funcLit->prototype, env);
+    } else if (auto call = dynamic_cast<ast::CallExpression *>(node)) {
+        push(Op::CALL, node);
+        for (auto it = call->arguments.rbegin(); it != call->arguments.rend(); ++it) {
+            push(Op::PUSH, nullptr);
+            push(Op::EVAL, it->get(), env);
+        }
+        push(Op::PUSH, nullptr);
+        push(Op::EVAL, call->function.get(), env);
+    } else if (auto stringLit = dynamic_cast<ast::StringLiteral *>(node)) {
+        if (stringLit->interned == nullptr) {
+            stringLit->interned = object::String::intern(stringLit->valueString);
+        }
+        acc_ = stringLit->interned;
+    } else if (auto arrayLit = dynamic_cast<ast::ArrayLiteral *>(node)) {
+        push(Op::ARRAY, node);
+        for (auto it = arrayLit->elements.rbegin(); it != arrayLit->elements.rend(); ++it) {
+            push(Op::PUSH, nullptr);
+            push(Op::EVAL, it->get(), env);
+        }
+    } else if (auto indexExpression = dynamic_cast<ast::IndexExpression *>(node)) {
+        push(Op::INDEX, node);
+        push(Op::EVAL, indexExpression->index.get(), env);
+        push(Op::PUSH, nullptr);
+        push(Op::EVAL, indexExpression->left.get(), env);
+    } else if (auto hash = dynamic_cast<ast::HashLiteral *>(node)) {
+        push(Op::HASH, node);
+        for (auto it = hash->pairs.rbegin(); it != hash->pairs.rend(); ++it) {
+            push(Op::PUSH, nullptr);
+            push(Op::EVAL, it->second.get(), env);
+            push(Op::HASH_KEY, nullptr);
+            push(Op::EVAL, it->first.get(), env);
+        }
+    } else if (auto assign = dynamic_cast<ast::AssignExpression *>(node)) {
+        if (auto index = dynamic_cast<ast::IndexExpression *>(assign->target.get())) {
+            push(Op::ASSIGN_INDEX, node);
+            push(Op::EVAL, assign->value.get(), env);
+            push(Op::PUSH, nullptr);
+            push(Op::EVAL, index->index.get(), env);
+            push(Op::PUSH, nullptr);
+            push(Op::EVAL, index->left.get(), env);
+        } else {
+            push(Op::ASSIGN, node, env);
+            push(Op::EVAL, assign->value.get(), env);
+        }
+    } else if (auto whileStatement = dynamic_cast<ast::WhileStatement *>(node)) {
+        push(Op::WHILE_TEST, node, env);
+        push(Op::EVAL, whileStatement->condition.get(), env);
+    } else if (auto forStatement = dynamic_cast<ast::ForStatement *>(node)) {
+        push(Op::FOR_START, node, env);
+        push(Op::EVAL, forStatement->iterable.get(), env);
+    } else if (dynamic_cast<ast::BreakStatement *>(node)) {
+        acc_ = object::Result(nullptr, object::Result::Status::BREAK);
+    } else if (dynamic_cast<ast::ContinueStatement *>(node)) {
+        acc_ = object::Result(nullptr, object::Result::Status::CONTINUE);
+    } else {
+        acc_ = nullptr;
+    }
+}
+
+void StacklessMachine::step(const Task &task) {
+    switch (task.op) {
+    case Op::EVAL:
+        eval(task.node, task.env);
+        break;
+    case Op::PUSH:
+        values_.push_back(acc_.value);
+        break;
+    case Op::PREFIX:
+        acc_ = evalPrefixExpression(static_cast<ast::PrefixExpression *>(task.node)->oper, acc_.value);
+        break;
+    case Op::INFIX: {
+        object::Object *left = values_.back();
+        values_.pop_back();
+        acc_ = evalQuickenedInfix(static_cast<ast::InfixExpression *>(task.node), left, acc_.value);
+        break;
+    }
+    case Op::INDEX: {
+        object::Object *left = values_.back();
+        values_.pop_back();
+        acc_ = evalCachedIndexExpression(static_cast<ast::IndexExpression *>(task.node), left, acc_.value);
+        break;
+    }
+    case Op::IF: {
+        auto ifExpression = static_cast<ast::IfExpression *>(task.node);
+        if (isTruthy(acc_.value)) {
+            push(Op::EVAL, ifExpression->consiquence.get(), task.env);
+        } else if (ifExpression->alternative != nullptr) {
+            push(Op::EVAL, ifExpression->alternative.get(), task.env);
+        } else {
+            acc_ = &NULL_OBJECT;
+        }
+        break;
+    }
+    case Op::LET: {
+        auto name = static_cast<ast::LetStatement *>(task.node)->name.get();
+        bindVariable(name->binding, name->value, acc_.value, task.env);
+        acc_ = nullptr;
+        break;
+    }
+    case Op::RETURN:
+        acc_.status = object::Result::Status::RETURN;
+        break;
+    case Op::ARRAY: {
+        object::Array *array = new object::Array();
+        array->elements.assign(values_.begin() + task.base, values_.end());
+        values_.resize(task.base);
+        acc_ = array;
+        break;
+    }
+    case Op::HASH_KEY:
+        if (!object::isHashable(acc_.value)) {
+            acc_ = newError(object::ErrorCode::UNUSABLE_AS_HASH_KEY, "", acc_.value);
+        } else {
+            values_.push_back(acc_.value);
+        }
+        break;
+    case Op::HASH: {
+        object::Hash *result = new object::Hash();
+        for (std::size_t i = task.base; i < values_.size(); i += 2) {
+            result->set(values_[i], values_[i + 1]);
+        }
+        values_.resize(task.base);
+        acc_ = result;
+        break;
+    }
+    case Op::CALL:
+        call(task);
+        break;
+    case Op::CALL_RETURN:
+        break;
+    case Op::WHILE_TEST:
+        if (isTruthy(acc_.value)) {
+            push(Op::WHILE_NEXT, task.node, task.env);
+            push(Op::EVAL, static_cast<ast::WhileStatement *>(task.node)->body.get(), task.env);
+        } else {
+            acc_ = nullptr;
+        }
+        break;
+    case Op::WHILE_NEXT:
+        push(Op::WHILE_TEST, task.node, task.env);
+        push(Op::EVAL, static_cast<ast::WhileStatement *>(task.node)->condition.get(), task.env);
+        break;
+    case Op::FOR_START: {
+        object::Object *source = loopSource(acc_.value);
+        if (source == nullptr) {
+            acc_ = newError(object::ErrorCode::NOT_ITERABLE, "", acc_.value);
+            break;
+        }
+        // the loop keeps its source and the previous element on the value stack
+        values_.push_back(source);
+        values_.push_back(nullptr);
+        nextElement(Task{Op::FOR_NEXT, task.node, task.env, task.base, 0});
+        break;
+    }
+    case Op::FOR_NEXT:
+        nextElement(task);
+        break;
+    case Op::ASSIGN: {
+        auto target = static_cast<ast::AssignExpression *>(task.node)->target.get();
+        acc_ = assignVariable(static_cast<ast::Identifier *>(target), acc_.value, task.env);
+        break;
+    }
+    case Op::ASSIGN_INDEX: {
+        object::Object *index = values_.back();
+        values_.pop_back();
+        object::Object *left = values_.back();
+        values_.pop_back();
+        acc_ = assignIndex(left, index, acc_.value);
+        break;
+    }
+    }
+}
+
+void StacklessMachine::nextElement(const Task &task) {
+    auto loop = static_cast<ast::ForStatement *>(task.node);
+    object::Result next = loopNext(values_[task.base], task.position, values_[task.base + 1]);
+    if (next.isAbrupt()) {
+        acc_ = next;
+        return;
+    } else if (next.value == nullptr) {
+        values_.resize(task.base);
+        acc_ = nullptr;
+        return;
+    }
+    object::Object *element = next.value;
+    values_[task.base + 1] = element;
+    bindVariable(loop->variable->binding, loop->variable->value, element, task.env);
+    tasks_.push_back(Task{Op::FOR_NEXT, task.node, task.env, task.base, task.position + 1});
+    push(Op::EVAL, loop->body.get(), task.env);
+}
+
+// The callee and its arguments are on the value stack from task.base. A
+// Monkey function's body runs as further tasks above a CALL_RETURN; a call
+// in tail position instead drops what is left of the current function and
+// reuses its frame, so tail-recursive loops run in constant space here too.
+void StacklessMachine::call(const Task &task) {
+    object::Object *func = values_[task.base];
+    object::Args args{values_.data() + task.base + 1, values_.size() - task.base - 1};
+    if (func->type() == object::ObjectType::BUILTIN_OBJ) {
+        acc_ = static_cast<object::Builtin *>(func)->fn(args);
+        values_.resize(task.base);
+        return;
+    } else if (func->type() != object::ObjectType::FUNCTION_OBJ) {
+        acc_ = newError(object::ErrorCode::NOT_A_FUNCTION, "", func);
+        return;
+    }
+    auto funcObj = static_cast<object::Function *>(func);
+    const object::FunctionPrototype *prototype = funcObj->prototype.get();
+    if (args.size() != prototype->arity) {
+        acc_ = newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, prototype->arity, args.size());
+        return;
+    }
+
+    object::Environment *frame;
+    if (static_cast<ast::CallExpression *>(task.node)->tail) {
+        while (tasks_.back().op != Op::CALL_RETURN) {
+            tasks_.pop_back();
+        }
+        frame = tasks_.back().env;
+        initFrame(frame, funcObj, args);
+        values_.resize(tasks_.back().base);
+    } else {
+        if (memoryUsage() > memoryBudget_) {
+            acc_ = newError(object::ErrorCode::BUDGET_EXCEEDED, static_cast<long>(memoryBudget_), 0L);
+            return;
+        }
+        frame = extendFunctionEnvironment(funcObj, args);
+        values_.resize(task.base);
+        push(Op::CALL_RETURN, nullptr, frame);
+    }
+    push(Op::EVAL, prototype->body.get(), frame);
+}
+
+object::Object *evalStackless(ast::Node *node, object::Environment *env, std::size_t memoryBudget) {
+    StacklessMachine machine(memoryBudget);
+    machine.start(node, env);
+    machine.run();
+    return machine.result();
+}
+
+} // namespace evaluator
@@ -0,0 +1,141 @@
+#include "evaluator/Superinstructions.h"
+#include "ast/CallExpression.h"
+#include "ast/Identifier.h"
+#include "ast/IndexExpression.h"
+#include "ast/InfixExpression.h"
+#include "ast/IntegerLiteral.h"
+#include "evaluator/Resolver.h"
+#include "object/Integer.h"
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+namespace evaluator {
+
+FusionSet enabledFusions = defaultFusions();
+FusionProfile *fusionProfile = nullptr;
+
+namespace {
+
+bool isLocal(ast::Expression *expression) {
+    auto ident = dynamic_cast<ast::Identifier *>(expression);
+    return ident != nullptr && ident->binding.kind == ast::BindingKind::LOCAL;
+}
+
+void fuse(ast::Node *node) {
+    if (node == nullptr) {
+        return;
+    }
+    if (auto expression = dynamic_cast<ast::Expression *>(node)) {
+        ast::Fusion fusion = fusionOf(expression);
+        if (fusion != ast::Fusion::NONE && enabledFusions.test(static_cast<std::size_t>(fusion))) {
+            if (auto infix = dynamic_cast<ast::InfixExpression *>(expression)) {
+                infix->fusion = fusion;
+                if (auto literal = dynamic_cast<ast::IntegerLiteral *>(infix->right.get())) {
+                    literal->constant = new object::Integer(literal->valueInt);
+                }
+            } else if (auto index = dynamic_cast<ast::IndexExpression *>(expression)) {
+                index->fusion = fusion;
+            } else if (auto call = dynamic_cast<ast::CallExpression *>(expression)) {
+                call->fusion = fusion;
+            }
+        }
+    }
+    forEachChild(node, fuse);
+}
+
+} // namespace
+
+// Counts from `interpreter --profile` over fib(24), a counting loop, a
+// summing loop over an array and a loop bounded by a parameter, on the
+// tree walker. Rerun it when the fusable shapes change.
+const FusionProfile defaultProfile = {{
+    0,       // NONE
+    1600098, // LOCAL_OP_CONST
+    100001,  // LOCAL_OP_LOCAL
+    300000,  // INDEX_BY_LOCAL
+    300003,  // CALL_LOCAL
+    150048,  // CALL_NAMED
+}};
+
+FusionSet defaultFusions() { return chooseFusions(defaultProfile, 0.01); }
+
+FusionSet allFusions() {
+    FusionSet all;
+    all.set();
+    all.reset(static_cast<std::size_t>(ast::Fusion::NONE));
+    return all;
+}
+
+FusionSet chooseFusions(const FusionProfile &profile, double minimumShare) {
+    unsigned long total = 0;
+    for (unsigned long count : profile.counts) {
+        total += count;
+    }
+    FusionSet chosen;
+    for (std::size_t i = 1; i < FUSION_COUNT; i++) {
+        if (total > 0 && profile.counts[i] > 0 &&
+            static_cast<double>(profile.counts[i]) >= minimumShare * static_cast<double>(total)) {
+            chosen.set(i);
+        }
+    }
+    return chosen;
+}
+
+const char *fusionName(ast::Fusion fusion) {
+    switch (fusion) {
+    case ast::Fusion::NONE:
+        return "NONE";
+    case ast::Fusion::LOCAL_OP_CONST:
+        return "LOCAL_OP_CONST";
+    case ast::Fusion::LOCAL_OP_LOCAL:
+        return "LOCAL_OP_LOCAL";
+    case ast::Fusion::INDEX_BY_LOCAL:
+        return "INDEX_BY_LOCAL";
+    case ast::Fusion::CALL_LOCAL:
+        return "CALL_LOCAL";
+    case ast::Fusion::CALL_NAMED:
+        return "CALL_NAMED";
+    }
+    return "?";
+}
+
+ast::Fusion fusionOf(ast::Expression *expression) {
+    if (auto infix = dynamic_cast<ast::InfixExpression *>(expression)) {
+        if (!isLocal(infix->left.get())) {
+            return ast::Fusion::NONE;
+        } else if (dynamic_cast<ast::IntegerLiteral *>(infix->right.get())) {
+            return ast::Fusion::LOCAL_OP_CONST;
+        } else if (isLocal(infix->right.get())) {
+            return ast::Fusion::LOCAL_OP_LOCAL;
+        }
+    } else if (auto index = dynamic_cast<ast::IndexExpression *>(expression)) {
+        if (dynamic_cast<ast::Identifier *>(index->left.get()) && isLocal(index->index.get())) {
+            return ast::Fusion::INDEX_BY_LOCAL;
+        }
+    } else if (auto call = dynamic_cast<ast::CallExpression *>(expression)) {
+        if (dynamic_cast<ast::Identifier *>(call->function.get()) && call->arguments.size() == 1) {
+            return isLocal(call->arguments[0].get()) ? ast::Fusion::CALL_LOCAL : ast::Fusion::CALL_NAMED;
+        }
+    }
+    return ast::Fusion::NONE;
+}
+
+void fuseSuperinstructions(ast::FunctionLiteral *literal) { fuse(literal); }
+
+std::string formatProfile(const FusionProfile &profile) {
+    unsigned long total = 0;
+    for (unsigned long count : profile.counts) {
+        total += count;
+    }
+    std::stringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(1);
+    for (std::size_t i = 1; i < FUSION_COUNT; i++) {
+        double share = total == 0 ? 0 : 100.0 * static_cast<double>(profile.counts[i]) / static_cast<double>(total);
+        out << fusionName(static_cast<ast::Fusion>(i)) << '\t' << profile.counts[i] << '\t' << share << "%\n";
+    }
+    return out.str();
+}
+
+} // namespace evaluator
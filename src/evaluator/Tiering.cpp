@@ -0,0 +1,351 @@
+#include "evaluator/Tiering.h"
+#include "ast/StringLiteral.h"
+#include "evaluator/Compiler.h"
+#include "evaluator/FunctionProfile.h"
+#include "evaluator/Jit.h"
+#include "evaluator/Optimizer.h"
+#include "evaluator/RegisterMachine.h"
+#include "evaluator/Resolver.h"
+#include "evaluator/Superinstructions.h"
+#include "evaluator/evaluator.h"
+#include "object/String.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace evaluator {
+
+TierPolicy tierPolicy{0, 0, 0, false};
+TierStats *tierStats = nullptr;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point from) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - from).count();
+}
+
+// The time of the first counted call.
+Clock::time_point start() {
+    static const Clock::time_point first = Clock::now();
+    return first;
+}
+
+// A compile handed to the worker, and its result.
+struct Job {
+    const object::FunctionPrototype *prototype;
+    Tier tier;
+    std::unique_ptr<CodeBlock> code;
+    std::unique_ptr<NativeCode> native;
+    std::unique_ptr<OptimizedCode> optimized;
+    double compileMilliseconds = 0;
+};
+
+void compile(Job &job) {
+    Clock::time_point begin = Clock::now();
+    if (job.tier == Tier::BYTECODE) {
+        job.code = compileFunction(*job.prototype);
+    } else if (job.tier == Tier::NATIVE) {
+        job.native = compileNative(job.prototype);
+    } else {
+        job.optimized = compileOptimized(job.prototype);
+    }
+    job.compileMilliseconds = millisecondsSince(begin);
+}
+
+// The background compiler. Jobs are submitted and their results installed
+// on the main thread; the worker only builds new code from the function's
+// AST. The tree walker keeps writing to that AST while the worker runs:
+// quickening rewrites InfixExpression::form and deopts, the record inline
+// cache IndexExpression::cached*, and fusion fills IntegerLiteral::constant.
+// compileFunction reads none of those (see Compiler.h), and the one field
+// it would write, StringLiteral::interned, is filled in beforehand by
+// prepareForWorker. Every other field it reads is set by the resolver
+// before the function's first call and not changed after.
+class Worker {
+  public:
+    ~Worker() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    void submit(Job job) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!thread_.joinable()) {
+            thread_ = std::thread(&Worker::run, this);
+        }
+        pending_.push_back(std::move(job));
+        unfinished_++;
+        wake_.notify_one();
+    }
+
+    // Whether collect() has anything to return, without taking the lock.
+    bool ready() const { return ready_.load(std::memory_order_acquire); }
+
+    // Takes the finished jobs; with `wait`, after every submitted job has
+    // finished.
+    std::vector<Job> collect(bool wait) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (wait) {
+            idle_.wait(lock, [this] { return unfinished_ == 0; });
+        }
+        ready_.store(false, std::memory_order_relaxed);
+        std::vector<Job> finished;
+        finished.swap(finished_);
+        return finished;
+    }
+
+  private:
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<Job> pending_;
+    std::vector<Job> finished_;
+    std::size_t unfinished_ = 0;
+    bool stopping_ = false;
+    std::atomic<bool> ready_{false};
+    std::thread thread_;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            wake_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            Job job = std::move(pending_.front());
+            pending_.pop_front();
+            lock.unlock();
+            compile(job);
+            lock.lock();
+            finished_.push_back(std::move(job));
+            unfinished_--;
+            ready_.store(true, std::memory_order_release);
+            idle_.notify_all();
+        }
+    }
+};
+
+Worker &worker() {
+    static Worker worker;
+    return worker;
+}
+
+// The compiler interns string literals on first use; doing it here keeps
+// the worker from racing the tree walker for the intern table.
+void prepareForWorker(ast::Node *node) {
+    if (node == nullptr) {
+        return;
+    }
+    if (auto literal = dynamic_cast<ast::StringLiteral *>(node)) {
+        if (literal->interned == nullptr) {
+            literal->interned = object::String::intern(literal->valueString);
+        }
+    }
+    forEachChild(node, prepareForWorker);
+}
+
+bool reached(unsigned threshold, unsigned calls) { return threshold != 0 && calls >= threshold; }
+
+Tier targetTier(const object::FunctionPrototype *prototype) {
+    FunctionProfile &profile = profileOf(prototype);
+    if (jitEnabled && !profile.optimizedFailed && reached(tierPolicy.optimizedThreshold, profile.callCount) &&
+        optimizerAvailable()) {
+        return Tier::OPTIMIZED;
+    } else if (jitEnabled && !profile.nativeFailed && reached(tierPolicy.nativeThreshold, profile.callCount)) {
+        return Tier::NATIVE;
+    } else if (reached(tierPolicy.bytecodeThreshold, profile.callCount)) {
+        return Tier::BYTECODE;
+    }
+    return Tier::TREE;
+}
+
+void switchTier(const object::FunctionPrototype *prototype, Tier tier, unsigned calls, double compileMilliseconds) {
+    profileOf(prototype).tier = tier;
+    if (tierStats != nullptr) {
+        tierStats->promotions.push_back(
+            Promotion{prototype, tier, calls, millisecondsSince(start()), compileMilliseconds});
+    }
+}
+
+void install(Job &job) {
+    const object::FunctionPrototype *prototype = job.prototype;
+    FunctionProfile &profile = profileOf(prototype);
+    profile.compiling = false;
+    if (job.tier == Tier::BYTECODE) {
+        if (profile.code == nullptr) {
+            profile.code = std::move(job.code);
+        }
+    } else if (job.tier == Tier::NATIVE) {
+        profile.nativeFailed = job.native == nullptr;
+        profile.native = std::move(job.native);
+        if (profile.nativeFailed) {
+            return;
+        }
+    } else {
+        profile.optimizedFailed = job.optimized == nullptr;
+        profile.optimized = std::move(job.optimized);
+        if (profile.optimizedFailed) {
+            return;
+        }
+    }
+    if (job.tier > profile.tier) {
+        switchTier(prototype, job.tier, profile.callCount, job.compileMilliseconds);
+    }
+}
+
+// Compiles the function for `tier`; false, with the failure recorded, if
+// it cannot run there.
+bool compileTier(const object::FunctionPrototype *prototype, Tier tier) {
+    FunctionProfile &profile = profileOf(prototype);
+    switch (tier) {
+    case Tier::OPTIMIZED:
+        profile.optimized = compileOptimized(prototype);
+        profile.optimizedFailed = profile.optimized == nullptr;
+        return !profile.optimizedFailed;
+    case Tier::NATIVE:
+        profile.native = compileNative(prototype);
+        profile.nativeFailed = profile.native == nullptr;
+        return !profile.nativeFailed;
+    case Tier::BYTECODE:
+        functionCode(prototype);
+        return true;
+    case Tier::TREE:
+        return true;
+    }
+    return true;
+}
+
+void promote(const object::FunctionPrototype *prototype, Tier tier) {
+    FunctionProfile &profile = profileOf(prototype);
+    if (tierPolicy.background) {
+        prepareForWorker(prototype->body.get());
+        profile.compiling = true;
+        worker().submit(Job{prototype, tier, nullptr, nullptr, nullptr});
+        return;
+    }
+    Clock::time_point begin = Clock::now();
+    while (tier > profile.tier && !compileTier(prototype, tier)) {
+        tier = targetTier(prototype);
+    }
+    if (tier > profile.tier) {
+        switchTier(prototype, tier, profile.callCount, millisecondsSince(begin));
+    }
+}
+
+std::string functionName(const object::FunctionPrototype *prototype) {
+    std::string name = "fn(";
+    for (std::size_t i = 0; i < prototype->parameters.size(); i++) {
+        name += (i > 0 ? ", " : "") + prototype->parameters[i];
+    }
+    return name + ")";
+}
+
+} // namespace
+
+const char *tierName(Tier tier) {
+    switch (tier) {
+    case Tier::TREE:
+        return "tree";
+    case Tier::BYTECODE:
+        return "bytecode";
+    case Tier::NATIVE:
+        return "native";
+    case Tier::OPTIMIZED:
+        return "optimized";
+    }
+    return "?";
+}
+
+Tier enterTier(const object::FunctionPrototype *prototype) {
+    // a superinstruction profile counts what the tree walker runs
+    if (fusionProfile != nullptr) {
+        return Tier::TREE;
+    }
+    FunctionProfile &profile = profileOf(prototype);
+    if (profile.callCount++ == 0) {
+        start();
+    }
+    if (profile.tier == Tier::OPTIMIZED) {
+        return Tier::OPTIMIZED;
+    }
+    if (profile.compiling) {
+        if (worker().ready()) {
+            for (Job &job : worker().collect(false)) {
+                install(job);
+            }
+        }
+    }
+    if (!profile.compiling) {
+        Tier target = targetTier(prototype);
+        if (target > profile.tier) {
+            promote(prototype, target);
+        }
+    }
+    if (profile.tier == Tier::NATIVE && nativeDepth >= MAX_NATIVE_DEPTH) {
+        return Tier::BYTECODE;
+    }
+    return profile.tier;
+}
+
+bool callOptimized(object::Function *func, object::Args args, object::Result &result) {
+    FunctionProfile &profile = profileOf(func->prototype.get());
+    if (runOptimized(profile.optimized.get(), func, args, result)) {
+        return true;
+    }
+    if (++profile.optimizedDeopts >= MAX_DEOPTS) {
+        profile.optimizedFailed = true;
+        profile.tier = profile.native != nullptr ? Tier::NATIVE : Tier::BYTECODE;
+    }
+    return false;
+}
+
+object::Result callCompiled(object::Function *func, object::Args args) {
+    FunctionProfile &profile = profileOf(func->prototype.get());
+    object::Result result = nullptr;
+    if (profile.optimized != nullptr && !profile.optimizedFailed && callOptimized(func, args, result)) {
+        return result;
+    } else if (profile.native == nullptr || nativeDepth >= MAX_NATIVE_DEPTH) {
+        return callRegisterMachine(func, args);
+    }
+    result = runNative(profile.native.get(), func, args);
+    if (result.isTailCall()) {
+        return applyFunction(result.value, object::Args{tailArguments.data(), tailArguments.size()});
+    }
+    return result;
+}
+
+void finishBackgroundCompilation() {
+    for (Job &job : worker().collect(true)) {
+        install(job);
+    }
+}
+
+std::string formatTierStats(const TierStats &stats) {
+    std::stringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    for (const Promotion &promotion : stats.promotions) {
+        out << functionName(promotion.prototype) << '\t' << tierName(promotion.tier) << "\tafter "
+            << promotion.calls << " calls\tat " << promotion.atMilliseconds << " ms\tcompiled in "
+            << promotion.compileMilliseconds << " ms\n";
+    }
+    return out.str();
+}
+
+} // namespace evaluator
@@ -0,0 +1,511 @@
+#include "evaluator/TypeInference.h"
+#include "ast/Boolean.h"
+#include "ast/IntegerLiteral.h"
+#include "evaluator/Resolver.h"
+#include "object/FunctionPrototype.h"
+#include <cstddef>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace evaluator {
+
+namespace {
+
+// The types as the inference tracks them: NONE, no value seen yet, is below
+// the proven types and UNKNOWN above them.
+enum class Inferred : unsigned char { NONE, INTEGER, BOOLEAN, UNKNOWN };
+
+Inferred join(Inferred left, Inferred right) {
+    if (left == Inferred::NONE) {
+        return right;
+    } else if (right == Inferred::NONE || left == right) {
+        return left;
+    }
+    return Inferred::UNKNOWN;
+}
+
+ast::StaticType staticType(Inferred type) {
+    switch (type) {
+    case Inferred::INTEGER:
+        return ast::StaticType::INTEGER;
+    case Inferred::BOOLEAN:
+        return ast::StaticType::BOOLEAN;
+    case Inferred::NONE:
+    case Inferred::UNKNOWN:
+        break;
+    }
+    return ast::StaticType::UNKNOWN;
+}
+
+const char *typeName(ast::StaticType type) {
+    switch (type) {
+    case ast::StaticType::INTEGER:
+        return "integer";
+    case ast::StaticType::BOOLEAN:
+        return "boolean";
+    case ast::StaticType::UNKNOWN:
+        break;
+    }
+    return "unknown";
+}
+
+// A global, or a local, cell or parameter of one function literal; every
+// closure of the literal has its own copy, but they all hold the same types.
+struct Variable {
+    bool global = false;
+    bool parameter = false;
+    // never read before it is stored to
+    bool initialized = false;
+    Inferred type = Inferred::NONE;
+    // lets, assignments and loops that store to the variable
+    int stores = 0;
+    // the function literal a `let` stores, which tells the literal's callers
+    // if it is the only store and the variable is only ever called
+    ast::FunctionLiteral *function = nullptr;
+    bool escapes = false;
+    std::vector<ast::CallExpression *> calls;
+    // every identifier naming the variable, in program order
+    std::vector<ast::Identifier *> occurrences;
+};
+
+struct Function {
+    ast::FunctionLiteral *literal = nullptr;
+    Function *parent = nullptr;
+    std::vector<Variable *> parameters;
+    std::vector<ast::ReturnStatement *> returns;
+    // the variable through which every call of the function is made, if any
+    Variable *holder = nullptr;
+    Inferred result = Inferred::NONE;
+};
+
+// A value stored to a variable: an expression, or the elements of a loop.
+struct Store {
+    Variable *variable;
+    ast::Expression *value;
+    ast::ForStatement *loop;
+};
+
+// A variable read, as the callee of `call` or (nullptr) as a value.
+struct Read {
+    ast::Identifier *ident;
+    Variable *variable;
+    ast::CallExpression *call;
+};
+
+class Inference {
+  public:
+    void run(ast::Program *program) {
+        for (const auto &statement : program->statements) {
+            resolve(statement.get());
+        }
+        for (const auto &statement : program->statements) {
+            collect(statement.get(), nullptr);
+        }
+        for (const auto &statement : program->statements) {
+            checkInitialization(statement.get());
+        }
+        for (const Read &read : reads_) {
+            use(read.variable, read.call);
+            // a local read before its store falls back to the global of that name
+            if (!read.variable->global && !read.variable->initialized) {
+                use(global(read.ident->value), read.call);
+            }
+        }
+        findCallers(globals_);
+        findCallers(locals_);
+        solve();
+        for (const auto &entry : variables_) {
+            entry.first->type = staticType(typeOf(entry.second));
+        }
+        for (const auto &statement : program->statements) {
+            annotate(statement.get());
+        }
+    }
+
+  private:
+    using LocalKey = std::tuple<const ast::FunctionLiteral *, bool, int>;
+
+    std::map<std::string, Variable> globals_;
+    std::map<LocalKey, Variable> locals_;
+    std::map<const ast::FunctionLiteral *, Function> functions_;
+    std::map<ast::Identifier *, Variable *> variables_;
+    std::vector<Store> stores_;
+    std::vector<Read> reads_;
+
+    static void resolve(ast::Node *node) {
+        if (node == nullptr) {
+            return;
+        }
+        if (auto literal = dynamic_cast<ast::FunctionLiteral *>(node)) {
+            if (literal->prototype == nullptr) {
+                literal->prototype = resolveFunction(literal);
+            }
+            return;
+        }
+        forEachChild(node, resolve);
+    }
+
+    Variable *global(const std::string &name) {
+        Variable *variable = &globals_[name];
+        variable->global = true;
+        return variable;
+    }
+
+    // The cell an upvalue of `function` reaches, through the captures of
+    // the functions it is nested in.
+    Variable *upvalue(Function *function, int index) {
+        const object::FunctionPrototype::Capture &capture = function->literal->prototype->captures[index];
+        if (capture.fromCell) {
+            return &locals_[LocalKey{function->parent->literal, true, capture.index}];
+        }
+        return upvalue(function->parent, capture.index);
+    }
+
+    Variable *variable(ast::Identifier *ident, Function *owner) {
+        Variable *variable = nullptr;
+        switch (ident->binding.kind) {
+        case ast::BindingKind::GLOBAL:
+            variable = global(ident->value);
+            break;
+        case ast::BindingKind::LOCAL:
+            variable = &locals_[LocalKey{owner->literal, false, ident->binding.index}];
+            break;
+        case ast::BindingKind::CELL:
+            variable = &locals_[LocalKey{owner->literal, true, ident->binding.index}];
+            break;
+        case ast::BindingKind::UPVALUE:
+            variable = upvalue(owner, ident->binding.index);
+            break;
+        }
+        variable->occurrences.push_back(ident);
+        variables_[ident] = variable;
+        return variable;
+    }
+
+    void store(Variable *variable, ast::Expression *value, ast::ForStatement *loop) {
+        variable->stores++;
+        stores_.push_back(Store{variable, value, loop});
+    }
+
+    // Records the variables of `node`, and what is stored to and read from
+    // them; `owner` is the function the node is in, nullptr at top level.
+    void collect(ast::Node *node, Function *owner) {
+        if (node == nullptr) {
+            return;
+        }
+        if (auto ident = dynamic_cast<ast::Identifier *>(node)) {
+            reads_.push_back(Read{ident, variable(ident, owner), nullptr});
+        } else if (auto let = dynamic_cast<ast::LetStatement *>(node)) {
+            Variable *target = variable(let->name.get(), owner);
+            store(target, let->value.get(), nullptr);
+            if (auto literal = dynamic_cast<ast::FunctionLiteral *>(let->value.get())) {
+                target->function = literal;
+            }
+            collect(let->value.get(), owner);
+        } else if (auto assign = dynamic_cast<ast::AssignExpression *>(node);
+                   assign != nullptr && dynamic_cast<ast::Identifier *>(assign->target.get()) != nullptr) {
+            store(variable(static_cast<ast::Identifier *>(assign->target.get()), owner), assign->value.get(), nullptr);
+            collect(assign->value.get(), owner);
+        } else if (auto loop = dynamic_cast<ast::ForStatement *>(node)) {
+            store(variable(loop->variable.get(), owner), nullptr, loop);
+            collect(loop->iterable.get(), owner);
+            collect(loop->body.get(), owner);
+        } else if (auto call = dynamic_cast<ast::CallExpression *>(node)) {
+            if (auto callee = dynamic_cast<ast::Identifier *>(call->function.get())) {
+                reads_.push_back(Read{callee, variable(callee, owner), call});
+            } else {
+                collect(call->function.get(), owner);
+            }
+            for (const auto &argument : call->arguments) {
+                collect(argument.get(), owner);
+            }
+        } else if (auto literal = dynamic_cast<ast::FunctionLiteral *>(node)) {
+            Function &function = functions_[literal];
+            function.literal = literal;
+            function.parent = owner;
+            for (const auto &parameter : literal->parameters) {
+                Variable *variable = this->variable(parameter.get(), &function);
+                variable->parameter = true;
+                variable->initialized = true;
+                function.parameters.push_back(variable);
+            }
+            collect(literal->body.get(), &function);
+        } else {
+            if (auto ret = dynamic_cast<ast::ReturnStatement *>(node); ret != nullptr && owner != nullptr) {
+                owner->returns.push_back(ret);
+            }
+            forEachChild(node, [&](ast::Node *child) { collect(child, owner); });
+        }
+    }
+
+    std::size_t count(ast::Node *node, const Variable *variable) {
+        if (node == nullptr) {
+            return 0;
+        }
+        std::size_t occurrences = 0;
+        if (auto ident = dynamic_cast<ast::Identifier *>(node)) {
+            occurrences += variables_.at(ident) == variable;
+        }
+        forEachChild(node, [&](ast::Node *child) { occurrences += count(child, variable); });
+        return occurrences;
+    }
+
+    // Whether the store that `name` is the target of runs before any other
+    // use of its variable: it comes first, `value` (the stored value, or a
+    // loop's iterable) does not read the variable, and every use is inside
+    // `scope`, the code after the store that runs only once it has.
+    bool storedFirst(ast::Identifier *name, ast::Node *value, const std::vector<ast::Node *> &scope) {
+        Variable *variable = variables_.at(name);
+        if (variable->global || variable->occurrences.front() != name || count(value, variable) != 0) {
+            return false;
+        }
+        std::size_t occurrences = 0;
+        for (ast::Node *node : scope) {
+            occurrences += count(node, variable);
+        }
+        return occurrences == variable->occurrences.size();
+    }
+
+    void checkInitialization(ast::Node *node) {
+        if (node == nullptr) {
+            return;
+        }
+        if (auto block = dynamic_cast<ast::BlockStatement *>(node)) {
+            for (std::size_t i = 0; i < block->statements.size(); i++) {
+                auto let = dynamic_cast<ast::LetStatement *>(block->statements[i].get());
+                if (let == nullptr) {
+                    continue;
+                }
+                std::vector<ast::Node *> rest;
+                for (std::size_t j = i; j < block->statements.size(); j++) {
+                    rest.push_back(block->statements[j].get());
+                }
+                if (storedFirst(let->name.get(), let->value.get(), rest)) {
+                    variables_.at(let->name.get())->initialized = true;
+                }
+            }
+        } else if (auto loop = dynamic_cast<ast::ForStatement *>(node)) {
+            if (storedFirst(loop->variable.get(), loop->iterable.get(), {loop})) {
+                variables_.at(loop->variable.get())->initialized = true;
+            }
+        }
+        forEachChild(node, [this](ast::Node *child) { checkInitialization(child); });
+    }
+
+    static void use(Variable *variable, ast::CallExpression *call) {
+        if (call != nullptr) {
+            variable->calls.push_back(call);
+        } else {
+            variable->escapes = true;
+        }
+    }
+
+    // A function literal that is the only value of a variable used for
+    // nothing but calls is called from those calls alone.
+    template <typename Variables> void findCallers(Variables &variables) {
+        for (auto &entry : variables) {
+            Variable &variable = entry.second;
+            if (variable.function != nullptr && variable.stores == 1 && !variable.escapes && !variable.parameter) {
+                functions_.at(variable.function).holder = &variable;
+            }
+        }
+    }
+
+    static Inferred typeOf(const Variable *variable) {
+        return variable->global || !variable->initialized ? Inferred::UNKNOWN : variable->type;
+    }
+
+    // The value of a block, as its last statement leaves it.
+    Inferred blockType(ast::BlockStatement *block) {
+        if (block == nullptr || block->statements.empty()) {
+            return Inferred::UNKNOWN;
+        }
+        ast::Statement *last = block->statements.back().get();
+        if (auto expression = dynamic_cast<ast::ExpressionStatement *>(last)) {
+            return typeOf(expression->expression.get());
+        } else if (dynamic_cast<ast::ReturnStatement *>(last)) {
+            return Inferred::NONE;
+        } else if (auto inner = dynamic_cast<ast::BlockStatement *>(last)) {
+            return blockType(inner);
+        }
+        return Inferred::UNKNOWN;
+    }
+
+    Inferred typeOf(ast::Expression *expression) {
+        if (expression == nullptr) {
+            return Inferred::UNKNOWN;
+        } else if (dynamic_cast<ast::IntegerLiteral *>(expression)) {
+            return Inferred::INTEGER;
+        } else if (dynamic_cast<ast::Boolean *>(expression)) {
+            return Inferred::BOOLEAN;
+        } else if (auto ident = dynamic_cast<ast::Identifier *>(expression)) {
+            return typeOf(variables_.at(ident));
+        } else if (auto prefix = dynamic_cast<ast::PrefixExpression *>(expression)) {
+            if (prefix->oper == "!") {
+                return Inferred::BOOLEAN;
+            }
+            Inferred right = typeOf(prefix->right.get());
+            return right == Inferred::NONE || right == Inferred::INTEGER ? right : Inferred::UNKNOWN;
+        } else if (auto infix = dynamic_cast<ast::InfixExpression *>(expression)) {
+            return infixType(infix);
+        } else if (auto ifExpression = dynamic_cast<ast::IfExpression *>(expression)) {
+            Inferred alternative =
+                ifExpression->alternative != nullptr ? blockType(ifExpression->alternative.get()) : Inferred::UNKNOWN;
+            return join(blockType(ifExpression->consiquence.get()), alternative);
+        } else if (auto call = dynamic_cast<ast::CallExpression *>(expression)) {
+            auto callee = dynamic_cast<ast::Identifier *>(call->function.get());
+            if (callee == nullptr) {
+                return Inferred::UNKNOWN;
+            }
+            // an uninitialized local callee may be the global of that name
+            Variable *variable = variables_.at(callee);
+            if (variable->function == nullptr || (!variable->global && !variable->initialized) ||
+                functions_.at(variable->function).holder != variable) {
+                return Inferred::UNKNOWN;
+            }
+            return functions_.at(variable->function).result;
+        } else if (auto assign = dynamic_cast<ast::AssignExpression *>(expression)) {
+            if (dynamic_cast<ast::Identifier *>(assign->target.get())) {
+                return typeOf(assign->value.get());
+            }
+        }
+        return Inferred::UNKNOWN;
+    }
+
+    Inferred infixType(ast::InfixExpression *infix) {
+        Inferred left = typeOf(infix->left.get());
+        Inferred right = typeOf(infix->right.get());
+        const std::string &oper = infix->oper;
+        if (left == Inferred::NONE || right == Inferred::NONE) {
+            return Inferred::NONE;
+        } else if (left != right || left == Inferred::UNKNOWN) {
+            return Inferred::UNKNOWN;
+        } else if (oper == "==" || oper == "!=") {
+            return Inferred::BOOLEAN;
+        } else if (left != Inferred::INTEGER) {
+            return Inferred::UNKNOWN;
+        } else if (oper == "<" || oper == ">") {
+            return Inferred::BOOLEAN;
+        } else if (oper == "+" || oper == "-" || oper == "*" || oper == "/") {
+            return Inferred::INTEGER;
+        }
+        return Inferred::UNKNOWN;
+    }
+
+    // The elements of a loop over range() are integers.
+    Inferred loopType(ast::ForStatement *loop) {
+        auto call = dynamic_cast<ast::CallExpression *>(loop->iterable.get());
+        auto callee = call != nullptr ? dynamic_cast<ast::Identifier *>(call->function.get()) : nullptr;
+        if (callee != nullptr && callee->binding.kind == ast::BindingKind::GLOBAL && callee->value == "range" &&
+            global("range")->stores == 0) {
+            return Inferred::INTEGER;
+        }
+        return Inferred::UNKNOWN;
+    }
+
+    // Raises every type to the join of what can be stored to it, until
+    // nothing changes; types only go up, so this terminates.
+    void solve() {
+        bool changed = true;
+        auto raise = [&changed](Inferred &type, Inferred value) {
+            Inferred joined = join(type, value);
+            if (joined != type) {
+                type = joined;
+                changed = true;
+            }
+        };
+        for (auto &entry : functions_) {
+            if (entry.second.holder == nullptr) {
+                for (Variable *parameter : entry.second.parameters) {
+                    parameter->type = Inferred::UNKNOWN;
+                }
+            }
+        }
+        while (changed) {
+            changed = false;
+            for (const Store &store : stores_) {
+                raise(store.variable->type, store.loop != nullptr ? loopType(store.loop) : typeOf(store.value));
+            }
+            for (auto &entry : functions_) {
+                Function &function = entry.second;
+                if (function.holder != nullptr) {
+                    for (ast::CallExpression *call : function.holder->calls) {
+                        if (call->arguments.size() != function.parameters.size()) {
+                            continue;
+                        }
+                        for (std::size_t i = 0; i < call->arguments.size(); i++) {
+                            raise(function.parameters[i]->type, typeOf(call->arguments[i].get()));
+                        }
+                    }
+                }
+                for (ast::ReturnStatement *ret : function.returns) {
+                    raise(function.result, typeOf(ret->returnValue.get()));
+                }
+                raise(function.result, blockType(function.literal->body.get()));
+            }
+        }
+    }
+
+    void annotate(ast::Node *node) {
+        if (node == nullptr) {
+            return;
+        }
+        if (auto infix = dynamic_cast<ast::InfixExpression *>(node)) {
+            infix->type = staticType(infixType(infix));
+        }
+        forEachChild(node, [this](ast::Node *child) { annotate(child); });
+    }
+};
+
+struct Section {
+    std::string header;
+    std::string lines;
+    std::set<std::string> variables;
+};
+
+void dump(ast::Node *node, std::vector<Section> &sections, std::size_t current) {
+    if (node == nullptr) {
+        return;
+    }
+    if (auto literal = dynamic_cast<ast::FunctionLiteral *>(node)) {
+        std::string header = "fn(";
+        for (std::size_t i = 0; i < literal->parameters.size(); i++) {
+            header += (i > 0 ? ", " : "") + literal->parameters[i]->value;
+        }
+        sections.push_back(Section{header + ")", "", {}});
+        current = sections.size() - 1;
+    } else if (auto ident = dynamic_cast<ast::Identifier *>(node)) {
+        if (ident->type != ast::StaticType::UNKNOWN && sections[current].variables.insert(ident->value).second) {
+            sections[current].lines += "    " + ident->value + ": " + typeName(ident->type) + "\n";
+        }
+    } else if (auto infix = dynamic_cast<ast::InfixExpression *>(node)) {
+        if (infix->type != ast::StaticType::UNKNOWN) {
+            sections[current].lines += "    " + infix->toString() + ": " + typeName(infix->type) + "\n";
+        }
+    }
+    forEachChild(node, [&](ast::Node *child) { dump(child, sections, current); });
+}
+
+} // namespace
+
+void inferTypes(ast::Program *program) { Inference().run(program); }
+
+std::string dumpTypes(ast::Program *program) {
+    std::vector<Section> sections{Section{"program", "", {}}};
+    for (const auto &statement : program->statements) {
+        dump(statement.get(), sections, 0);
+    }
+    std::stringstream out;
+    for (const Section &section : sections) {
+        if (&section != &sections.front() || !section.lines.empty()) {
+            out << section.header << ":\n" << section.lines;
+        }
+    }
+    return out.str();
+}
+
+} // namespace evaluator
@@ -1,9 +1,13 @@
 #include "evaluator/evaluator.h"
 #include "ast/ArrayLiteral.h"
+#include "ast/AssignExpression.h"
 #include "ast/BlockStatement.h"
 #include "ast/Boolean.h"
+#include "ast/BreakStatement.h"
 #include "ast/CallExpression.h"
+#include "ast/ContinueStatement.h"
 #include "ast/ExpressionStatement.h"
+#include "ast/ForStatement.h"
 #include "ast/FunctionLiteral.h"
 #include "ast/HashLiteral.h"
 #include "ast/IfExpression.h"
@@ -15,18 +19,31 @@
 #include "ast/Program.h"
 #include "ast/ReturnStatement.h"
 #include "ast/StringLiteral.h"
+#include "ast/WhileStatement.h"
+#include "evaluator/FunctionProfile.h"
 #include "object/Array.h"
 #include "object/Boolean.h"
 #include "object/Builtin.h"
 #include "object/Environment.h"
 #include "object/Function.h"
+#include "evaluator/Jit.h"
+#include "evaluator/RegisterMachine.h"
+#include "evaluator/Resolver.h"
+#include "evaluator/Superinstructions.h"
+#include "evaluator/Tiering.h"
+#include "object/Cell.h"
+#include "object/FunctionPrototype.h"
 #include "object/Hash.h"
 #include "object/Hashable.h"
 #include "object/Integer.h"
+#include "object/Iterator.h"
 #include "object/Null.h"
-#include "object/ReturnValue.h"
+#include "object/Range.h"
+#include "object/Set.h"
 #include "object/String.h"
+#include "object/StringBuilder.h"
 #include "object/object.h"
+#include <algorithm>
 #include <cstddef>
 #include <iostream>
 #include <memory>
@@ -37,6 +54,9 @@
 
 namespace evaluator {
 
+ArgumentStack argumentStack;
+object::ErrorInfo lastError;
+std::vector<object::Object *> tailArguments;
 object::Null NULL_OBJECT{};
 object::Boolean TRUE{true};
 object::Boolean FALSE{false};
@@ -45,128 +65,158 @@ std::map<std::string, object::Builtin *> builtins = {{"len", new object::Builtin
                                                      {"last", new object::Builtin(lastFunction)},
                                                      {"rest", new object::Builtin(restFunction)},
                                                      {"push", new object::Builtin(pushFunction)},
-                                                     {"puts", new object::Builtin(putsFunction)}};
+                                                     {"puts", new object::Builtin(putsFunction)},
+                                                     {"builder", new object::Builtin(builderFunction)},
+                                                     {"append", new object::Builtin(appendFunction)},
+                                                     {"build", new object::Builtin(buildFunction)},
+                                                     {"set", new object::Builtin(setFunction)},
+                                                     {"add", new object::Builtin(addFunction)},
+                                                     {"has", new object::Builtin(hasFunction)},
+                                                     {"remove", new object::Builtin(removeFunction)},
+                                                     {"union", new object::Builtin(unionFunction)},
+                                                     {"intersect", new object::Builtin(intersectFunction)},
+                                                     {"difference", new object::Builtin(differenceFunction)},
+                                                     {"range", new object::Builtin(rangeFunction)},
+                                                     {"map", new object::Builtin(mapFunction)},
+                                                     {"filter", new object::Builtin(filterFunction)},
+                                                     {"reduce", new object::Builtin(reduceFunction)},
+                                                     {"take", new object::Builtin(takeFunction)},
+                                                     {"zip", new object::Builtin(zipFunction)},
+                                                     {"collect", new object::Builtin(collectFunction)}};
 
 object::Object *eval(ast::Node *node, object::Environment *env) {
+    object::Result result = evalNode(node, env);
+    if (result.isError()) {
+        return new object::Error(lastError.message());
+    }
+    return result.value;
+}
+
+object::Result evalNode(ast::Node *node, object::Environment *env) {
 
     if (auto program = dynamic_cast<ast::Program *>(node)) {
         return evalProgram(program, env);
     } else if (auto expression = dynamic_cast<ast::ExpressionStatement *>(node)) {
-        return eval(expression->expression.get(), env);
+        return evalNode(expression->expression.get(), env);
     } else if (auto intLiteral = dynamic_cast<ast::IntegerLiteral *>(node)) {
         object::Integer *integerObj = new object::Integer(intLiteral->valueInt);
         return integerObj;
     } else if (auto boolLiteral = dynamic_cast<ast::Boolean *>(node)) {
         return nativeBoolToBooleanObject(boolLiteral->valueBool);
     } else if (auto prefixExpression = dynamic_cast<ast::PrefixExpression *>(node)) {
-        auto right = eval(prefixExpression->right.get(), env);
-        if (isError(right)) {
+        auto right = evalNode(prefixExpression->right.get(), env);
+        if (right.isAbrupt()) {
             return right;
         }
-        return evalPrefixExpression(prefixExpression->oper, right);
+        return evalPrefixExpression(prefixExpression->oper, right.value);
     } else if (auto infixExpression = dynamic_cast<ast::InfixExpression *>(node)) {
-        auto left = eval(infixExpression->left.get(), env);
-        if (isError(left)) {
+        if (infixExpression->fusion != ast::Fusion::NONE) {
+            return evalFusedInfix(infixExpression, env);
+        }
+        auto left = evalNode(infixExpression->left.get(), env);
+        if (left.isAbrupt()) {
             return left;
         }
-        auto right = eval(infixExpression->right.get(), env);
-        if (isError(right)) {
+        auto right = evalNode(infixExpression->right.get(), env);
+        if (right.isAbrupt()) {
             return right;
         }
-        return evalInfixExpression(infixExpression->oper, left, right);
+        return evalQuickenedInfix(infixExpression, left.value, right.value);
     } else if (auto blockStatement = dynamic_cast<ast::BlockStatement *>(node)) {
         return evalBlockStatement(blockStatement, env);
     } else if (auto ifExpression = dynamic_cast<ast::IfExpression *>(node)) {
         return evalIfExpression(ifExpression, env);
     } else if (auto returnStatement = dynamic_cast<ast::ReturnStatement *>(node)) {
-        auto val = eval(returnStatement->returnValue.get(), env);
-        if (isError(val)) {
+        auto val = evalNode(returnStatement->returnValue.get(), env);
+        if (val.isAbrupt()) {
             return val;
         }
-        return new object::ReturnValue(val);
+        return object::Result(val.value, object::Result::Status::RETURN);
     } else if (auto letStatement = dynamic_cast<ast::LetStatement *>(node)) {
-        auto val = eval(letStatement->value.get(), env);
-        if (isError(val)) {
+        auto val = evalNode(letStatement->value.get(), env);
+        if (val.isAbrupt()) {
             return val;
         }
-        std::unique_ptr<object::Object> saveObject(val);
-        env->set(letStatement->name->value, std::move(saveObject));
+        bindVariable(letStatement->name->binding, letStatement->name->value, val.value, env);
     } else if (auto ident = dynamic_cast<ast::Identifier *>(node)) {
         return evalIdentifier(ident, env);
     } else if (auto funcLit = dynamic_cast<ast::FunctionLiteral *>(node)) {
-        object::Function *func = new object::Function();
-        func->parameters = std::move(funcLit->parameters);
-        func->body = std::move(funcLit->body);
-        func->env = env;
-        return func;
+        if (funcLit->prototype == nullptr) {
+            funcLit->prototype = resolveFunction(funcLit);
+        }
+        return makeClosure(funcLit->prototype, env);
     } else if (auto call = dynamic_cast<ast::CallExpression *>(node)) {
-        auto func = eval(call->function.get(), env);
-        if (isError(func)) {
-            return func;
+        if (call->fusion != ast::Fusion::NONE) {
+            return evalFusedCall(call, env);
         }
-        std::vector<ast::Expression *> args;
-        args.reserve(call->arguments.size());
-        for (const auto &arg : call->arguments) {
-            args.push_back(arg.get());
+        auto func = evalNode(call->function.get(), env);
+        if (func.isAbrupt()) {
+            return func;
         }
-        std::vector<object::Object *> evaluatedArgs = evalExpression(args, env);
-        if (evaluatedArgs.size() == 1 && isError(evaluatedArgs[0])) {
-            return evaluatedArgs[0];
+        if (call->tail) {
+            return evalTailCall(call, func.value, env);
         }
-        return applyFunction(func, evaluatedArgs);
+        return evalCallExpression(call, func.value, env);
     } else if (auto stringLit = dynamic_cast<ast::StringLiteral *>(node)) {
-        object::String *stringObj = new object::String(stringLit->valueString);
-        return stringObj;
-    } else if (auto arrayLit = dynamic_cast<ast::ArrayLiteral *>(node)) {
-        std::vector<ast::Expression *> elements;
-        elements.reserve(arrayLit->elements.size());
-        for (const auto &elm : arrayLit->elements) {
-            elements.push_back(elm.get());
-        }
-        std::vector<object::Object *> evaluatedElms = evalExpression(elements, env);
-        if (evaluatedElms.size() == 1 && isError(evaluatedElms[0])) {
-            return evaluatedElms[0];
+        if (stringLit->interned == nullptr) {
+            stringLit->interned = object::String::intern(stringLit->valueString);
         }
+        return stringLit->interned;
+    } else if (auto arrayLit = dynamic_cast<ast::ArrayLiteral *>(node)) {
         object::Array *array = new object::Array();
-        array->elements = evaluatedElms;
+        auto evaluated = evalExpression(arrayLit->elements, env, array->elements);
+        if (evaluated.isAbrupt()) {
+            return evaluated;
+        }
         return array;
     } else if (auto indexExpression = dynamic_cast<ast::IndexExpression *>(node)) {
-        auto left = eval(indexExpression->left.get(), env);
-        if (isError(left)) {
+        if (indexExpression->fusion == ast::Fusion::INDEX_BY_LOCAL) {
+            return evalFusedIndex(indexExpression, env);
+        }
+        auto left = evalNode(indexExpression->left.get(), env);
+        if (left.isAbrupt()) {
             return left;
         }
-        auto index = eval(indexExpression->index.get(), env);
-        if (isError(index)) {
+        auto index = evalNode(indexExpression->index.get(), env);
+        if (index.isAbrupt()) {
             return index;
         }
-        return evalIndexExpression(left, index);
+        return evalCachedIndexExpression(indexExpression, left.value, index.value);
     } else if (auto hash = dynamic_cast<ast::HashLiteral *>(node)) {
         return evalHashLiteral(hash, env);
+    } else if (auto assign = dynamic_cast<ast::AssignExpression *>(node)) {
+        return evalAssignExpression(assign, env);
+    } else if (auto whileStatement = dynamic_cast<ast::WhileStatement *>(node)) {
+        return evalWhileStatement(whileStatement, env);
+    } else if (auto forStatement = dynamic_cast<ast::ForStatement *>(node)) {
+        return evalForStatement(forStatement, env);
+    } else if (dynamic_cast<ast::BreakStatement *>(node)) {
+        return object::Result(nullptr, object::Result::Status::BREAK);
+    } else if (dynamic_cast<ast::ContinueStatement *>(node)) {
+        return object::Result(nullptr, object::Result::Status::CONTINUE);
     }
     return nullptr;
 }
 
-object::Object *evalProgram(ast::Program *program, object::Environment *env) {
-    object::Object *result;
+object::Result evalProgram(ast::Program *program, object::Environment *env) {
+    object::Result result = nullptr;
     for (auto const &statement : program->statements) {
-        result = eval(statement.get(), env);
-        if (auto returnValue = dynamic_cast<object::ReturnValue *>(result)) {
-            return returnValue->value;
-        } else if (auto err = dynamic_cast<object::Error *>(result)) {
-            return err;
+        result = evalNode(statement.get(), env);
+        if (result.isReturn()) {
+            return result.value;
+        } else if (result.isError()) {
+            return result;
         }
     }
     return result;
 }
 
-object::Object *evalBlockStatement(ast::BlockStatement *block, object::Environment *env) {
-    object::Object *result;
+object::Result evalBlockStatement(ast::BlockStatement *block, object::Environment *env) {
+    object::Result result = nullptr;
     for (auto const &statement : block->statements) {
-        result = eval(statement.get(), env);
-        if (result != nullptr) {
-            if (result->type() == object::ObjectType::ERROR_OBJ || result->type() == object::ObjectType::RETURN_VALUE) {
-                return result;
-            }
+        result = evalNode(statement.get(), env);
+        if (result.isAbrupt()) {
+            return result;
         }
     }
     return result;
@@ -179,17 +229,17 @@ object::Boolean *nativeBoolToBooleanObject(bool input) {
     return &FALSE;
 }
 
-object::Object *evalPrefixExpression(std::string oper, object::Object *right) {
+object::Result evalPrefixExpression(const std::string &oper, object::Object *right) {
     if (oper == "!") {
         return evalBangOperatorExpression(right);
     } else if (oper == "-") {
         return evalMinusOperatorExpression(right);
     } else {
-        return newError("unknown operator: ", oper, right->typeToString());
+        return newError(object::ErrorCode::UNKNOWN_OPERATOR, oper.c_str(), right);
     }
 }
 
-object::Object *evalInfixExpression(std::string oper, object::Object *left, object::Object *right) {
+object::Result evalInfixExpression(const std::string &oper, object::Object *left, object::Object *right) {
 
     if (left->type() == object::ObjectType::INTEGER_OBJ && right->type() == object::ObjectType::INTEGER_OBJ) {
         return evalIntegerInfixExpression(oper, left, right);
@@ -200,9 +250,9 @@ object::Object *evalInfixExpression(std::string oper, object::Object *left, obje
     } else if (oper == "!=") {
         return nativeBoolToBooleanObject(left != right);
     } else if (left->type() != right->type()) {
-        return newError("type mismatch: ", left->typeToString(), oper, right->typeToString());
+        return newError(object::ErrorCode::TYPE_MISMATCH, oper.c_str(), left, right);
     } else {
-        return newError("unknown operator: ", left->typeToString(), oper, right->typeToString());
+        return newError(object::ErrorCode::UNKNOWN_OPERATOR, oper.c_str(), left, right);
     }
 }
 
@@ -218,17 +268,17 @@ object::Object *evalBangOperatorExpression(object::Object *right) {
     }
 }
 
-object::Object *evalMinusOperatorExpression(object::Object *right) {
+object::Result evalMinusOperatorExpression(object::Object *right) {
     if (right->type() != object::ObjectType::INTEGER_OBJ) {
-        return newError("unknown operator: -", right->typeToString());
+        return newError(object::ErrorCode::UNKNOWN_OPERATOR, "-", right);
     }
-    auto intObj = dynamic_cast<object::Integer *>(right);
+    auto intObj = static_cast<object::Integer *>(right);
     return new object::Integer(-intObj->value);
 }
 
-object::Object *evalIntegerInfixExpression(std::string oper, object::Object *left, object::Object *right) {
-    auto leftObj = dynamic_cast<object::Integer *>(left);
-    auto rightObj = dynamic_cast<object::Integer *>(right);
+object::Result evalIntegerInfixExpression(const std::string &oper, object::Object *left, object::Object *right) {
+    auto leftObj = static_cast<object::Integer *>(left);
+    auto rightObj = static_cast<object::Integer *>(right);
     if (oper == "+") {
         return new object::Integer(leftObj->value + rightObj->value);
     } else if (oper == "-") {
@@ -246,37 +296,357 @@ object::Object *evalIntegerInfixExpression(std::string oper, object::Object *lef
     } else if (oper == "!=") {
         return nativeBoolToBooleanObject(leftObj->value != rightObj->value);
     } else {
-        return newError("unknown operator: ", left->typeToString(), oper, right->typeToString());
+        return newError(object::ErrorCode::UNKNOWN_OPERATOR, oper.c_str(), left, right);
     }
 }
 
-object::Object *evalStringInfixExpression(std::string oper, object::Object *left, object::Object *right) {
+object::Result evalStringInfixExpression(const std::string &oper, object::Object *left, object::Object *right) {
     if (oper != "+") {
-        return newError("unknown operator: ", left->typeToString(), oper, right->typeToString());
+        return newError(object::ErrorCode::UNKNOWN_OPERATOR, oper.c_str(), left, right);
     }
-    auto leftObj = dynamic_cast<object::String *>(left);
-    auto rightObj = dynamic_cast<object::String *>(right);
-    std::string leftVal = leftObj->value;
-    std::string rightVal = rightObj->value;
-    return new object::String(leftVal + rightVal);
+    return concatStrings(left, right);
 }
 
-object::Object *evalIfExpression(ast::IfExpression *ifExpression, object::Environment *env) {
-    object::Object *condition = eval(ifExpression->condition.get(), env);
-    if (isError(condition)) {
+object::Object *concatStrings(object::Object *left, object::Object *right) {
+    auto leftObj = static_cast<object::String *>(left);
+    auto rightObj = static_cast<object::String *>(right);
+    if (leftObj->length() == 0) {
+        return rightObj;
+    } else if (rightObj->length() == 0) {
+        return leftObj;
+    }
+    return new object::String(leftObj, rightObj);
+}
+
+// Quickening: an infix node rewrites itself to a form specialized for the
+// operand types it has seen, so a monomorphic site checks one pair of type
+// tags and computes, skipping the generic dispatch on types and on the
+// operator string. Operands the form does not handle revert the node to the
+// generic path; a site that keeps missing is left generic.
+object::Result evalQuickenedInfix(ast::InfixExpression *node, object::Object *left, object::Object *right) {
+    if (node->form == ast::InfixForm::CONCAT_STR) {
+        if (left->type() == object::ObjectType::STRING_OBJ && right->type() == object::ObjectType::STRING_OBJ) {
+            return concatStrings(left, right);
+        }
+    } else if (node->form != ast::InfixForm::UNSPECIALIZED) {
+        if (left->type() == object::ObjectType::INTEGER_OBJ && right->type() == object::ObjectType::INTEGER_OBJ) {
+            int l = static_cast<object::Integer *>(left)->value;
+            int r = static_cast<object::Integer *>(right)->value;
+            switch (node->form) {
+            case ast::InfixForm::ADD_INT_INT:
+                return new object::Integer(l + r);
+            case ast::InfixForm::SUB_INT_INT:
+                return new object::Integer(l - r);
+            case ast::InfixForm::MUL_INT_INT:
+                return new object::Integer(l * r);
+            case ast::InfixForm::DIV_INT_INT:
+                return new object::Integer(l / r);
+            case ast::InfixForm::EQ_INT_INT:
+                return nativeBoolToBooleanObject(l == r);
+            case ast::InfixForm::NE_INT_INT:
+                return nativeBoolToBooleanObject(l != r);
+            case ast::InfixForm::LT_INT_INT:
+                return nativeBoolToBooleanObject(l < r);
+            default:
+                return nativeBoolToBooleanObject(l > r);
+            }
+        }
+    }
+    if (node->form != ast::InfixForm::UNSPECIALIZED) {
+        node->form = ast::InfixForm::UNSPECIALIZED;
+        node->deopts++;
+    }
+    object::Result result = evalInfixExpression(node->oper, left, right);
+    if (!result.isError() && node->deopts < MAX_DEOPTS) {
+        node->form = infixForm(node->oper, left, right);
+    }
+    return result;
+}
+
+// The specialized form for `oper` on these operands, if there is one.
+ast::InfixForm infixForm(const std::string &oper, object::Object *left, object::Object *right) {
+    if (left->type() == object::ObjectType::STRING_OBJ && right->type() == object::ObjectType::STRING_OBJ) {
+        return oper == "+" ? ast::InfixForm::CONCAT_STR : ast::InfixForm::UNSPECIALIZED;
+    } else if (left->type() != object::ObjectType::INTEGER_OBJ || right->type() != object::ObjectType::INTEGER_OBJ) {
+        return ast::InfixForm::UNSPECIALIZED;
+    }
+    static const std::map<std::string, ast::InfixForm> forms = {
+        {"+", ast::InfixForm::ADD_INT_INT}, {"-", ast::InfixForm::SUB_INT_INT}, {"*", ast::InfixForm::MUL_INT_INT},
+        {"/", ast::InfixForm::DIV_INT_INT}, {"==", ast::InfixForm::EQ_INT_INT}, {"!=", ast::InfixForm::NE_INT_INT},
+        {"<", ast::InfixForm::LT_INT_INT},  {">", ast::InfixForm::GT_INT_INT},
+    };
+    auto form = forms.find(oper);
+    return form == forms.end() ? ast::InfixForm::UNSPECIALIZED : form->second;
+}
+
+object::Result evalIfExpression(ast::IfExpression *ifExpression, object::Environment *env) {
+    object::Result condition = evalNode(ifExpression->condition.get(), env);
+    if (condition.isAbrupt()) {
         return condition;
     }
-    if (isTruthy(condition)) {
-        return eval(ifExpression->consiquence.get(), env);
+    if (isTruthy(condition.value)) {
+        return evalNode(ifExpression->consiquence.get(), env);
     } else if (ifExpression->alternative != nullptr) {
-        return eval(ifExpression->alternative.get(), env);
+        return evalNode(ifExpression->alternative.get(), env);
     } else {
         return &NULL_OBJECT;
     }
 }
 
-object::Object *evalIdentifier(ast::Identifier *ident, object::Environment *env) {
-    auto val = env->get(ident->value);
+object::Result evalAssignExpression(ast::AssignExpression *assign, object::Environment *env) {
+    if (auto index = dynamic_cast<ast::IndexExpression *>(assign->target.get())) {
+        object::Result left = evalNode(index->left.get(), env);
+        if (left.isAbrupt()) {
+            return left;
+        }
+        object::Result key = evalNode(index->index.get(), env);
+        if (key.isAbrupt()) {
+            return key;
+        }
+        object::Result value = evalNode(assign->value.get(), env);
+        if (value.isAbrupt()) {
+            return value;
+        }
+        return assignIndex(left.value, key.value, value.value);
+    }
+    object::Result value = evalNode(assign->value.get(), env);
+    if (value.isAbrupt()) {
+        return value;
+    }
+    return assignVariable(static_cast<ast::Identifier *>(assign->target.get()), value.value, env);
+}
+
+// Rebinds an existing variable; unlike `let` it never creates one.
+object::Result assignVariable(ast::Identifier *ident, object::Object *value, object::Environment *env) {
+    switch (ident->binding.kind) {
+    case ast::BindingKind::LOCAL:
+    case ast::BindingKind::CELL:
+    case ast::BindingKind::UPVALUE:
+        bindVariable(ident->binding, ident->value, value, env);
+        return value;
+    case ast::BindingKind::GLOBAL:
+        break;
+    }
+    if (!env->assign(ident->value, value)) {
+        return newError(object::ErrorCode::IDENTIFIER_NOT_FOUND, &ident->value);
+    }
+    return value;
+}
+
+// Updates an array element or hash entry in place and yields the value.
+object::Result assignIndex(object::Object *left, object::Object *index, object::Object *value) {
+    if (left->type() == object::ObjectType::ARRAY_OBJ && index->type() == object::ObjectType::INTEGER_OBJ) {
+        auto &elements = static_cast<object::Array *>(left)->elements;
+        int idx = static_cast<object::Integer *>(index)->value;
+        if (idx < 0 || static_cast<size_t>(idx) >= elements.size()) {
+            return newError(object::ErrorCode::INDEX_OUT_OF_RANGE, static_cast<long>(idx),
+                            static_cast<long>(elements.size()));
+        }
+        elements[idx] = value;
+        return value;
+    } else if (left->type() == object::ObjectType::HASH_OBJ) {
+        if (!object::isHashable(index)) {
+            return newError(object::ErrorCode::UNUSABLE_AS_HASH_KEY, "", index);
+        }
+        static_cast<object::Hash *>(left)->set(index, value);
+        return value;
+    }
+    return newError(object::ErrorCode::INDEX_NOT_SUPPORTED, "", left);
+}
+
+// Loops run in the enclosing scope: the loop variable and the body's lets
+// are ordinary variables of the surrounding function (or globals), updated
+// in place on every iteration.
+object::Result evalWhileStatement(ast::WhileStatement *loop, object::Environment *env) {
+    while (true) {
+        object::Result condition = evalNode(loop->condition.get(), env);
+        if (condition.isAbrupt()) {
+            return condition;
+        }
+        if (!isTruthy(condition.value)) {
+            return nullptr;
+        }
+        object::Result body = evalNode(loop->body.get(), env);
+        if (body.isBreak()) {
+            return nullptr;
+        } else if (body.isAbrupt() && !body.isContinue()) {
+            return body;
+        }
+    }
+}
+
+object::Result evalForStatement(ast::ForStatement *loop, object::Environment *env) {
+    object::Result iterable = evalNode(loop->iterable.get(), env);
+    if (iterable.isAbrupt()) {
+        return iterable;
+    }
+    object::Object *source = loopSource(iterable.value);
+    if (source == nullptr) {
+        return newError(object::ErrorCode::NOT_ITERABLE, "", iterable.value);
+    }
+    object::Object *element = nullptr;
+    for (size_t position = 0;; position++) {
+        object::Result next = loopNext(source, position, element);
+        if (next.isAbrupt()) {
+            return next;
+        } else if (next.value == nullptr) {
+            break;
+        }
+        element = next.value;
+        bindVariable(loop->variable->binding, loop->variable->value, element, env);
+        object::Result body = evalNode(loop->body.get(), env);
+        if (body.isBreak()) {
+            break;
+        } else if (body.isAbrupt() && !body.isContinue()) {
+            return body;
+        }
+    }
+    return nullptr;
+}
+
+// What a for-in loop walks for `iterable`: arrays, hashes (their keys),
+// strings (their characters), ranges and iterators are walked in place; a
+// set is walked over a snapshot of its members. nullptr if it is not
+// iterable.
+object::Object *loopSource(object::Object *iterable) {
+    switch (iterable->type()) {
+    case object::ObjectType::ARRAY_OBJ:
+    case object::ObjectType::HASH_OBJ:
+    case object::ObjectType::STRING_OBJ:
+    case object::ObjectType::RANGE_OBJ:
+    case object::ObjectType::ITERATOR_OBJ:
+        return iterable;
+    case object::ObjectType::SET_OBJ: {
+        object::Array *members = new object::Array();
+        members->elements = static_cast<object::Set *>(iterable)->members();
+        return members;
+    }
+    default:
+        return nullptr;
+    }
+}
+
+// The next element of a for-in loop over a loopSource(): the element at
+// `position`, the key after `previous` for a hash, or whatever an iterator
+// yields next. A nullptr value marks the end; pulling from an iterator can
+// also fail.
+object::Result loopNext(object::Object *source, size_t position, object::Object *previous) {
+    switch (source->type()) {
+    case object::ObjectType::ARRAY_OBJ: {
+        const auto &elements = static_cast<object::Array *>(source)->elements;
+        return position < elements.size() ? elements[position] : nullptr;
+    }
+    case object::ObjectType::ITERATOR_OBJ:
+        return iteratorNext(static_cast<object::Iterator *>(source));
+    case object::ObjectType::HASH_OBJ:
+        return static_cast<object::Hash *>(source)->keyAfter(previous);
+    case object::ObjectType::STRING_OBJ: {
+        const std::string &value = static_cast<object::String *>(source)->value();
+        return position < value.size() ? object::String::intern(value.substr(position, 1)) : nullptr;
+    }
+    case object::ObjectType::RANGE_OBJ: {
+        auto range = static_cast<object::Range *>(source);
+        return position < range->size() ? new object::Integer(range->at(position)) : nullptr;
+    }
+    default:
+        return nullptr;
+    }
+}
+
+// Pulls the next element through an iterator's chain of stages; a nullptr
+// value marks the end.
+object::Result iteratorNext(object::Iterator *it) {
+    switch (it->stage) {
+    case object::Iterator::Stage::SOURCE: {
+        object::Result next = loopNext(it->source, it->position, it->previous);
+        if (!next.isAbrupt() && next.value != nullptr) {
+            it->position++;
+            it->previous = next.value;
+        }
+        return next;
+    }
+    case object::Iterator::Stage::MAP: {
+        object::Result next = iteratorNext(it->upstream);
+        if (next.isAbrupt() || next.value == nullptr) {
+            return next;
+        }
+        return applyFunction(it->function, object::Args{&next.value, 1});
+    }
+    case object::Iterator::Stage::FILTER:
+        while (true) {
+            object::Result next = iteratorNext(it->upstream);
+            if (next.isAbrupt() || next.value == nullptr) {
+                return next;
+            }
+            object::Result keep = applyFunction(it->function, object::Args{&next.value, 1});
+            if (keep.isAbrupt()) {
+                return keep;
+            } else if (isTruthy(keep.value)) {
+                return next;
+            }
+        }
+    case object::Iterator::Stage::TAKE: {
+        if (it->position >= it->limit) {
+            return nullptr;
+        }
+        object::Result next = iteratorNext(it->upstream);
+        if (!next.isAbrupt() && next.value != nullptr) {
+            it->position++;
+        }
+        return next;
+    }
+    case object::Iterator::Stage::ZIP: {
+        object::Result left = iteratorNext(it->upstream);
+        if (left.isAbrupt() || left.value == nullptr) {
+            return left;
+        }
+        object::Result right = iteratorNext(it->other);
+        if (right.isAbrupt() || right.value == nullptr) {
+            return right;
+        }
+        object::Array *pair = new object::Array();
+        pair->elements = {left.value, right.value};
+        return pair;
+    }
+    }
+    return nullptr;
+}
+
+// Wraps an iterable in a SOURCE iterator; iterators are used as they are.
+// nullptr if `iterable` cannot be iterated.
+object::Iterator *toIterator(object::Object *iterable) {
+    if (iterable->type() == object::ObjectType::ITERATOR_OBJ) {
+        return static_cast<object::Iterator *>(iterable);
+    }
+    object::Object *source = loopSource(iterable);
+    if (source == nullptr) {
+        return nullptr;
+    }
+    object::Iterator *it = new object::Iterator(object::Iterator::Stage::SOURCE);
+    it->source = source;
+    return it;
+}
+
+object::Result evalIdentifier(ast::Identifier *ident, object::Environment *env) {
+    object::Object *val = nullptr;
+    switch (ident->binding.kind) {
+    case ast::BindingKind::LOCAL:
+        val = env->slots[ident->binding.index];
+        break;
+    case ast::BindingKind::CELL:
+        val = env->cells[ident->binding.index]->value;
+        break;
+    case ast::BindingKind::UPVALUE:
+        val = env->closure->upvalues[ident->binding.index]->value;
+        break;
+    case ast::BindingKind::GLOBAL:
+        break;
+    }
+    if (val != nullptr) {
+        return val;
+    }
+    // globals, and locals read before their `let` ran, fall back to the global scope
+    val = env->get(ident->value);
     if (val != nullptr) {
         return val;
     }
@@ -284,39 +654,256 @@ object::Object *evalIdentifier(ast::Identifier *ident, object::Environment *env)
     if (builtin != builtins.end()) {
         return builtin->second;
     }
-    return newError("identifier not found: ", ident->value);
+    return newError(object::ErrorCode::IDENTIFIER_NOT_FOUND, &ident->value);
 }
 
-std::vector<object::Object *> evalExpression(std::vector<ast::Expression *> exps, object::Environment *env) {
-    std::vector<object::Object *> result;
+// A local variable operand of a fused node: its slot, or the usual lookup
+// if its `let` has not run yet.
+object::Result evalLocal(ast::Expression *operand, object::Environment *env) {
+    auto ident = static_cast<ast::Identifier *>(operand);
+    object::Object *val = env->slots[ident->binding.index];
+    if (val != nullptr) {
+        return val;
+    }
+    return evalIdentifier(ident, env);
+}
+
+// Superinstructions, see Superinstructions.h: the operands of a fused node
+// are read in place rather than dispatched on as nodes of their own.
+object::Result evalFusedInfix(ast::InfixExpression *node, object::Environment *env) {
+    countFusion(node->fusion);
+    auto left = evalLocal(node->left.get(), env);
+    if (left.isAbrupt()) {
+        return left;
+    }
+    object::Result right = nullptr;
+    if (node->fusion == ast::Fusion::LOCAL_OP_CONST) {
+        right = static_cast<ast::IntegerLiteral *>(node->right.get())->constant;
+    } else {
+        right = evalLocal(node->right.get(), env);
+        if (right.isAbrupt()) {
+            return right;
+        }
+    }
+    return evalQuickenedInfix(node, left.value, right.value);
+}
+
+object::Result evalFusedIndex(ast::IndexExpression *node, object::Environment *env) {
+    countFusion(node->fusion);
+    auto left = evalIdentifier(static_cast<ast::Identifier *>(node->left.get()), env);
+    if (left.isAbrupt()) {
+        return left;
+    }
+    auto index = evalLocal(node->index.get(), env);
+    if (index.isAbrupt()) {
+        return index;
+    }
+    return evalCachedIndexExpression(node, left.value, index.value);
+}
+
+// A call of a named function with one argument, which needs no block on
+// the argument stack.
+object::Result evalFusedCall(ast::CallExpression *call, object::Environment *env) {
+    countFusion(call->fusion);
+    auto func = evalIdentifier(static_cast<ast::Identifier *>(call->function.get()), env);
+    if (func.isAbrupt()) {
+        return func;
+    }
+    object::Result arg = call->fusion == ast::Fusion::CALL_LOCAL ? evalLocal(call->arguments[0].get(), env)
+                                                                 : evalNode(call->arguments[0].get(), env);
+    if (arg.isAbrupt()) {
+        return arg;
+    }
+    if (call->tail) {
+        tailArguments.assign(1, arg.value);
+        return object::Result(func.value, object::Result::Status::TAIL_CALL);
+    }
+    return applyFunction(func.value, object::Args{&arg.value, 1});
+}
+
+// Evaluates `exps` in order into `out`, stopping at the first error or return.
+object::Result evalExpression(const std::vector<std::unique_ptr<ast::Expression>> &exps, object::Environment *env,
+                              std::vector<object::Object *> &out) {
+    out.reserve(exps.size());
     for (const auto &exp : exps) {
-        object::Object *evaluated = eval(exp, env);
-        if (isError(evaluated)) {
-            return std::vector<object::Object *>{evaluated};
+        object::Result evaluated = evalNode(exp.get(), env);
+        if (evaluated.isAbrupt()) {
+            return evaluated;
+        }
+        out.push_back(evaluated.value);
+    }
+    return nullptr;
+}
+
+// Evaluates the arguments straight into a block of the argument stack and
+// calls `func` with a view of that block, so the call itself allocates
+// nothing beyond the callee's environment.
+object::Result evalCallExpression(ast::CallExpression *call, object::Object *func, object::Environment *env) {
+    size_t count = call->arguments.size();
+    ArgumentStack::Mark mark = argumentStack.mark();
+    object::Object **argv = argumentStack.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        object::Result evaluated = evalNode(call->arguments[i].get(), env);
+        if (evaluated.isAbrupt()) {
+            argumentStack.reset(mark);
+            return evaluated;
         }
-        result.push_back(evaluated);
+        argv[i] = evaluated.value;
     }
+    object::Result result = applyFunction(func, object::Args{argv, count});
+    argumentStack.reset(mark);
     return result;
 }
 
-object::Object *applyFunction(object::Object *func, std::vector<object::Object *> args) {
-    if (auto funcObj = dynamic_cast<object::Function *>(func)) {
-        object::Environment *extendedEnv = extendFunctionEnvironment(funcObj, args);
-        object::Object *evaluated = eval(funcObj->body.get(), extendedEnv);
-        return unwrapReturnValue(evaluated);
-    } else if (auto builtin = dynamic_cast<object::Builtin *>(func)) {
-        return builtin->fn(args);
+// Evaluates a call in tail position: the arguments go to tailArguments and
+// the callee is handed back to the enclosing applyFunction as a TAIL_CALL
+// result, so the current body's native frames unwind before the call runs.
+object::Result evalTailCall(ast::CallExpression *call, object::Object *func, object::Environment *env) {
+    size_t count = call->arguments.size();
+    ArgumentStack::Mark mark = argumentStack.mark();
+    object::Object **argv = argumentStack.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        object::Result evaluated = evalNode(call->arguments[i].get(), env);
+        if (evaluated.isAbrupt()) {
+            argumentStack.reset(mark);
+            return evaluated;
+        }
+        argv[i] = evaluated.value;
     }
-    return newError("not a function: ", func->typeToString());
+    tailArguments.assign(argv, argv + count);
+    argumentStack.reset(mark);
+    return object::Result(func, object::Result::Status::TAIL_CALL);
 }
 
-object::Environment *extendFunctionEnvironment(object::Function *func, std::vector<object::Object *> args) {
-    object::Environment *env = new object::Environment(func->env);
-    for (size_t i = 0; i < func->parameters.size(); i++) {
-        std::unique_ptr<object::Object> saveArg(args[i]);
-        env->set(func->parameters[i]->value, std::move(saveArg));
+// Runs `func` and then every call it makes in tail position in one loop,
+// reusing a single frame, so tail-recursive loops take constant native
+// stack and constant frames.
+object::Result applyFunction(object::Object *func, object::Args args) {
+    object::Environment *frame = nullptr;
+    while (true) {
+        if (func->type() == object::ObjectType::BUILTIN_OBJ) {
+            return applyBuiltin(static_cast<object::Builtin *>(func), args);
+        } else if (func->type() != object::ObjectType::FUNCTION_OBJ) {
+            return newError(object::ErrorCode::NOT_A_FUNCTION, "", func);
+        }
+        auto funcObj = static_cast<object::Function *>(func);
+        const object::FunctionPrototype *prototype = funcObj->prototype.get();
+        if (args.size() != prototype->arity) {
+            return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, prototype->arity, args.size());
+        }
+        if (profileOf(prototype).entry != nullptr) {
+            object::Result result = profileOf(prototype).entry(funcObj, args);
+            if (!result.isTailCall()) {
+                return result;
+            }
+            func = result.value;
+            args = object::Args{tailArguments.data(), tailArguments.size()};
+            continue;
+        }
+        switch (enterTier(prototype)) {
+        case Tier::OPTIMIZED: {
+            object::Result result = nullptr;
+            if (callOptimized(funcObj, args, result)) {
+                return result;
+            } else if (profileOf(prototype).native == nullptr || nativeDepth >= MAX_NATIVE_DEPTH) {
+                return callRegisterMachine(funcObj, args);
+            }
+        }
+            [[fallthrough]];
+        case Tier::NATIVE: {
+            object::Result result = runNative(profileOf(prototype).native.get(), funcObj, args);
+            if (!result.isTailCall()) {
+                return result;
+            }
+            func = result.value;
+            args = object::Args{tailArguments.data(), tailArguments.size()};
+            continue;
+        }
+        case Tier::BYTECODE:
+            return callRegisterMachine(funcObj, args);
+        case Tier::TREE:
+            break;
+        }
+        if (frame == nullptr) {
+            frame = extendFunctionEnvironment(funcObj, args);
+        } else {
+            initFrame(frame, funcObj, args);
+        }
+        object::Result evaluated = evalNode(prototype->body.get(), frame);
+        if (!evaluated.isTailCall()) {
+            return unwrapReturnValue(evaluated);
+        }
+        func = evaluated.value;
+        args = object::Args{tailArguments.data(), tailArguments.size()};
+    }
+}
+
+// Calls a builtin with its own copy of the arguments, which may live in
+// tailArguments and would be overwritten if the builtin calls back into
+// Monkey code.
+object::Result applyBuiltin(object::Builtin *builtin, object::Args args) {
+    ArgumentStack::Mark mark = argumentStack.mark();
+    object::Object **argv = argumentStack.reserve(args.size());
+    std::copy(args.begin(), args.end(), argv);
+    object::Result result = builtin->fn(object::Args{argv, args.size()});
+    argumentStack.reset(mark);
+    return result;
+}
+
+object::Environment *extendFunctionEnvironment(object::Function *func, object::Args args) {
+    object::Environment *frame = new object::Environment(func->globals);
+    initFrame(frame, func, args);
+    return frame;
+}
+
+// (Re)initializes a call frame for `func`. Nothing outside a running call
+// points at its frame, only at the frame's cells, so a frame can be reused
+// for a tail call as long as it gets fresh cells.
+void initFrame(object::Environment *frame, object::Function *func, object::Args args) {
+    const object::FunctionPrototype *prototype = func->prototype.get();
+    frame->outer = func->globals;
+    frame->closure = func;
+    frame->slots.assign(prototype->slotCount, nullptr);
+    frame->cells.clear();
+    for (size_t i = 0; i < prototype->cellCount; i++) {
+        frame->cells.push_back(new object::Cell());
+    }
+    for (size_t i = 0; i < prototype->arity; i++) {
+        bindVariable(prototype->parameterBindings[i], prototype->parameters[i], args[i], frame);
+    }
+}
+
+// Creates a closure of `prototype` in `env`. The closure copies the cells it
+// captures out of the current frame (or the current closure's upvalues);
+// it holds on to nothing else of the defining scope but the globals.
+object::Function *makeClosure(const std::shared_ptr<const object::FunctionPrototype> &prototype,
+                              object::Environment *env) {
+    bool inFrame = env->closure != nullptr;
+    object::Function *func = new object::Function(prototype, inFrame ? env->outer : env);
+    func->upvalues.reserve(prototype->captures.size());
+    for (const auto &capture : prototype->captures) {
+        func->upvalues.push_back(capture.fromCell ? env->cells[capture.index]
+                                                  : env->closure->upvalues[capture.index]);
+    }
+    return func;
+}
+
+void bindVariable(const ast::Binding &binding, const std::string &name, object::Object *value,
+                  object::Environment *env) {
+    switch (binding.kind) {
+    case ast::BindingKind::LOCAL:
+        env->slots[binding.index] = value;
+        break;
+    case ast::BindingKind::CELL:
+        env->cells[binding.index]->value = value;
+        break;
+    case ast::BindingKind::UPVALUE:
+        env->closure->upvalues[binding.index]->value = value;
+        break;
+    case ast::BindingKind::GLOBAL:
+        env->set(name, value);
+        break;
     }
-    return env;
 }
 
 bool isTruthy(object::Object *object) {
@@ -331,67 +918,54 @@ bool isTruthy(object::Object *object) {
     }
 }
 
-template <typename... Args> object::Error *newError(const std::string &format, Args &&...args) {
-    std::ostringstream oss;
-    oss << format;
-    ((oss << std::forward<Args>(args) << ' '), ...);
-    std::string msg = oss.str();
-    if (!msg.empty() && msg.back() == ' ')
-        msg.pop_back();
-
-    return new object::Error(msg);
-}
-
-bool isError(object::Object *object) {
-    if (object != nullptr) {
-        return object->type() == object::ObjectType::ERROR_OBJ;
+object::Result unwrapReturnValue(object::Result result) {
+    if (result.isReturn()) {
+        return result.value;
     }
-    return false;
-}
-
-object::Object *unwrapReturnValue(object::Object *obj) {
-
-    auto returnValue = dynamic_cast<object::ReturnValue *>(obj);
-    if (returnValue != nullptr) {
-        return returnValue->value;
-    }
-    return obj;
+    return result;
 }
 
-object::Object *lenFunction(const std::vector<object::Object *> &args) {
+object::Result lenFunction(object::Args args) {
     if (args.size() != 1) {
-        return newError("wrong number of arguments. want=1 but got=", args.size());
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 1, args.size());
     }
-    if (auto arg = dynamic_cast<object::String *>(args[0])) {
-        return new object::Integer(arg->value.size());
-    } else if (auto arg = dynamic_cast<object::Array *>(args[0])) {
-        return new object::Integer(arg->elements.size());
+    switch (args[0]->type()) {
+    case object::ObjectType::STRING_OBJ:
+        return new object::Integer(static_cast<object::String *>(args[0])->length());
+    case object::ObjectType::ARRAY_OBJ:
+        return new object::Integer(static_cast<object::Array *>(args[0])->elements.size());
+    case object::ObjectType::SET_OBJ:
+        return new object::Integer(static_cast<object::Set *>(args[0])->size());
+    case object::ObjectType::RANGE_OBJ:
+        return new object::Integer(static_cast<object::Range *>(args[0])->size());
+    default:
+        break;
     }
-    return newError("argument to `len` not supported, got ", args[0]->typeToString());
+    return newError(object::ErrorCode::ARGUMENT_NOT_SUPPORTED, "len", args[0]);
 }
 
-object::Object *firstFunction(const std::vector<object::Object *> &args) {
+object::Result firstFunction(object::Args args) {
     if (args.size() != 1) {
-        return newError("wrong number of arguments. want=1 but got=", args.size());
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 1, args.size());
     }
     if (args[0]->type() != object::ObjectType::ARRAY_OBJ) {
-        return newError("argument to `first` must be ARRAY, got ", args[0]->typeToString());
+        return newError(object::ErrorCode::ARGUMENT_TYPE, "first", "ARRAY", args[0]);
     }
-    auto arr = dynamic_cast<object::Array *>(args[0]);
+    auto arr = static_cast<object::Array *>(args[0]);
     if (arr->elements.size() > 0) {
         return arr->elements[0];
     }
     return &NULL_OBJECT;
 }
 
-object::Object *lastFunction(const std::vector<object::Object *> &args) {
+object::Result lastFunction(object::Args args) {
     if (args.size() != 1) {
-        return newError("wrong number of arguments. want=1 but got=", args.size());
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 1, args.size());
     }
     if (args[0]->type() != object::ObjectType::ARRAY_OBJ) {
-        return newError("argument to `last` must be ARRAY, got ", args[0]->typeToString());
+        return newError(object::ErrorCode::ARGUMENT_TYPE, "last", "ARRAY", args[0]);
     }
-    auto arr = dynamic_cast<object::Array *>(args[0]);
+    auto arr = static_cast<object::Array *>(args[0]);
     int length = arr->elements.size();
     if (length > 0) {
         return arr->elements[length - 1];
@@ -399,14 +973,14 @@ object::Object *lastFunction(const std::vector<object::Object *> &args) {
     return &NULL_OBJECT;
 }
 
-object::Object *restFunction(const std::vector<object::Object *> &args) {
+object::Result restFunction(object::Args args) {
     if (args.size() != 1) {
-        return newError("wrong number of arguments. want=1 but got=", args.size());
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 1, args.size());
     }
     if (args[0]->type() != object::ObjectType::ARRAY_OBJ) {
-        return newError("argument to `rest` must be ARRAY, got ", args[0]->typeToString());
+        return newError(object::ErrorCode::ARGUMENT_TYPE, "rest", "ARRAY", args[0]);
     }
-    auto arr = dynamic_cast<object::Array *>(args[0]);
+    auto arr = static_cast<object::Array *>(args[0]);
     int length = arr->elements.size();
     if (length > 0) {
 
@@ -422,14 +996,14 @@ object::Object *restFunction(const std::vector<object::Object *> &args) {
     return &NULL_OBJECT;
 }
 
-object::Object *pushFunction(const std::vector<object::Object *> &args) {
+object::Result pushFunction(object::Args args) {
     if (args.size() != 2) {
-        return newError("wrong number of arguments. want=2 but got=", args.size());
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 2, args.size());
     }
     if (args[0]->type() != object::ObjectType::ARRAY_OBJ) {
-        return newError("argument to `push` must be ARRAY, got ", args[0]->typeToString());
+        return newError(object::ErrorCode::ARGUMENT_TYPE, "push", "ARRAY", args[0]);
     }
-    auto arr = dynamic_cast<object::Array *>(args[0]);
+    auto arr = static_cast<object::Array *>(args[0]);
     int length = arr->elements.size();
 
     std::vector<object::Object *> newElements;
@@ -443,27 +1017,290 @@ object::Object *pushFunction(const std::vector<object::Object *> &args) {
     return newArray;
 }
 
-object::Object *putsFunction(const std::vector<object::Object *> &args) {
+object::Result putsFunction(object::Args args) {
     for (const auto& arg : args){
         std::cout << arg->inspect() << '\n';
     }
     return &NULL_OBJECT;
 }
 
-object::Object *evalIndexExpression(object::Object *left, object::Object *index) {
+object::Result builderFunction(object::Args args) {
+    if (args.size() > 1) {
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 1, args.size(), "0 or 1");
+    }
+    object::StringBuilder *builder = new object::StringBuilder();
+    if (args.size() == 1) {
+        if (args[0]->type() != object::ObjectType::STRING_OBJ) {
+            return newError(object::ErrorCode::ARGUMENT_TYPE, "builder", "STRING", args[0]);
+        }
+        builder->buffer = static_cast<object::String *>(args[0])->value();
+    }
+    return builder;
+}
+
+object::Result appendFunction(object::Args args) {
+    if (args.size() < 2) {
+        return newError(object::ErrorCode::TOO_FEW_ARGUMENTS, 2, args.size());
+    }
+    if (args[0]->type() != object::ObjectType::BUILDER_OBJ) {
+        return newError(object::ErrorCode::ARGUMENT_TYPE, "append", "BUILDER", args[0]);
+    }
+    auto builder = static_cast<object::StringBuilder *>(args[0]);
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i]->type() == object::ObjectType::STRING_OBJ) {
+            builder->buffer += static_cast<object::String *>(args[i])->value();
+        } else {
+            builder->buffer += args[i]->inspect();
+        }
+    }
+    return builder;
+}
+
+object::Result buildFunction(object::Args args) {
+    if (args.size() != 1) {
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 1, args.size());
+    }
+    if (args[0]->type() != object::ObjectType::BUILDER_OBJ) {
+        return newError(object::ErrorCode::ARGUMENT_TYPE, "build", "BUILDER", args[0]);
+    }
+    return new object::String(static_cast<object::StringBuilder *>(args[0])->buffer);
+}
+
+object::Result setFunction(object::Args args) {
+    object::Args members = args;
+    if (args.size() == 1 && args[0]->type() == object::ObjectType::ARRAY_OBJ) {
+        auto array = static_cast<object::Array *>(args[0]);
+        members = object::Args{array->elements.data(), array->elements.size()};
+    }
+    object::Set *result = new object::Set();
+    for (const auto &member : members) {
+        if (!object::isHashable(member)) {
+            return newError(object::ErrorCode::UNUSABLE_AS_SET_MEMBER, "", member);
+        }
+        result->add(member);
+    }
+    return result;
+}
+
+object::Result addFunction(object::Args args) {
+    if (args.size() < 2) {
+        return newError(object::ErrorCode::TOO_FEW_ARGUMENTS, 2, args.size());
+    }
+    if (args[0]->type() != object::ObjectType::SET_OBJ) {
+        return newError(object::ErrorCode::ARGUMENT_TYPE, "add", "SET", args[0]);
+    }
+    auto set = static_cast<object::Set *>(args[0]);
+    for (size_t i = 1; i < args.size(); i++) {
+        if (!object::isHashable(args[i])) {
+            return newError(object::ErrorCode::UNUSABLE_AS_SET_MEMBER, "", args[i]);
+        }
+        set->add(args[i]);
+    }
+    return set;
+}
+
+object::Result hasFunction(object::Args args) {
+    if (args.size() != 2) {
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 2, args.size());
+    }
+    if (args[0]->type() != object::ObjectType::SET_OBJ) {
+        return newError(object::ErrorCode::ARGUMENT_TYPE, "has", "SET", args[0]);
+    }
+    if (!object::isHashable(args[1])) {
+        return newError(object::ErrorCode::UNUSABLE_AS_SET_MEMBER, "", args[1]);
+    }
+    return nativeBoolToBooleanObject(static_cast<object::Set *>(args[0])->has(args[1]));
+}
+
+object::Result removeFunction(object::Args args) {
+    if (args.size() < 2) {
+        return newError(object::ErrorCode::TOO_FEW_ARGUMENTS, 2, args.size());
+    }
+    if (args[0]->type() != object::ObjectType::SET_OBJ) {
+        return newError(object::ErrorCode::ARGUMENT_TYPE, "remove", "SET", args[0]);
+    }
+    auto set = static_cast<object::Set *>(args[0]);
+    for (size_t i = 1; i < args.size(); i++) {
+        if (!object::isHashable(args[i])) {
+            return newError(object::ErrorCode::UNUSABLE_AS_SET_MEMBER, "", args[i]);
+        }
+        set->remove(args[i]);
+    }
+    return set;
+}
+
+object::Result setAlgebra(object::Args args, const char *name,
+                           object::Set *(*combine)(const object::Set *, const object::Set *)) {
+    if (args.size() != 2) {
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 2, args.size());
+    }
+    for (const auto &arg : args) {
+        if (arg->type() != object::ObjectType::SET_OBJ) {
+            return newError(object::ErrorCode::ARGUMENT_TYPE, name, "SET", arg);
+        }
+    }
+    return combine(static_cast<object::Set *>(args[0]), static_cast<object::Set *>(args[1]));
+}
+
+object::Result unionFunction(object::Args args) {
+    return setAlgebra(args, "union", object::Set::unionOf);
+}
+
+object::Result intersectFunction(object::Args args) {
+    return setAlgebra(args, "intersect", object::Set::intersectionOf);
+}
+
+object::Result differenceFunction(object::Args args) {
+    return setAlgebra(args, "difference", object::Set::differenceOf);
+}
+
+// Checks the (iterable, function) arguments of map and filter and builds the stage.
+object::Result pipelineStage(object::Args args, const char *name, object::Iterator::Stage stage) {
+    if (args.size() != 2) {
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 2, args.size());
+    }
+    object::Iterator *upstream = toIterator(args[0]);
+    if (upstream == nullptr) {
+        return newError(object::ErrorCode::ARGUMENT_NOT_SUPPORTED, name, args[0]);
+    }
+    if (args[1]->type() != object::ObjectType::FUNCTION_OBJ && args[1]->type() != object::ObjectType::BUILTIN_OBJ) {
+        return newError(object::ErrorCode::ARGUMENT_TYPE, name, "FUNCTION", args[1]);
+    }
+    object::Iterator *it = new object::Iterator(stage);
+    it->upstream = upstream;
+    it->function = args[1];
+    return it;
+}
+
+// map, filter, take and zip return iterators, which are single-use: each
+// element is yielded once, so walking an iterator a second time (another
+// collect, reduce or for loop) finds it empty. Arrays, hashes, strings and
+// ranges can be walked any number of times.
+
+// map(iterable, fn): lazily yields fn(x) for each x
+object::Result mapFunction(object::Args args) { return pipelineStage(args, "map", object::Iterator::Stage::MAP); }
+
+// filter(iterable, fn): lazily yields the x for which fn(x) is truthy
+object::Result filterFunction(object::Args args) {
+    return pipelineStage(args, "filter", object::Iterator::Stage::FILTER);
+}
+
+// take(iterable, n): lazily yields at most the first n elements
+object::Result takeFunction(object::Args args) {
+    if (args.size() != 2) {
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 2, args.size());
+    }
+    object::Iterator *upstream = toIterator(args[0]);
+    if (upstream == nullptr) {
+        return newError(object::ErrorCode::ARGUMENT_NOT_SUPPORTED, "take", args[0]);
+    }
+    if (args[1]->type() != object::ObjectType::INTEGER_OBJ || static_cast<object::Integer *>(args[1])->value < 0) {
+        return newError(object::ErrorCode::ARGUMENT_TYPE, "take", "a non-negative INTEGER", args[1]);
+    }
+    object::Iterator *it = new object::Iterator(object::Iterator::Stage::TAKE);
+    it->upstream = upstream;
+    it->limit = static_cast<object::Integer *>(args[1])->value;
+    return it;
+}
+
+// zip(a, b): lazily yields [x, y] pairs until either side runs out
+object::Result zipFunction(object::Args args) {
+    if (args.size() != 2) {
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 2, args.size());
+    }
+    object::Iterator *left = toIterator(args[0]);
+    if (left == nullptr) {
+        return newError(object::ErrorCode::ARGUMENT_NOT_SUPPORTED, "zip", args[0]);
+    }
+    object::Iterator *right = toIterator(args[1]);
+    if (right == nullptr) {
+        return newError(object::ErrorCode::ARGUMENT_NOT_SUPPORTED, "zip", args[1]);
+    }
+    object::Iterator *it = new object::Iterator(object::Iterator::Stage::ZIP);
+    it->upstream = left;
+    it->other = right;
+    return it;
+}
+
+// reduce(iterable, initial, fn): folds fn(acc, x) over the elements in one pass
+object::Result reduceFunction(object::Args args) {
+    if (args.size() != 3) {
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 3, args.size());
+    }
+    object::Iterator *it = toIterator(args[0]);
+    if (it == nullptr) {
+        return newError(object::ErrorCode::ARGUMENT_NOT_SUPPORTED, "reduce", args[0]);
+    }
+    object::Object *pair[2] = {args[1], nullptr};
+    while (true) {
+        object::Result next = iteratorNext(it);
+        if (next.isAbrupt()) {
+            return next;
+        } else if (next.value == nullptr) {
+            return pair[0];
+        }
+        pair[1] = next.value;
+        object::Result folded = applyFunction(args[2], object::Args{pair, 2});
+        if (folded.isAbrupt()) {
+            return folded;
+        }
+        pair[0] = folded.value;
+    }
+}
+
+// collect(iterable): runs the pipeline into an array, using up an iterator
+object::Result collectFunction(object::Args args) {
+    if (args.size() != 1) {
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 1, args.size());
+    }
+    object::Iterator *it = toIterator(args[0]);
+    if (it == nullptr) {
+        return newError(object::ErrorCode::ARGUMENT_NOT_SUPPORTED, "collect", args[0]);
+    }
+    object::Array *result = new object::Array();
+    while (true) {
+        object::Result next = iteratorNext(it);
+        if (next.isAbrupt()) {
+            return next;
+        } else if (next.value == nullptr) {
+            return result;
+        }
+        result->elements.push_back(next.value);
+    }
+}
+
+// range(end), range(start, end) or range(start, end, step)
+object::Result rangeFunction(object::Args args) {
+    if (args.empty() || args.size() > 3) {
+        return newError(object::ErrorCode::WRONG_ARGUMENT_COUNT, 1, args.size(), "1 to 3");
+    }
+    int bounds[3] = {0, 0, 1};
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i]->type() != object::ObjectType::INTEGER_OBJ) {
+            return newError(object::ErrorCode::ARGUMENT_TYPE, "range", "INTEGER", args[i]);
+        }
+        bounds[args.size() == 1 ? 1 : i] = static_cast<object::Integer *>(args[i])->value;
+    }
+    if (bounds[2] == 0) {
+        return newError(object::ErrorCode::ZERO_STEP, "range", args[2]);
+    }
+    return new object::Range(bounds[0], bounds[1], bounds[2]);
+}
+
+object::Result evalIndexExpression(object::Object *left, object::Object *index) {
     if (left->type() == object::ObjectType::ARRAY_OBJ && index->type() == object::ObjectType::INTEGER_OBJ) {
         return evalArrayIndexExpression(left, index);
     } else if (left->type() == object::ObjectType::HASH_OBJ) {
         return evalHashIndexExpression(left, index);
     } else {
-        return newError("index operator not supported: ", left->typeToString());
+        return newError(object::ErrorCode::INDEX_NOT_SUPPORTED, "", left);
     }
 }
 
 object::Object *evalArrayIndexExpression(object::Object *array, object::Object *index) {
 
-    auto arrayObject = dynamic_cast<object::Array *>(array);
-    auto intObject = dynamic_cast<object::Integer *>(index);
+    auto arrayObject = static_cast<object::Array *>(array);
+    auto intObject = static_cast<object::Integer *>(index);
     int idx = intObject->value;
     int max = arrayObject->elements.size() - 1;
 
@@ -474,40 +1311,66 @@ object::Object *evalArrayIndexExpression(object::Object *array, object::Object *
     return arrayObject->elements[idx];
 }
 
-object::Object *evalHashLiteral(ast::HashLiteral *hash, object::Environment *env) {
-    std::map<object::HashKey, object::HashPair> resultPair;
+object::Result evalHashLiteral(ast::HashLiteral *hash, object::Environment *env) {
+    object::Hash *result = new object::Hash();
     for (const auto &pair : hash->pairs) {
-        auto key = eval(pair.first.get(), env);
-        if (isError(key)) {
+        auto key = evalNode(pair.first.get(), env);
+        if (key.isAbrupt()) {
             return key;
         }
-        auto hashKey = dynamic_cast<object::Hashable *>(key);
-        if (hashKey == nullptr) {
-            return newError("unusable as hashkey: ", key->typeToString());
+        if (!object::isHashable(key.value)) {
+            return newError(object::ErrorCode::UNUSABLE_AS_HASH_KEY, "", key.value);
         }
-        auto value = eval(pair.second.get(), env);
-        if (isError(value)) {
+        auto value = evalNode(pair.second.get(), env);
+        if (value.isAbrupt()) {
             return value;
         }
-        auto hashed = hashKey->hashKey();
-        resultPair[hashed] = object::HashPair{key, value};
+        result->set(key.value, value.value);
     }
-    object::Hash *result = new object::Hash();
-    result->pairs = resultPair;
     return result;
 }
 
-object::Object *evalHashIndexExpression(object::Object *hash, object::Object *index) {
-    auto hashObject = dynamic_cast<object::Hash *>(hash);
-    auto key = dynamic_cast<object::Hashable *>(index);
-    if (key == nullptr) {
-        return newError("unusable as hash key: ", index->typeToString());
+object::Result evalHashIndexExpression(object::Object *hash, object::Object *index) {
+    auto hashObject = static_cast<object::Hash *>(hash);
+    if (!object::isHashable(index)) {
+        return newError(object::ErrorCode::UNUSABLE_AS_HASH_KEY, "", index);
     }
-    auto pair = hashObject->pairs.find(key->hashKey());
-    if (pair == hashObject->pairs.end()){
+    auto value = hashObject->get(index);
+    if (value == nullptr) {
         return &NULL_OBJECT;
     }
-    return pair->second.value;
+    return value;
+}
+
+// Monomorphic inline cache: remembers the (shape, key) -> slot mapping of the
+// last record this expression indexed, so a repeat lookup on a same-shaped
+// record is a pointer comparison and a vector load.
+object::Result evalCachedIndexExpression(ast::IndexExpression *node, object::Object *left, object::Object *index) {
+    if (left->type() != object::ObjectType::HASH_OBJ) {
+        return evalIndexExpression(left, index);
+    }
+    auto hash = static_cast<object::Hash *>(left);
+    if (hash->isDense() && index->type() == object::ObjectType::INTEGER_OBJ) {
+        auto value = hash->getDense(static_cast<object::Integer *>(index)->value);
+        return value == nullptr ? &NULL_OBJECT : value;
+    }
+    if (!hash->isRecord() || index->type() != object::ObjectType::STRING_OBJ) {
+        return evalHashIndexExpression(left, index);
+    }
+    if (hash->shape == node->cachedShape && index == node->cachedKey) {
+        return hash->slots[node->cachedSlot];
+    }
+    auto key = static_cast<object::String *>(index);
+    int slot = hash->shape->slotOf(key);
+    if (slot < 0) {
+        return &NULL_OBJECT;
+    }
+    if (key->isInterned()) {
+        node->cachedShape = hash->shape;
+        node->cachedKey = key;
+        node->cachedSlot = slot;
+    }
+    return hash->slots[slot];
 }
 
 } // namespace evaluator
@@ -1,8 +1,109 @@
+#include "evaluator/Engine.h"
+#include "evaluator/Jit.h"
+#include "evaluator/Superinstructions.h"
+#include "evaluator/Tiering.h"
 #include "repl.h"
+#include <fstream>
 #include <iostream>
+#include <string>
 
-int main() {
+// Parses a call-count threshold; false unless `text` is a number that fits.
+static bool parseThreshold(const std::string &text, unsigned &threshold) {
+    if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    threshold = static_cast<unsigned>(std::stoul(text));
+    return true;
+}
+
+// interpreter [--engine=tree|stackless|register|closure] [--profile] [--jit=on|off]
+//             [--tier] [--tier-bytecode=N] [--tier-native=N] [--tier-optimized=N] [--tier-background]
+//             [--stats] [script]
+// Without a script, starts the REPL. --profile fuses every superinstruction
+// shape, counts how often the tree walker runs each, and prints the counts
+// to stderr on exit. --jit=off keeps hot functions off the compiled tiers, as
+// does MONKEY_JIT=off in the environment. Functions stay on the chosen
+// engine unless --tier promotes hot ones with the default thresholds;
+// --tier-bytecode, --tier-native and --tier-optimized set the calls after
+// which a function is promoted (0, the default, never promotes; the
+// optimizing tier exists only in interpreter-llvm),
+// --tier-background compiles on a worker thread, and --stats prints each
+// promotion to stderr on exit.
+int main(int argc, char *argv[]) {
+    evaluator::Engine engine = evaluator::Engine::TREE;
+    const char *script = nullptr;
+    evaluator::FusionProfile profile;
+    bool profiling = false;
+    evaluator::TierStats stats;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--profile") {
+            profiling = true;
+            evaluator::enabledFusions = evaluator::allFusions();
+            evaluator::fusionProfile = &profile;
+        } else if (arg == "--jit=on" || arg == "--jit=off") {
+            evaluator::jitEnabled = MONKEY_JIT_SUPPORTED && arg == "--jit=on";
+        } else if (arg == "--tier") {
+            evaluator::tierPolicy.bytecodeThreshold = evaluator::DEFAULT_BYTECODE_THRESHOLD;
+            evaluator::tierPolicy.nativeThreshold = evaluator::DEFAULT_NATIVE_THRESHOLD;
+            evaluator::tierPolicy.optimizedThreshold = evaluator::DEFAULT_OPTIMIZED_THRESHOLD;
+        } else if (arg.rfind("--tier-bytecode=", 0) == 0) {
+            if (!parseThreshold(arg.substr(16), evaluator::tierPolicy.bytecodeThreshold)) {
+                std::cerr << "bad threshold: " << arg.substr(16) << '\n';
+                return 2;
+            }
+        } else if (arg.rfind("--tier-native=", 0) == 0) {
+            if (!parseThreshold(arg.substr(14), evaluator::tierPolicy.nativeThreshold)) {
+                std::cerr << "bad threshold: " << arg.substr(14) << '\n';
+                return 2;
+            }
+        } else if (arg.rfind("--tier-optimized=", 0) == 0) {
+            if (!parseThreshold(arg.substr(17), evaluator::tierPolicy.optimizedThreshold)) {
+                std::cerr << "bad threshold: " << arg.substr(17) << '\n';
+                return 2;
+            }
+        } else if (arg == "--tier-background") {
+            evaluator::tierPolicy.background = true;
+        } else if (arg == "--stats") {
+            evaluator::tierStats = &stats;
+        } else if (arg.rfind("--engine=", 0) == 0) {
+            if (!evaluator::parseEngine(arg.substr(9), engine)) {
+                std::cerr << "unknown engine: " << arg.substr(9) << '\n';
+                return 2;
+            }
+        } else if (script == nullptr) {
+            script = argv[i];
+        } else {
+            std::cerr << "usage: " << argv[0]
+                      << " [--engine=tree|stackless|register|closure] [--profile] [--jit=on|off]"
+                         " [--tier] [--tier-bytecode=N] [--tier-native=N] [--tier-optimized=N] [--tier-background]"
+                         " [--stats] [script]"
+                      << '\n';
+            return 2;
+        }
+    }
+    if (script != nullptr) {
+        std::ifstream in(script);
+        if (!in) {
+            std::cerr << "cannot open " << script << '\n';
+            return 2;
+        }
+        int status = repl::REPL::run(in, std::cout, engine);
+        if (profiling) {
+            std::cerr << evaluator::formatProfile(profile);
+        }
+        if (evaluator::tierStats != nullptr) {
+            std::cerr << evaluator::formatTierStats(stats);
+        }
+        return status;
+    }
     std::cout << "Monkey Language Interpretor" << '\n';
-    repl::REPL::start(std::cout);
+    repl::REPL::start(std::cout, engine);
+    if (profiling) {
+        std::cerr << evaluator::formatProfile(profile);
+    }
+    if (evaluator::tierStats != nullptr) {
+        std::cerr << evaluator::formatTierStats(stats);
+    }
     return 0;
 }
@@ -0,0 +1,30 @@
+#include "monkeyc/Runtime.h"
+#include "evaluator/evaluator.h"
+#include "object/Error.h"
+#include "object/object.h"
+#include <iostream>
+#include <string>
+
+namespace monkeyc {
+
+const std::string &operatorString(Operator oper) {
+    static const std::string strings[] = {"+", "-", "*", "/", "<", ">", "==", "!="};
+    return strings[static_cast<int>(oper)];
+}
+
+object::Result notFound(const std::string &name) {
+    return evaluator::newError(object::ErrorCode::IDENTIFIER_NOT_FOUND, &name);
+}
+
+int report(object::Result result) {
+    if (result.isError()) {
+        std::cout << object::Error(evaluator::lastError.message()).inspect() << '\n';
+        return 1;
+    }
+    if (result.value != nullptr) {
+        std::cout << result.value->inspect() << '\n';
+    }
+    return 0;
+}
+
+} // namespace monkeyc
@@ -0,0 +1,869 @@
+#include "monkeyc/Transpiler.h"
+#include "ast/ArrayLiteral.h"
+#include "ast/AssignExpression.h"
+#include "ast/BlockStatement.h"
+#include "ast/Boolean.h"
+#include "ast/BreakStatement.h"
+#include "ast/CallExpression.h"
+#include "ast/ContinueStatement.h"
+#include "ast/ExpressionStatement.h"
+#include "ast/ForStatement.h"
+#include "ast/FunctionLiteral.h"
+#include "ast/HashLiteral.h"
+#include "ast/Identifier.h"
+#include "ast/IfExpression.h"
+#include "ast/IndexExpression.h"
+#include "ast/InfixExpression.h"
+#include "ast/IntegerLiteral.h"
+#include "ast/LetStatement.h"
+#include "ast/PrefixExpression.h"
+#include "ast/ReturnStatement.h"
+#include "ast/StringLiteral.h"
+#include "ast/WhileStatement.h"
+#include "evaluator/FunctionProfile.h"
+#include "evaluator/Resolver.h"
+#include "evaluator/TypeInference.h"
+#include "evaluator/evaluator.h"
+#include "object/FunctionPrototype.h"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace monkeyc {
+
+namespace {
+
+enum class Kind { OBJECT, INTEGER, BOOLEAN };
+
+// A generated C++ expression of type object::Object *, int or bool. It is
+// always a temporary, a constant or a literal, so using it twice neither
+// repeats work nor sees a later assignment.
+struct Value {
+    std::string code;
+    Kind kind;
+};
+
+const std::map<std::string, std::string> OPERATORS = {
+    {"+", "ADD"}, {"-", "SUB"}, {"*", "MUL"}, {"/", "DIV"}, {"<", "LT"}, {">", "GT"}, {"==", "EQ"}, {"!=", "NE"},
+};
+
+std::string quote(const std::string &text) {
+    std::string quoted = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += static_cast<char>(c);
+        } else if (c == '\n') {
+            quoted += "\\n";
+        } else if (c < 0x20 || c >= 0x7f) {
+            char escaped[5];
+            std::snprintf(escaped, sizeof escaped, "\\%03o", c);
+            quoted += escaped;
+        } else {
+            quoted += static_cast<char>(c);
+        }
+    }
+    return quoted + "\"";
+}
+
+std::string join(const std::vector<std::string> &items) {
+    std::string joined;
+    for (std::size_t i = 0; i < items.size(); i++) {
+        joined += (i > 0 ? ", " : "") + items[i];
+    }
+    return joined;
+}
+
+// What object::Function::inspect() shows for a closure of `literal`.
+std::string functionText(ast::FunctionLiteral *literal) {
+    std::vector<std::string> parameters;
+    for (const auto &parameter : literal->parameters) {
+        parameters.push_back(parameter->value);
+    }
+    return "fn(" + join(parameters) + ") {\n" + literal->body->toString() + "\n}";
+}
+
+const char *bindingKind(ast::BindingKind kind) {
+    switch (kind) {
+    case ast::BindingKind::GLOBAL:
+        return "ast::BindingKind::GLOBAL";
+    case ast::BindingKind::LOCAL:
+        return "ast::BindingKind::LOCAL";
+    case ast::BindingKind::CELL:
+        return "ast::BindingKind::CELL";
+    case ast::BindingKind::UPVALUE:
+        return "ast::BindingKind::UPVALUE";
+    }
+    return "";
+}
+
+// Calls `visit` on the identifiers in `node`, leaving out nested functions,
+// whose names are bound in their own frames.
+template <typename Visit> void forEachIdentifier(ast::Node *node, Visit &visit) {
+    if (node == nullptr || dynamic_cast<ast::FunctionLiteral *>(node)) {
+        return;
+    }
+    if (auto ident = dynamic_cast<ast::Identifier *>(node)) {
+        visit(ident);
+    }
+    evaluator::forEachChild(node, [&](ast::Node *child) { forEachIdentifier(child, visit); });
+}
+
+// Every store to a local in `node`: the slot and the value, nullptr for a
+// loop variable.
+void collectStores(ast::Node *node, std::vector<std::pair<int, ast::Expression *>> &stores) {
+    if (node == nullptr || dynamic_cast<ast::FunctionLiteral *>(node)) {
+        return;
+    }
+    if (auto let = dynamic_cast<ast::LetStatement *>(node)) {
+        if (let->name->binding.kind == ast::BindingKind::LOCAL) {
+            stores.emplace_back(let->name->binding.index, let->value.get());
+        }
+    } else if (auto assign = dynamic_cast<ast::AssignExpression *>(node)) {
+        auto target = dynamic_cast<ast::Identifier *>(assign->target.get());
+        if (target != nullptr && target->binding.kind == ast::BindingKind::LOCAL) {
+            stores.emplace_back(target->binding.index, assign->value.get());
+        }
+    } else if (auto loop = dynamic_cast<ast::ForStatement *>(node)) {
+        if (loop->variable->binding.kind == ast::BindingKind::LOCAL) {
+            stores.emplace_back(loop->variable->binding.index, nullptr);
+        }
+    }
+    evaluator::forEachChild(node, [&](ast::Node *child) { collectStores(child, stores); });
+}
+
+class Transpiler {
+  public:
+    std::string run(ast::Program *program) {
+        evaluator::inferTypes(program);
+        for (const auto &statement : program->statements) {
+            number(statement.get());
+            collectGlobals(statement.get());
+        }
+        for (ast::FunctionLiteral *literal : literals_) {
+            generateFunction(literal);
+        }
+        generateProgram(program);
+        return assemble();
+    }
+
+  private:
+    // The C++ function being generated: a function literal's, or the
+    // program's top level when `literal` is nullptr.
+    struct Context {
+        ast::FunctionLiteral *literal = nullptr;
+        std::set<int> integers;
+        // parameters that are never assigned, which can be read directly
+        std::set<int> constants;
+        // the Monkey names of the slots and cells, for readable C++
+        std::vector<std::string> slotNames;
+        std::vector<std::string> cellNames;
+        // a tail call of the function itself jumps back to the start
+        bool loops = false;
+        std::ostringstream code;
+        int indent = 1;
+        int temps = 0;
+    };
+
+    std::vector<ast::FunctionLiteral *> literals_;
+    std::map<const ast::FunctionLiteral *, int> ids_;
+    std::set<std::string> globals_;
+    std::set<std::string> builtins_;
+    std::set<std::string> names_;
+    std::map<std::string, std::string> strings_;
+    std::map<int, std::string> integers_;
+    std::vector<std::string> functions_;
+    Context *context_ = nullptr;
+
+    void number(ast::Node *node) {
+        if (node == nullptr) {
+            return;
+        }
+        if (auto literal = dynamic_cast<ast::FunctionLiteral *>(node)) {
+            ids_[literal] = static_cast<int>(literals_.size());
+            literals_.push_back(literal);
+        }
+        evaluator::forEachChild(node, [this](ast::Node *child) { number(child); });
+    }
+
+    // The names top-level lets and loops bind.
+    void collectGlobals(ast::Node *node) {
+        if (node == nullptr || dynamic_cast<ast::FunctionLiteral *>(node)) {
+            return;
+        }
+        if (auto let = dynamic_cast<ast::LetStatement *>(node)) {
+            globals_.insert(let->name->value);
+        } else if (auto loop = dynamic_cast<ast::ForStatement *>(node)) {
+            globals_.insert(loop->variable->value);
+        }
+        evaluator::forEachChild(node, [this](ast::Node *child) { collectGlobals(child); });
+    }
+
+    void line(const std::string &text) { context_->code << std::string(4 * context_->indent, ' ') << text << '\n'; }
+
+    void open(const std::string &text) {
+        line(text + " {");
+        context_->indent++;
+    }
+
+    void close(const std::string &text = "}") {
+        context_->indent--;
+        line(text);
+    }
+
+    std::string temp() { return "t" + std::to_string(context_->temps++); }
+
+    std::string global(const std::string &name) { return "g_" + name; }
+
+    std::string builtin(const std::string &name) {
+        builtins_.insert(name);
+        return "b_" + name;
+    }
+
+    std::string nameString(const std::string &name) {
+        names_.insert(name);
+        return "n_" + name;
+    }
+
+    std::string slot(int index) {
+        const std::string &name = context_->slotNames[index];
+        return (context_->integers.count(index) != 0 ? "i" : "l") + std::to_string(index) +
+               (name.empty() ? "" : "_" + name);
+    }
+
+    std::string cell(int index) {
+        const std::string &name = context_->cellNames[index];
+        return "c" + std::to_string(index) + (name.empty() ? "" : "_" + name);
+    }
+
+    std::string stringConstant(const std::string &value) {
+        auto found = strings_.find(value);
+        if (found == strings_.end()) {
+            found = strings_.emplace(value, "s" + std::to_string(strings_.size())).first;
+        }
+        return found->second;
+    }
+
+    std::string integerConstant(int value) {
+        auto found = integers_.find(value);
+        if (found == integers_.end()) {
+            found = integers_.emplace(value, "k" + std::to_string(integers_.size())).first;
+        }
+        return found->second;
+    }
+
+    // `value` as an object::Object *. Integer literals are boxed once, up
+    // front; integers are immutable, so sharing them is safe.
+    std::string box(const Value &value) {
+        switch (value.kind) {
+        case Kind::INTEGER:
+            if (std::all_of(value.code.begin(), value.code.end(), [](char c) { return std::isdigit(c); })) {
+                return integerConstant(std::stoi(value.code));
+            }
+            return "new object::Integer(" + value.code + ")";
+        case Kind::BOOLEAN:
+            return "evaluator::nativeBoolToBooleanObject(" + value.code + ")";
+        case Kind::OBJECT:
+            break;
+        }
+        return value.code;
+    }
+
+    // box(), in a temporary if boxing allocates, for a value used twice.
+    std::string boxed(const Value &value) {
+        if (value.kind == Kind::OBJECT) {
+            return value.code;
+        }
+        std::string boxedValue = box(value);
+        if (boxedValue.rfind("new ", 0) != 0) {
+            return boxedValue;
+        }
+        std::string t = temp();
+        line("object::Object *" + t + " = " + boxedValue + ";");
+        return t;
+    }
+
+    // `value`, which inferTypes proved an integer, as an int; the proof
+    // makes the type check unnecessary.
+    Value unboxed(const Value &value) {
+        if (value.kind != Kind::OBJECT) {
+            return value;
+        }
+        std::string t = temp();
+        line("const int " + t + " = monkeyc::intValue(" + value.code + ");");
+        return {t, Kind::INTEGER};
+    }
+
+    std::string truthy(const Value &value) {
+        switch (value.kind) {
+        case Kind::BOOLEAN:
+            return value.code;
+        case Kind::INTEGER:
+            return "true";
+        case Kind::OBJECT:
+            break;
+        }
+        return "evaluator::isTruthy(" + value.code + ")";
+    }
+
+    // Evaluates a call that returns object::Result, returning on an error.
+    std::string check(const std::string &result) {
+        std::string t = temp();
+        line("object::Result " + t + " = " + result + ";");
+        line("if (" + t + ".isError()) { return " + t + "; }");
+        return t + ".value";
+    }
+
+    void store(const ast::Binding &binding, const std::string &name, const std::string &value) {
+        switch (binding.kind) {
+        case ast::BindingKind::LOCAL:
+            line(slot(binding.index) + " = " + value + ";");
+            break;
+        case ast::BindingKind::CELL:
+            line(cell(binding.index) + "->value = " + value + ";");
+            break;
+        case ast::BindingKind::UPVALUE:
+            line("self->upvalues[" + std::to_string(binding.index) + "]->value = " + value + ";");
+            break;
+        case ast::BindingKind::GLOBAL:
+            line(global(name) + " = " + value + ";");
+            break;
+        }
+    }
+
+    void generateFunction(ast::FunctionLiteral *literal) {
+        const object::FunctionPrototype *prototype = literal->prototype.get();
+        Context context;
+        context.literal = literal;
+        context.slotNames.resize(prototype->slotCount);
+        context.cellNames.resize(prototype->cellCount);
+        for (std::size_t i = 0; i < prototype->arity; i++) {
+            const ast::Binding &binding = prototype->parameterBindings[i];
+            auto &names = binding.kind == ast::BindingKind::LOCAL ? context.slotNames : context.cellNames;
+            names[binding.index] = prototype->parameters[i];
+        }
+        auto name = [&](ast::Identifier *ident) {
+            if (ident->binding.kind == ast::BindingKind::LOCAL) {
+                context.slotNames[ident->binding.index] = ident->value;
+            } else if (ident->binding.kind == ast::BindingKind::CELL) {
+                context.cellNames[ident->binding.index] = ident->value;
+            }
+        };
+        forEachIdentifier(literal->body.get(), name);
+        // the locals inferTypes proved integers are kept unboxed
+        auto integer = [&](ast::Identifier *ident) {
+            if (ident->binding.kind == ast::BindingKind::LOCAL && ident->type == ast::StaticType::INTEGER) {
+                context.integers.insert(ident->binding.index);
+            }
+        };
+        for (const auto &parameter : literal->parameters) {
+            integer(parameter.get());
+        }
+        forEachIdentifier(literal->body.get(), integer);
+        std::vector<std::pair<int, ast::Expression *>> stores;
+        collectStores(literal->body.get(), stores);
+        for (const ast::Binding &binding : prototype->parameterBindings) {
+            if (binding.kind == ast::BindingKind::LOCAL) {
+                context.constants.insert(binding.index);
+            }
+        }
+        for (const auto &store : stores) {
+            context.constants.erase(store.first);
+        }
+        context_ = &context;
+        std::string result = "result";
+        block(literal->body.get(), &result);
+
+        int id = ids_.at(literal);
+        std::ostringstream out;
+        out << "object::Result f" << id << "(object::Function *self, object::Args args) {\n";
+        std::vector<std::string> arguments;
+        for (std::size_t i = 0; i < prototype->arity; i++) {
+            arguments.push_back("args[" + std::to_string(i) + "]");
+        }
+        if (!arguments.empty()) {
+            out << "    object::Object *a[] = {" << join(arguments) << "};\n";
+        }
+        if (context.loops) {
+            out << "start:\n";
+        }
+        std::vector<bool> isParameter(prototype->slotCount, false);
+        for (std::size_t i = 0; i < prototype->arity; i++) {
+            const ast::Binding &binding = prototype->parameterBindings[i];
+            if (binding.kind != ast::BindingKind::LOCAL) {
+                continue;
+            }
+            bool integer = context.integers.count(binding.index) != 0;
+            out << "    " << (isParameter[binding.index] ? "" : integer ? "int " : "object::Object *")
+                << slot(binding.index) << " = " << (integer ? "monkeyc::intValue(a[" : "a[") << i
+                << (integer ? "]);\n" : "];\n");
+            isParameter[binding.index] = true;
+        }
+        for (std::size_t i = 0; i < prototype->slotCount; i++) {
+            if (isParameter[i]) {
+                continue;
+            } else if (context.integers.count(i) != 0) {
+                out << "    int " << slot(i) << " = 0;\n";
+            } else {
+                out << "    object::Object *" << slot(i) << " = nullptr;\n";
+            }
+        }
+        for (std::size_t i = 0; i < prototype->cellCount; i++) {
+            out << "    object::Cell *" << cell(i) << " = new object::Cell();\n";
+        }
+        for (std::size_t i = 0; i < prototype->arity; i++) {
+            const ast::Binding &binding = prototype->parameterBindings[i];
+            if (binding.kind == ast::BindingKind::CELL) {
+                out << "    " << cell(binding.index) << "->value = a[" << i << "];\n";
+            }
+        }
+        out << "    object::Object *result = nullptr;\n" << context.code.str() << "    return result;\n}\n";
+        functions_.push_back(out.str());
+        context_ = nullptr;
+    }
+
+    void generateProgram(ast::Program *program) {
+        Context context;
+        context_ = &context;
+        std::string result = "result";
+        for (std::size_t i = 0; i < program->statements.size(); i++) {
+            statement(program->statements[i].get(), i + 1 == program->statements.size() ? &result : nullptr);
+        }
+        functions_.push_back("object::Result program() {\n    object::Object *result = nullptr;\n" +
+                             context.code.str() + "    return result;\n}\n");
+        context_ = nullptr;
+    }
+
+    // A block leaves the value of its last statement in `target`, unless
+    // target is nullptr.
+    void block(ast::BlockStatement *body, const std::string *target) {
+        for (std::size_t i = 0; i < body->statements.size(); i++) {
+            statement(body->statements[i].get(), i + 1 == body->statements.size() ? target : nullptr);
+        }
+    }
+
+    void statement(ast::Statement *node, const std::string *target) {
+        if (auto expression = dynamic_cast<ast::ExpressionStatement *>(node)) {
+            if (expression->expression == nullptr) {
+                return;
+            } else if (target != nullptr) {
+                Value value = evaluate(expression->expression.get());
+                line(*target + " = " + box(value) + ";");
+            } else if (auto ifExpression = dynamic_cast<ast::IfExpression *>(expression->expression.get())) {
+                conditional(ifExpression, false);
+            } else {
+                evaluate(expression->expression.get());
+            }
+        } else if (auto let = dynamic_cast<ast::LetStatement *>(node)) {
+            Value value = evaluate(let->value.get());
+            const ast::Binding &binding = let->name->binding;
+            if (binding.kind == ast::BindingKind::LOCAL && context_->integers.count(binding.index) != 0) {
+                line(slot(binding.index) + " = " + unboxed(value).code + ";");
+            } else {
+                store(binding, let->name->value, box(value));
+            }
+        } else if (auto ret = dynamic_cast<ast::ReturnStatement *>(node)) {
+            line("return " + box(evaluate(ret->returnValue.get())) + ";");
+        } else if (auto loop = dynamic_cast<ast::WhileStatement *>(node)) {
+            open("while (true)");
+            Value condition = evaluate(loop->condition.get());
+            line("if (!" + truthy(condition) + ") { break; }");
+            block(loop->body.get(), nullptr);
+            close();
+        } else if (auto loop = dynamic_cast<ast::ForStatement *>(node)) {
+            forLoop(loop);
+        } else if (dynamic_cast<ast::BreakStatement *>(node)) {
+            line("break;");
+        } else if (dynamic_cast<ast::ContinueStatement *>(node)) {
+            line("continue;");
+        } else if (auto body = dynamic_cast<ast::BlockStatement *>(node)) {
+            block(body, target);
+        }
+    }
+
+    void forLoop(ast::ForStatement *loop) {
+        std::string iterable = boxed(evaluate(loop->iterable.get()));
+        std::string source = temp();
+        std::string element = temp();
+        std::string position = temp();
+        std::string next = temp();
+        line("object::Object *" + source + " = evaluator::loopSource(" + iterable + ");");
+        line("if (" + source + " == nullptr) { return evaluator::newError(object::ErrorCode::NOT_ITERABLE, \"\", " +
+             iterable + "); }");
+        line("object::Object *" + element + " = nullptr;");
+        open("for (std::size_t " + position + " = 0;; " + position + "++)");
+        line("object::Result " + next + " = evaluator::loopNext(" + source + ", " + position + ", " + element + ");");
+        line("if (" + next + ".isError()) { return " + next + "; }");
+        line("if (" + next + ".value == nullptr) { break; }");
+        line(element + " = " + next + ".value;");
+        const ast::Binding &binding = loop->variable->binding;
+        if (binding.kind == ast::BindingKind::LOCAL && context_->integers.count(binding.index) != 0) {
+            line(slot(binding.index) + " = monkeyc::intValue(" + element + ");");
+        } else {
+            store(binding, loop->variable->value, element);
+        }
+        block(loop->body.get(), nullptr);
+        close();
+    }
+
+    Value evaluate(ast::Expression *node) {
+        if (auto literal = dynamic_cast<ast::IntegerLiteral *>(node)) {
+            return {std::to_string(literal->valueInt), Kind::INTEGER};
+        } else if (auto literal = dynamic_cast<ast::Boolean *>(node)) {
+            return {literal->valueBool ? "true" : "false", Kind::BOOLEAN};
+        } else if (auto literal = dynamic_cast<ast::StringLiteral *>(node)) {
+            return {stringConstant(literal->valueString), Kind::OBJECT};
+        } else if (auto ident = dynamic_cast<ast::Identifier *>(node)) {
+            return identifier(ident);
+        } else if (auto prefix = dynamic_cast<ast::PrefixExpression *>(node)) {
+            return prefixExpression(prefix);
+        } else if (auto infix = dynamic_cast<ast::InfixExpression *>(node)) {
+            return infixExpression(infix);
+        } else if (auto ifExpression = dynamic_cast<ast::IfExpression *>(node)) {
+            return conditional(ifExpression, true);
+        } else if (auto literal = dynamic_cast<ast::FunctionLiteral *>(node)) {
+            return closure(literal);
+        } else if (auto call = dynamic_cast<ast::CallExpression *>(node)) {
+            return callExpression(call);
+        } else if (auto array = dynamic_cast<ast::ArrayLiteral *>(node)) {
+            std::vector<std::string> elements;
+            for (const auto &element : array->elements) {
+                elements.push_back(box(evaluate(element.get())));
+            }
+            std::string t = temp();
+            line("object::Array *" + t + " = new object::Array();");
+            if (!elements.empty()) {
+                line(t + "->elements = {" + join(elements) + "};");
+            }
+            return {t, Kind::OBJECT};
+        } else if (auto index = dynamic_cast<ast::IndexExpression *>(node)) {
+            std::string left = box(evaluate(index->left.get()));
+            std::string key = box(evaluate(index->index.get()));
+            return {check("evaluator::evalIndexExpression(" + left + ", " + key + ")"), Kind::OBJECT};
+        } else if (auto hash = dynamic_cast<ast::HashLiteral *>(node)) {
+            std::string t = temp();
+            line("object::Hash *" + t + " = new object::Hash();");
+            for (const auto &pair : hash->pairs) {
+                std::string key = boxed(evaluate(pair.first.get()));
+                line("if (!object::isHashable(" + key +
+                     ")) { return evaluator::newError(object::ErrorCode::UNUSABLE_AS_HASH_KEY, \"\", " + key + "); }");
+                std::string value = box(evaluate(pair.second.get()));
+                line(t + "->set(" + key + ", " + value + ");");
+            }
+            return {t, Kind::OBJECT};
+        } else if (auto assign = dynamic_cast<ast::AssignExpression *>(node)) {
+            return assignment(assign);
+        }
+        return {"nullptr", Kind::OBJECT};
+    }
+
+    Value identifier(ast::Identifier *ident) {
+        const ast::Binding &binding = ident->binding;
+        const std::string &name = ident->value;
+        std::string primary = "nullptr";
+        switch (binding.kind) {
+        case ast::BindingKind::LOCAL:
+            if (context_->integers.count(binding.index) != 0) {
+                std::string t = temp();
+                line("const int " + t + " = " + slot(binding.index) + ";");
+                return {t, Kind::INTEGER};
+            } else if (context_->constants.count(binding.index) != 0) {
+                return {slot(binding.index), Kind::OBJECT};
+            }
+            primary = slot(binding.index);
+            break;
+        case ast::BindingKind::CELL:
+            primary = cell(binding.index) + "->value";
+            break;
+        case ast::BindingKind::UPVALUE:
+            primary = "self->upvalues[" + std::to_string(binding.index) + "]->value";
+            break;
+        case ast::BindingKind::GLOBAL:
+            if (globals_.count(name) != 0) {
+                primary = global(name);
+            }
+            break;
+        }
+        if (ident->type == ast::StaticType::INTEGER) {
+            return unboxed({primary, Kind::OBJECT});
+        }
+        bool isBuiltin = evaluator::builtins.count(name) != 0;
+        if (primary == "nullptr" && isBuiltin) {
+            return {builtin(name), Kind::OBJECT};
+        }
+        // locals read before their `let` ran fall back to the globals, as in evalIdentifier
+        std::string t = temp();
+        line("object::Object *" + t + " = " + primary + ";");
+        if (binding.kind != ast::BindingKind::GLOBAL && globals_.count(name) != 0) {
+            line("if (" + t + " == nullptr) { " + t + " = " + global(name) + "; }");
+        }
+        if (isBuiltin) {
+            line("if (" + t + " == nullptr) { " + t + " = " + builtin(name) + "; }");
+        } else {
+            line("if (" + t + " == nullptr) { return monkeyc::notFound(" + nameString(name) + "); }");
+        }
+        return {t, Kind::OBJECT};
+    }
+
+    Value prefixExpression(ast::PrefixExpression *prefix) {
+        Value right = evaluate(prefix->right.get());
+        std::string t;
+        if (prefix->oper == "!") {
+            switch (right.kind) {
+            case Kind::INTEGER:
+                return {"false", Kind::BOOLEAN};
+            case Kind::BOOLEAN:
+                t = temp();
+                line("const bool " + t + " = !" + right.code + ";");
+                return {t, Kind::BOOLEAN};
+            case Kind::OBJECT:
+                t = temp();
+                line("object::Object *" + t + " = evaluator::evalBangOperatorExpression(" + right.code + ");");
+                return {t, Kind::OBJECT};
+            }
+        } else if (right.kind == Kind::INTEGER) {
+            t = temp();
+            line("const int " + t + " = monkeyc::neg(" + right.code + ");");
+            return {t, Kind::INTEGER};
+        }
+        return {check("evaluator::evalMinusOperatorExpression(" + box(right) + ")"), Kind::OBJECT};
+    }
+
+    Value infixExpression(ast::InfixExpression *infix) {
+        Value left = evaluate(infix->left.get());
+        Value right = evaluate(infix->right.get());
+        const std::string &oper = infix->oper;
+        const std::string &name = OPERATORS.at(oper);
+        bool comparison = oper == "<" || oper == ">" || oper == "==" || oper == "!=";
+        // a proven result type tells the operand types: integers for
+        // arithmetic and ordering, and the same type on both sides of ==
+        bool integers = infix->type == ast::StaticType::INTEGER ||
+                        (infix->type == ast::StaticType::BOOLEAN &&
+                         (oper == "<" || oper == ">" || left.kind == Kind::INTEGER || right.kind == Kind::INTEGER));
+        if (integers) {
+            left = unboxed(left);
+            right = unboxed(right);
+        }
+        if (left.kind == Kind::INTEGER && right.kind == Kind::INTEGER) {
+            std::string t = temp();
+            if (comparison) {
+                line("const bool " + t + " = " + left.code + " " + oper + " " + right.code + ";");
+                return {t, Kind::BOOLEAN};
+            } else if (oper == "/") {
+                line("const int " + t + " = " + left.code + " / " + right.code + ";");
+            } else {
+                std::string function = oper == "+" ? "add" : oper == "-" ? "sub" : "mul";
+                line("const int " + t + " = monkeyc::" + function + "(" + left.code + ", " + right.code + ");");
+            }
+            return {t, Kind::INTEGER};
+        } else if (left.kind == Kind::BOOLEAN && right.kind == Kind::BOOLEAN && (oper == "==" || oper == "!=")) {
+            std::string t = temp();
+            line("const bool " + t + " = " + left.code + " " + oper + " " + right.code + ";");
+            return {t, Kind::BOOLEAN};
+        }
+        std::string l = left.kind == Kind::INTEGER ? left.code : box(left);
+        std::string r = right.kind == Kind::INTEGER ? right.code : box(right);
+        return {check("monkeyc::infix<monkeyc::Operator::" + name + ">(" + l + ", " + r + ")"), Kind::OBJECT};
+    }
+
+    Value conditional(ast::IfExpression *node, bool wanted) {
+        Value condition = evaluate(node->condition.get());
+        std::string target;
+        if (wanted) {
+            target = temp();
+            line("object::Object *" + target + " = nullptr;");
+        }
+        open("if (" + truthy(condition) + ")");
+        block(node->consiquence.get(), wanted ? &target : nullptr);
+        if (node->alternative != nullptr) {
+            close("} else {");
+            context_->indent++;
+            block(node->alternative.get(), wanted ? &target : nullptr);
+        } else if (wanted) {
+            close("} else {");
+            context_->indent++;
+            line(target + " = &evaluator::NULL_OBJECT;");
+        }
+        close();
+        return {wanted ? target : "nullptr", Kind::OBJECT};
+    }
+
+    Value closure(ast::FunctionLiteral *literal) {
+        std::string t = temp();
+        line("auto *" + t + " = new monkeyc::CompiledFunction(p" + std::to_string(ids_.at(literal)) + ", " +
+             quote(functionText(literal)) + ");");
+        std::vector<std::string> upvalues;
+        for (const auto &capture : literal->prototype->captures) {
+            upvalues.push_back(capture.fromCell ? cell(capture.index)
+                                                : "self->upvalues[" + std::to_string(capture.index) + "]");
+        }
+        if (!upvalues.empty()) {
+            line(t + "->upvalues = {" + join(upvalues) + "};");
+        }
+        return {t, Kind::OBJECT};
+    }
+
+    Value callExpression(ast::CallExpression *call) {
+        std::string function = box(evaluate(call->function.get()));
+        std::vector<std::string> arguments;
+        for (const auto &argument : call->arguments) {
+            arguments.push_back(box(evaluate(argument.get())));
+        }
+        std::string count = std::to_string(arguments.size());
+        std::string argv;
+        std::string args = "object::Args{nullptr, 0}";
+        if (!arguments.empty()) {
+            argv = temp();
+            line("object::Object *" + argv + "[] = {" + join(arguments) + "};");
+            args = "object::Args{" + argv + ", " + count + "}";
+        }
+        ast::FunctionLiteral *literal = context_->literal;
+        bool maybeSelf = literal != nullptr && arguments.size() == literal->parameters.size();
+        if (call->tail && literal != nullptr) {
+            if (maybeSelf) {
+                open("if (" + function + " == self)");
+                for (std::size_t i = 0; i < arguments.size(); i++) {
+                    line("a[" + std::to_string(i) + "] = " + argv + "[" + std::to_string(i) + "];");
+                }
+                line("goto start;");
+                close();
+                context_->loops = true;
+            }
+            line(arguments.empty() ? "evaluator::tailArguments.clear();"
+                                   : "evaluator::tailArguments.assign(" + argv + ", " + argv + " + " + count + ");");
+            line("return object::Result(" + function + ", object::Result::Status::TAIL_CALL);");
+            return {"nullptr", Kind::OBJECT};
+        }
+        std::string result = "evaluator::applyFunction(" + function + ", " + args + ")";
+        if (maybeSelf) {
+            result = function + " == self ? monkeyc::finish(f" + std::to_string(ids_.at(literal)) + "(self, " + args +
+                     ")) : " + result;
+        }
+        return {check(result), Kind::OBJECT};
+    }
+
+    Value assignment(ast::AssignExpression *assign) {
+        if (auto index = dynamic_cast<ast::IndexExpression *>(assign->target.get())) {
+            std::string left = boxed(evaluate(index->left.get()));
+            std::string key = boxed(evaluate(index->index.get()));
+            std::string value = boxed(evaluate(assign->value.get()));
+            return {check("evaluator::assignIndex(" + left + ", " + key + ", " + value + ")"), Kind::OBJECT};
+        }
+        auto target = static_cast<ast::Identifier *>(assign->target.get());
+        const ast::Binding &binding = target->binding;
+        Value value = evaluate(assign->value.get());
+        if (binding.kind == ast::BindingKind::LOCAL && context_->integers.count(binding.index) != 0) {
+            Value integer = unboxed(value);
+            line(slot(binding.index) + " = " + integer.code + ";");
+            return integer;
+        }
+        std::string boxedValue = boxed(value);
+        if (binding.kind != ast::BindingKind::GLOBAL) {
+            store(binding, target->value, boxedValue);
+        } else if (globals_.count(target->value) != 0) {
+            line("if (" + global(target->value) + " == nullptr) { return monkeyc::notFound(" +
+                 nameString(target->value) + "); }");
+            store(binding, target->value, boxedValue);
+        } else {
+            line("return monkeyc::notFound(" + nameString(target->value) + ");");
+        }
+        return {boxedValue, Kind::OBJECT};
+    }
+
+    std::string prototypeSetup(ast::FunctionLiteral *literal) {
+        const object::FunctionPrototype *prototype = literal->prototype.get();
+        std::vector<std::string> parameters;
+        std::vector<std::string> bindings;
+        for (std::size_t i = 0; i < prototype->arity; i++) {
+            parameters.push_back(quote(prototype->parameters[i]));
+            const ast::Binding &binding = prototype->parameterBindings[i];
+            bindings.push_back(std::string("{") + bindingKind(binding.kind) + ", " + std::to_string(binding.index) +
+                               "}");
+        }
+        std::vector<std::string> captures;
+        for (const auto &capture : prototype->captures) {
+            captures.push_back(std::string("{") + (capture.fromCell ? "true" : "false") + ", " +
+                               std::to_string(capture.index) + "}");
+        }
+        std::string id = std::to_string(ids_.at(literal));
+        std::ostringstream out;
+        out << "    {\n"
+            << "        auto prototype = std::make_shared<object::FunctionPrototype>(\n"
+            << "            std::vector<std::string>{" << join(parameters) << "}, std::vector<ast::Binding>{"
+            << join(bindings) << "}, nullptr,\n"
+            << "            std::vector<object::FunctionPrototype::Capture>{" << join(captures) << "}, "
+            << prototype->slotCount << ", " << prototype->cellCount << ");\n"
+            << "        evaluator::profileOf(prototype.get()).entry = f" << id << ";\n"
+            << "        p" << id << " = prototype;\n"
+            << "    }\n";
+        return out.str();
+    }
+
+    std::string assemble() {
+        std::ostringstream out;
+        out << "// Generated by monkeyc.\n"
+            << "#include \"monkeyc/Runtime.h\"\n"
+            << "#include <cstddef>\n"
+            << "#include <memory>\n"
+            << "#include <string>\n"
+            << "#include <vector>\n\n"
+            << "namespace {\n\n";
+        for (const auto &name : globals_) {
+            out << "object::Object *" << global(name) << " = nullptr;\n";
+        }
+        for (const auto &name : builtins_) {
+            out << "object::Object *b_" << name << " = nullptr;\n";
+        }
+        for (const auto &name : names_) {
+            out << "const std::string n_" << name << " = " << quote(name) << ";\n";
+        }
+        for (const auto &constant : strings_) {
+            out << "object::Object *" << constant.second << " = nullptr;\n";
+        }
+        for (const auto &constant : integers_) {
+            out << "object::Object *" << constant.second << " = nullptr;\n";
+        }
+        for (std::size_t i = 0; i < literals_.size(); i++) {
+            out << "std::shared_ptr<const object::FunctionPrototype> p" << i << ";\n";
+        }
+        for (std::size_t i = 0; i < literals_.size(); i++) {
+            out << "object::Result f" << i << "(object::Function *self, object::Args args);\n";
+        }
+        for (const auto &function : functions_) {
+            out << '\n' << function;
+        }
+        out << "\nvoid setup() {\n";
+        for (const auto &name : builtins_) {
+            out << "    b_" << name << " = evaluator::builtins.at(" << quote(name) << ");\n";
+        }
+        for (const auto &constant : strings_) {
+            out << "    " << constant.second << " = object::String::intern(" << quote(constant.first) << ");\n";
+        }
+        for (const auto &constant : integers_) {
+            out << "    " << constant.second << " = new object::Integer(" << constant.first << ");\n";
+        }
+        for (ast::FunctionLiteral *literal : literals_) {
+            out << prototypeSetup(literal);
+        }
+        out << "}\n\n"
+            << "} // namespace\n\n"
+            << "int main() {\n"
+            << "    setup();\n"
+            << "    return monkeyc::report(program());\n"
+            << "}\n";
+        return out.str();
+    }
+};
+
+} // namespace
+
+std::string transpile(ast::Program *program) { return Transpiler().run(program); }
+
+} // namespace monkeyc
@@ -0,0 +1,165 @@
+#include "evaluator/TypeInference.h"
+#include "lexer.h"
+#include "monkeyc/Transpiler.h"
+#include "parser.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Where the generated C++ finds the runtime; set by the Makefile.
+#ifndef MONKEYC_INCLUDE_DIR
+#define MONKEYC_INCLUDE_DIR "include"
+#endif
+#ifndef MONKEYC_RUNTIME
+#define MONKEYC_RUNTIME "bin/libmonkey.a"
+#endif
+
+// Writes `code` to a new file of its own in $TMPDIR (or /tmp), so nothing
+// next to the output is overwritten or removed; false if that fails.
+static bool writeTemporary(const std::string &code, std::string &path) {
+    const char *directory = std::getenv("TMPDIR");
+    std::string pattern = std::string(directory != nullptr && *directory != '\0' ? directory : "/tmp") +
+                          "/monkeyc-XXXXXX.cpp";
+    std::vector<char> name(pattern.begin(), pattern.end());
+    name.push_back('\0');
+    int fd = mkstemps(name.data(), 4);
+    if (fd < 0) {
+        return false;
+    }
+    path = name.data();
+    bool written = write(fd, code.data(), code.size()) == static_cast<ssize_t>(code.size());
+    if (close(fd) != 0 || !written) {
+        std::remove(path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Runs `command` without a shell, so no argument is ever reinterpreted;
+// true if it exits with status 0.
+static bool run(const std::vector<std::string> &command) {
+    std::vector<char *> argv;
+    for (const std::string &arg : command) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        return false;
+    } else if (pid == 0) {
+        execvp(argv[0], argv.data());
+        std::perror(argv[0]);
+        _exit(127);
+    }
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// monkeyc [-o output] [--emit-cpp] [--dump-types] script
+// Compiles a Monkey script ahead of time into a standalone executable,
+// named after the script unless -o is given. --emit-cpp writes the
+// generated C++ (see include/monkeyc/Transpiler.h) to the output instead,
+// and --dump-types prints the types inferTypes proved to stdout.
+// The C++ is built in a temporary file with g++, or with the compiler that
+// MONKEYC_CXX names in the environment.
+int main(int argc, char *argv[]) {
+    const char *script = nullptr;
+    std::string output;
+    bool emitCpp = false;
+    bool dumpTypes = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--emit-cpp") {
+            emitCpp = true;
+        } else if (arg == "--dump-types") {
+            dumpTypes = true;
+        } else if (arg == "-o" && i + 1 < argc) {
+            output = argv[++i];
+        } else if (script == nullptr && arg[0] != '-') {
+            script = argv[i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [-o output] [--emit-cpp] [--dump-types] script" << '\n';
+            return 2;
+        }
+    }
+    if (script == nullptr) {
+        std::cerr << "usage: " << argv[0] << " [-o output] [--emit-cpp] [--dump-types] script" << '\n';
+        return 2;
+    }
+    std::ifstream in(script);
+    if (!in) {
+        std::cerr << "cannot open " << script << '\n';
+        return 2;
+    }
+    std::stringstream source;
+    source << in.rdbuf();
+    parser::Parser parser = parser::Parser(std::make_unique<lexer::Lexer>(source.str()));
+    std::unique_ptr<ast::Program> program = parser.parseProgram();
+    if (parser.errors()->size() != 0) {
+        for (const auto &err : *parser.errors()) {
+            std::cerr << script << ": " << err << '\n';
+        }
+        return 1;
+    }
+    if (dumpTypes) {
+        evaluator::inferTypes(program.get());
+        std::cout << evaluator::dumpTypes(program.get());
+        return 0;
+    }
+    if (output.empty()) {
+        std::string path = script;
+        std::size_t dot = path.rfind('.');
+        std::size_t slash = path.rfind('/');
+        output = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? path.substr(0, dot)
+                                                                                         : path + ".out";
+        if (emitCpp) {
+            output += ".cpp";
+        }
+    }
+    std::string code = monkeyc::transpile(program.get());
+    if (emitCpp) {
+        std::ofstream out(output);
+        if (!out) {
+            std::cerr << "cannot write " << output << '\n';
+            return 2;
+        }
+        out << code;
+        return 0;
+    }
+    std::string cpp;
+    if (!writeTemporary(code, cpp)) {
+        std::cerr << "cannot write a temporary file" << '\n';
+        return 2;
+    }
+    const char *compiler = std::getenv("MONKEYC_CXX");
+    std::vector<std::string> command = {compiler != nullptr ? compiler : "g++",
+                                        "-std=c++17",
+                                        "-O2",
+                                        "-I" MONKEYC_INCLUDE_DIR,
+                                        cpp,
+                                        MONKEYC_RUNTIME,
+                                        "-pthread",
+                                        "-o",
+                                        output};
+    bool built = run(command);
+    std::remove(cpp.c_str());
+    if (!built) {
+        std::cerr << "monkeyc: " << command[0] << " failed" << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -22,7 +22,6 @@ std::string Array::inspect() const {
     oss << "]";
     return oss.str();
 }
-ObjectType Array::type() const { return objectType; }
 std::string Array::typeToString() const { return "ARRAY"; }
 
 } // namespace object
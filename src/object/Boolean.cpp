@@ -12,7 +12,6 @@ std::string Boolean::inspect() const {
     }
     return std::to_string(value); 
 }
-ObjectType Boolean::type() const { return objectType; }
 
 std::string Boolean::typeToString() const { return "BOOLEAN"; }
 
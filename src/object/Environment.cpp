@@ -5,7 +5,7 @@
 
 namespace object {
 
-Object *Environment::get(std::string &name) {
+Object *Environment::get(const std::string &name) {
     auto item = store.find(name);
     Object *result;
     if (item == store.end() && outer != nullptr) {
@@ -13,14 +13,25 @@ Object *Environment::get(std::string &name) {
     } else if (item == store.end()) {
         result = nullptr;
     } else {
-        result = item->second.get();
+        result = item->second;
     }
     return result;
 }
 
-Object *Environment::set(std::string name, std::unique_ptr<Object> value) {
-    store[name] = std::move(value);
-    return store[name].get();
+bool Environment::assign(const std::string &name, Object *value) {
+    for (Environment *env = this; env != nullptr; env = env->outer) {
+        auto item = env->store.find(name);
+        if (item != env->store.end()) {
+            item->second = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+Object *Environment::set(const std::string &name, Object *value) {
+    store[name] = value;
+    return value;
 }
 
 } // namespace object
@@ -5,7 +5,47 @@
 namespace object {
 
 std::string Error::inspect() const { return "Error: " + message; }
-ObjectType Error::type() const { return objectType; }
 std::string Error::typeToString() const { return "ERROR"; }
 
+std::string ErrorInfo::message() const {
+    std::string oper = text;
+    switch (code) {
+    case ErrorCode::UNKNOWN_OPERATOR:
+        if (right == nullptr) {
+            return "unknown operator: " + oper + left->typeToString();
+        }
+        return "unknown operator: " + left->typeToString() + " " + oper + " " + right->typeToString();
+    case ErrorCode::TYPE_MISMATCH:
+        return "type mismatch: " + left->typeToString() + " " + oper + " " + right->typeToString();
+    case ErrorCode::IDENTIFIER_NOT_FOUND:
+        return "identifier not found: " + *name;
+    case ErrorCode::NOT_A_FUNCTION:
+        return "not a function: " + left->typeToString();
+    case ErrorCode::WRONG_ARGUMENT_COUNT:
+        return "wrong number of arguments. want=" + (oper.empty() ? std::to_string(want) : oper) +
+               " but got=" + std::to_string(got);
+    case ErrorCode::TOO_FEW_ARGUMENTS:
+        return "wrong number of arguments. want at least " + std::to_string(want) + " but got=" + std::to_string(got);
+    case ErrorCode::ARGUMENT_NOT_SUPPORTED:
+        return "argument to `" + oper + "` not supported, got " + left->typeToString();
+    case ErrorCode::ARGUMENT_TYPE:
+        return "argument to `" + oper + "` must be " + expected + ", got " + left->typeToString();
+    case ErrorCode::UNUSABLE_AS_HASH_KEY:
+        return "unusable as hash key: " + left->typeToString();
+    case ErrorCode::UNUSABLE_AS_SET_MEMBER:
+        return "unusable as set member: " + left->typeToString();
+    case ErrorCode::INDEX_NOT_SUPPORTED:
+        return "index operator not supported: " + left->typeToString();
+    case ErrorCode::INDEX_OUT_OF_RANGE:
+        return "index out of range: " + std::to_string(want) + " (length " + std::to_string(got) + ")";
+    case ErrorCode::NOT_ITERABLE:
+        return "not iterable: " + left->typeToString();
+    case ErrorCode::ZERO_STEP:
+        return "step of `" + oper + "` must not be zero";
+    case ErrorCode::BUDGET_EXCEEDED:
+        return "evaluation exceeded its memory budget of " + std::to_string(want) + " bytes";
+    }
+    return "unknown error";
+}
+
 } // namespace object
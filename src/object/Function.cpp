@@ -9,22 +9,22 @@ namespace object {
 std::string Function::inspect() const {
     std::ostringstream oss;
     std::string params;
-    for (size_t i; i < parameters.size(); i++) {
-        if (i == parameters.size() - 1){
-            params += parameters[i]->toString();
+    const auto &parameters = prototype->parameters;
+    for (size_t i = 0; i < parameters.size(); i++) {
+        if (i == parameters.size() - 1) {
+            params += parameters[i];
         } else {
-            params += parameters[i]->toString() + ", ";
+            params += parameters[i] + ", ";
         }
     }
     oss << "fn";
     oss << "(";
     oss << params;
     oss << ") {\n";
-    oss << body->toString();
+    oss << prototype->body->toString();
     oss << "\n}";
     return oss.str();
 }
-ObjectType Function::type() const { return objectType; }
 std::string Function::typeToString() const { return "FUNCTION"; }
 
 } // namespace object
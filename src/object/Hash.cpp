@@ -1,5 +1,10 @@
 #include "object/Hash.h"
+#include "object/Hashable.h"
+#include "object/Integer.h"
+#include "object/Shape.h"
+#include "object/String.h"
 #include "object/object.h"
+#include <algorithm>
 #include <sstream>
 #include <string>
 
@@ -8,6 +13,24 @@ namespace object {
 std::string Hash::inspect() const {
     std::ostringstream oss;
     oss << "{";
+    if (isRecord()) {
+        for (std::size_t i = 0; i < slots.size(); i++) {
+            oss << shape->keys()[i]->inspect();
+            oss << ": ";
+            oss << slots[i]->inspect();
+            oss << ", ";
+        }
+    } else if (isDense()) {
+        for (std::size_t i = 0; i < slots.size(); i++) {
+            if (getDense(i) == nullptr) {
+                continue;
+            }
+            oss << i;
+            oss << ": ";
+            oss << slots[i]->inspect();
+            oss << ", ";
+        }
+    }
     for (const auto &pair : pairs) {
         oss << pair.second.key->inspect();
         oss << ": ";
@@ -17,7 +40,155 @@ std::string Hash::inspect() const {
     oss << "}";
     return oss.str();
 }
-ObjectType Hash::type() const { return objectType; }
 std::string Hash::typeToString() const { return "HASH"; }
 
+std::size_t Hash::size() const {
+    switch (representation) {
+    case Representation::RECORD:
+        return slots.size();
+    case Representation::DENSE:
+        return denseCount_;
+    default:
+        return pairs.size();
+    }
+}
+
+Object *Hash::get(Object *key) const {
+    if (isRecord()) {
+        if (key->type() != ObjectType::STRING_OBJ) {
+            return nullptr;
+        }
+        int slot = shape->slotOf(static_cast<String *>(key));
+        return slot < 0 ? nullptr : slots[slot];
+    } else if (isDense()) {
+        if (key->type() != ObjectType::INTEGER_OBJ) {
+            return nullptr;
+        }
+        return getDense(static_cast<Integer *>(key)->value);
+    }
+    auto pair = findPair(key);
+    return pair == pairs.end() ? nullptr : pair->second.value;
+}
+
+std::multimap<HashKey, HashPair>::const_iterator Hash::findPair(const Object *key) const {
+    auto range = pairs.equal_range(hashKey(key));
+    for (auto pair = range.first; pair != range.second; ++pair) {
+        if (keysEqual(pair->second.key, key)) {
+            return pair;
+        }
+    }
+    return pairs.end();
+}
+
+Object *Hash::keyAfter(const Object *previous) const {
+    if (isRecord()) {
+        std::size_t next = 0;
+        if (previous != nullptr) {
+            int slot = shape->slotOf(static_cast<const String *>(previous));
+            if (slot < 0) {
+                return nullptr;
+            }
+            next = slot + 1;
+        }
+        return next < shape->size() ? shape->keys()[next] : nullptr;
+    } else if (isDense()) {
+        std::size_t next = previous == nullptr ? 0 : static_cast<const Integer *>(previous)->value + 1;
+        for (; next < slots.size(); next++) {
+            if (present[next / 64] >> (next % 64) & 1) {
+                return new Integer(static_cast<int>(next));
+            }
+        }
+        return nullptr;
+    }
+    auto pair = pairs.begin();
+    if (previous != nullptr) {
+        pair = findPair(previous);
+        if (pair == pairs.end()) {
+            return nullptr;
+        }
+        ++pair;
+    }
+    return pair == pairs.end() ? nullptr : pair->second.key;
+}
+
+void Hash::set(Object *key, Object *value) {
+    if (isRecord() && key->type() == ObjectType::STRING_OBJ) {
+        auto str = static_cast<String *>(key);
+        int slot = shape->slotOf(str);
+        if (slot >= 0) {
+            slots[slot] = value;
+            return;
+        }
+        // only interned keys, which come from string literals, extend the
+        // shape tree; interning every computed key would grow the intern
+        // table and the tree without bound
+        if (str->isInterned() && shape->size() < Shape::MAX_KEYS) {
+            shape = shape->withKey(str);
+            slots.push_back(value);
+            return;
+        }
+    } else if (key->type() == ObjectType::INTEGER_OBJ && (isDense() || (isRecord() && slots.empty()))) {
+        int k = static_cast<Integer *>(key)->value;
+        if (fitsDense(k)) {
+            setDense(k, value);
+            return;
+        }
+    }
+    if (representation != Representation::GENERAL) {
+        generalize();
+    }
+    auto pair = findPair(key);
+    if (pair != pairs.end()) {
+        pairs.erase(pair);
+    }
+    pairs.emplace(hashKey(key), HashPair{key, value});
+}
+
+bool Hash::fitsDense(int key) const {
+    if (key < 0) {
+        return false;
+    }
+    std::size_t span = std::max(DENSE_MIN_SPAN, DENSE_FACTOR * (denseCount_ + 1));
+    return static_cast<std::size_t>(key) < span;
+}
+
+void Hash::setDense(int key, Object *value) {
+    if (!isDense()) {
+        representation = Representation::DENSE;
+        shape = nullptr;
+    }
+    std::size_t index = key;
+    if (index >= slots.size()) {
+        slots.resize(index + 1, nullptr);
+        present.resize(index / 64 + 1, 0);
+    }
+    std::uint64_t bit = std::uint64_t{1} << (index % 64);
+    if (!(present[index / 64] & bit)) {
+        present[index / 64] |= bit;
+        denseCount_++;
+    }
+    slots[index] = value;
+}
+
+void Hash::generalize() {
+    if (isRecord()) {
+        for (std::size_t i = 0; i < slots.size(); i++) {
+            String *key = shape->keys()[i];
+            pairs.emplace(key->hashKey(), HashPair{key, slots[i]});
+        }
+    } else if (isDense()) {
+        for (std::size_t i = 0; i < slots.size(); i++) {
+            if (getDense(i) != nullptr) {
+                Integer *key = new Integer(i);
+                pairs.emplace(key->hashKey(), HashPair{key, slots[i]});
+            }
+        }
+    }
+    slots.clear();
+    present.clear();
+    denseCount_ = 0;
+    shape = nullptr;
+    representation = Representation::GENERAL;
+}
+
 } // namespace object
@@ -0,0 +1,34 @@
+#include "object/Hashable.h"
+#include "object/Boolean.h"
+#include "object/Integer.h"
+#include "object/String.h"
+#include "object/object.h"
+
+namespace object {
+
+HashKey hashKey(const Object *object) {
+    switch (object->type()) {
+    case ObjectType::INTEGER_OBJ:
+        return static_cast<const Integer *>(object)->hashKey();
+    case ObjectType::BOOLEAN_OBJ:
+        return static_cast<const Boolean *>(object)->hashKey();
+    default:
+        return static_cast<const String *>(object)->hashKey();
+    }
+}
+
+bool keysEqual(const Object *left, const Object *right) {
+    if (left == right) {
+        return true;
+    }
+    if (left->type() != right->type()) {
+        return false;
+    }
+    if (left->type() == ObjectType::STRING_OBJ) {
+        return static_cast<const String *>(left)->equals(static_cast<const String *>(right));
+    }
+    // integer and boolean hash keys carry the full value
+    return true;
+}
+
+} // namespace object
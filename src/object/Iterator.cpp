@@ -0,0 +1,24 @@
+#include "object/Iterator.h"
+#include "object/object.h"
+#include <string>
+
+namespace object {
+
+std::string Iterator::inspect() const {
+    switch (stage) {
+    case Stage::SOURCE:
+        return "iterator(" + source->inspect() + ")";
+    case Stage::MAP:
+        return "map(" + upstream->inspect() + ")";
+    case Stage::FILTER:
+        return "filter(" + upstream->inspect() + ")";
+    case Stage::TAKE:
+        return "take(" + upstream->inspect() + ", " + std::to_string(limit) + ")";
+    case Stage::ZIP:
+        return "zip(" + upstream->inspect() + ", " + other->inspect() + ")";
+    }
+    return "iterator";
+}
+std::string Iterator::typeToString() const { return "ITERATOR"; }
+
+} // namespace object
@@ -5,7 +5,6 @@
 namespace object {
 
 std::string Null::inspect() const { return "null"; }
-ObjectType Null::type() const { return objectType; }
 std::string Null::typeToString() const { return "NULL"; }
 
 } // namespace object
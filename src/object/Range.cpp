@@ -0,0 +1,27 @@
+#include "object/Range.h"
+#include "object/object.h"
+#include <cstddef>
+#include <string>
+
+namespace object {
+
+std::string Range::inspect() const {
+    std::string result = "range(" + std::to_string(start) + ", " + std::to_string(end);
+    if (step != 1) {
+        result += ", " + std::to_string(step);
+    }
+    return result + ")";
+}
+std::string Range::typeToString() const { return "RANGE"; }
+
+std::size_t Range::size() const {
+    long span = static_cast<long>(end) - start;
+    if (step > 0 && span > 0) {
+        return static_cast<std::size_t>((span + step - 1) / step);
+    } else if (step < 0 && span < 0) {
+        return static_cast<std::size_t>((-span - step - 1) / -step);
+    }
+    return 0;
+}
+
+} // namespace object
@@ -0,0 +1,281 @@
+#include "object/Set.h"
+#include "object/Hashable.h"
+#include "object/Integer.h"
+#include "object/object.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace object {
+
+namespace {
+// marks a removed table entry so that probe chains stay intact
+Integer TOMBSTONE{0};
+
+enum class BitsetOp { UNION, INTERSECT, DIFFERENCE };
+
+// Combines two word vectors into `out`, two words per SSE2 instruction where
+// available. `out` must be as long as `left`; missing words in `right` count
+// as zero.
+void combineWords(const std::vector<std::uint64_t> &left, const std::vector<std::uint64_t> &right,
+                  std::vector<std::uint64_t> &out, BitsetOp op) {
+    std::size_t shared = std::min(left.size(), right.size());
+    std::size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 2 <= shared; i += 2) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&left[i]));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&right[i]));
+        __m128i r;
+        if (op == BitsetOp::UNION) {
+            r = _mm_or_si128(a, b);
+        } else if (op == BitsetOp::INTERSECT) {
+            r = _mm_and_si128(a, b);
+        } else {
+            r = _mm_andnot_si128(b, a);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(&out[i]), r);
+    }
+#endif
+    for (; i < shared; i++) {
+        if (op == BitsetOp::UNION) {
+            out[i] = left[i] | right[i];
+        } else if (op == BitsetOp::INTERSECT) {
+            out[i] = left[i] & right[i];
+        } else {
+            out[i] = left[i] & ~right[i];
+        }
+    }
+    for (; i < left.size(); i++) {
+        out[i] = op == BitsetOp::INTERSECT ? 0 : left[i];
+    }
+}
+
+std::size_t popcount(const std::vector<std::uint64_t> &words) {
+    std::size_t count = 0;
+    for (std::uint64_t word : words) {
+        count += __builtin_popcountll(word);
+    }
+    return count;
+}
+} // namespace
+
+std::string Set::inspect() const {
+    std::ostringstream oss;
+    oss << "set(";
+    std::vector<Object *> elements = members();
+    for (std::size_t i = 0; i < elements.size(); i++) {
+        if (i > 0) {
+            oss << ", ";
+        }
+        oss << elements[i]->inspect();
+    }
+    oss << ")";
+    return oss.str();
+}
+std::string Set::typeToString() const { return "SET"; }
+
+std::size_t Set::size() const { return bitset_ ? popcount(bits_) : count_; }
+
+bool Set::has(Object *member) const {
+    int value;
+    if (bitset_) {
+        if (!fitsBitset(member, value) || static_cast<std::size_t>(value / 64) >= bits_.size()) {
+            return false;
+        }
+        return bits_[value / 64] >> (value % 64) & 1;
+    }
+    if (table_.empty()) {
+        return false;
+    }
+    return table_[findSlot(member, hashOf(member))].member != nullptr;
+}
+
+void Set::add(Object *member) {
+    int value;
+    if (bitset_) {
+        if (fitsBitset(member, value)) {
+            if (static_cast<std::size_t>(value / 64) >= bits_.size()) {
+                bits_.resize(value / 64 + 1, 0);
+            }
+            bits_[value / 64] |= std::uint64_t{1} << (value % 64);
+            return;
+        }
+        convertToTable();
+    }
+    std::size_t hash = hashOf(member);
+    if (!table_.empty() && table_[findSlot(member, hash)].member != nullptr) {
+        return;
+    }
+    insertEntry(member, hash);
+}
+
+void Set::remove(Object *member) {
+    int value;
+    if (bitset_) {
+        if (fitsBitset(member, value) && static_cast<std::size_t>(value / 64) < bits_.size()) {
+            bits_[value / 64] &= ~(std::uint64_t{1} << (value % 64));
+        }
+        return;
+    }
+    if (table_.empty()) {
+        return;
+    }
+    Entry &entry = table_[findSlot(member, hashOf(member))];
+    if (entry.member != nullptr) {
+        entry.member = &TOMBSTONE;
+        count_--;
+    }
+}
+
+std::vector<Object *> Set::members() const {
+    std::vector<Object *> result;
+    if (bitset_) {
+        for (std::size_t word = 0; word < bits_.size(); word++) {
+            std::uint64_t bits = bits_[word];
+            while (bits != 0) {
+                int bit = __builtin_ctzll(bits);
+                result.push_back(new Integer(word * 64 + bit));
+                bits &= bits - 1;
+            }
+        }
+        return result;
+    }
+    for (const Entry &entry : table_) {
+        if (entry.member != nullptr && entry.member != &TOMBSTONE) {
+            result.push_back(entry.member);
+        }
+    }
+    return result;
+}
+
+Set *Set::unionOf(const Set *left, const Set *right) {
+    Set *result = new Set();
+    if (left->bitset_ && right->bitset_) {
+        const Set *longer = left->bits_.size() >= right->bits_.size() ? left : right;
+        const Set *shorter = longer == left ? right : left;
+        result->bits_.resize(longer->bits_.size());
+        combineWords(longer->bits_, shorter->bits_, result->bits_, BitsetOp::UNION);
+        return result;
+    }
+    for (Object *member : left->members()) {
+        result->add(member);
+    }
+    for (Object *member : right->members()) {
+        result->add(member);
+    }
+    return result;
+}
+
+Set *Set::intersectionOf(const Set *left, const Set *right) {
+    Set *result = new Set();
+    if (left->bitset_ && right->bitset_) {
+        result->bits_.resize(left->bits_.size());
+        combineWords(left->bits_, right->bits_, result->bits_, BitsetOp::INTERSECT);
+        return result;
+    }
+    const Set *smaller = left->size() <= right->size() ? left : right;
+    const Set *larger = smaller == left ? right : left;
+    for (Object *member : smaller->members()) {
+        if (larger->has(member)) {
+            result->add(member);
+        }
+    }
+    return result;
+}
+
+Set *Set::differenceOf(const Set *left, const Set *right) {
+    Set *result = new Set();
+    if (left->bitset_ && right->bitset_) {
+        result->bits_.resize(left->bits_.size());
+        combineWords(left->bits_, right->bits_, result->bits_, BitsetOp::DIFFERENCE);
+        return result;
+    }
+    for (Object *member : left->members()) {
+        if (!right->has(member)) {
+            result->add(member);
+        }
+    }
+    return result;
+}
+
+bool Set::fitsBitset(const Object *member, int &value) {
+    if (member->type() != ObjectType::INTEGER_OBJ) {
+        return false;
+    }
+    value = static_cast<const Integer *>(member)->value;
+    return value >= 0 && value < BITSET_LIMIT;
+}
+
+std::size_t Set::hashOf(const Object *member) {
+    HashKey key = object::hashKey(member);
+    std::size_t hash = static_cast<std::size_t>(key.value);
+    hash ^= static_cast<std::size_t>(key.type) << 56;
+    // mix the high bits down so that consecutive integers do not form long probe runs
+    hash *= 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 29);
+}
+
+// Returns the slot holding `member`, or the empty slot that ends its probe chain.
+std::size_t Set::findSlot(const Object *member, std::size_t hash) const {
+    std::size_t mask = table_.size() - 1;
+    for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Entry &entry = table_[i];
+        if (entry.member == nullptr) {
+            return i;
+        }
+        if (entry.member != &TOMBSTONE && entry.hash == hash && entry.member->type() == member->type() &&
+            keysEqual(entry.member, member)) {
+            return i;
+        }
+    }
+}
+
+void Set::insertEntry(Object *member, std::size_t hash) {
+    if ((used_ + 1) * 2 > table_.size()) {
+        growTable();
+    }
+    std::size_t mask = table_.size() - 1;
+    std::size_t i = hash & mask;
+    while (table_[i].member != nullptr && table_[i].member != &TOMBSTONE) {
+        i = (i + 1) & mask;
+    }
+    if (table_[i].member == nullptr) {
+        used_++;
+    }
+    table_[i] = Entry{member, hash};
+    count_++;
+}
+
+void Set::growTable() {
+    std::vector<Entry> old = std::move(table_);
+    // sized from the live count, so tables that churn through tombstones do not keep growing
+    std::size_t capacity = 8;
+    while (capacity < (count_ + 1) * 4) {
+        capacity *= 2;
+    }
+    table_.assign(capacity, Entry{nullptr, 0});
+    count_ = 0;
+    used_ = 0;
+    for (const Entry &entry : old) {
+        if (entry.member != nullptr && entry.member != &TOMBSTONE) {
+            insertEntry(entry.member, entry.hash);
+        }
+    }
+}
+
+void Set::convertToTable() {
+    std::vector<Object *> elements = members();
+    bitset_ = false;
+    bits_.clear();
+    for (Object *member : elements) {
+        insertEntry(member, hashOf(member));
+    }
+}
+
+} // namespace object
@@ -0,0 +1,40 @@
+#include "object/Shape.h"
+#include "object/String.h"
+#include <memory>
+
+namespace object {
+
+Shape *Shape::root() {
+    static Shape rootShape;
+    return &rootShape;
+}
+
+Shape *Shape::withKey(String *key) {
+    auto found = transitions_.find(key);
+    if (found != transitions_.end()) {
+        return found->second.get();
+    }
+    std::unique_ptr<Shape> next(new Shape());
+    next->keys_ = keys_;
+    next->keys_.push_back(key);
+    next->slots_ = slots_;
+    next->slots_[key] = keys_.size();
+    Shape *result = next.get();
+    transitions_[key] = std::move(next);
+    return result;
+}
+
+int Shape::slotOf(const String *key) const {
+    if (key->isInterned()) {
+        auto found = slots_.find(key);
+        return found == slots_.end() ? -1 : found->second;
+    }
+    for (std::size_t i = 0; i < keys_.size(); i++) {
+        if (keys_[i]->equals(key)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+} // namespace object
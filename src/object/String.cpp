@@ -1,20 +1,103 @@
 #include "object/String.h"
 #include "object/object.h"
+#include <cstdint>
 #include <functional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace object {
 
-std::string String::inspect() const { return value; }
-ObjectType String::type() const { return objectType; }
+// Keys are views into the interned String's own characters, which never
+// change once interned.
+static std::unordered_map<std::string_view, String *> internTable;
+
+std::size_t (*String::hasher)(std::string_view value) = [](std::string_view value) {
+    return std::hash<std::string_view>{}(value);
+};
+
+String::String(const String *left, const String *right)
+    : Object(ObjectType::STRING_OBJ), length_(left->length() + right->length()) {
+    if (length_ < ROPE_THRESHOLD) {
+        value_.reserve(length_);
+        value_ += left->value();
+        value_ += right->value();
+    } else {
+        left_ = left;
+        right_ = right;
+    }
+}
+
+std::string String::inspect() const { return value(); }
 std::string String::typeToString() const { return "STRING"; }
 
 HashKey String::hashKey() const{
-    std::hash<std::string> hasher;
-    std::size_t hashValue = hasher(value);
     HashKey result;
     result.type = type();
-    result.value = hashValue;
+    result.value = static_cast<std::int64_t>(hash());
     return result;
 }
+
+std::size_t String::hash() const {
+    if (!hashed_) {
+        hash_ = hasher(value());
+        hashed_ = true;
+    }
+    return hash_;
+}
+
+bool String::equals(const String *other) const {
+    if (this == other) {
+        return true;
+    }
+    if ((interned_ && other->interned_) || length_ != other->length_) {
+        return false;
+    }
+    if (hashed_ && other->hashed_ && hash_ != other->hash_) {
+        return false;
+    }
+    return value() == other->value();
+}
+
+String *String::intern(const std::string &value) {
+    auto found = internTable.find(value);
+    if (found != internTable.end()) {
+        return found->second;
+    }
+    String *str = new String(value);
+    str->interned_ = true;
+    internTable.emplace(str->value_, str);
+    return str;
+}
+
+const std::string &String::value() const {
+    if (!isFlat()) {
+        flatten();
+    }
+    return value_;
+}
+
+// Walks the rope left to right with an explicit stack so that the deep,
+// left-leaning trees produced by repeated `s = s + x` cannot overflow the
+// native stack.
+void String::flatten() const {
+    std::string result;
+    result.reserve(length_);
+    std::vector<const String *> pending{right_, left_};
+    while (!pending.empty()) {
+        const String *node = pending.back();
+        pending.pop_back();
+        if (node->isFlat()) {
+            result += node->value_;
+        } else {
+            pending.push_back(node->right_);
+            pending.push_back(node->left_);
+        }
+    }
+    value_ = std::move(result);
+    left_ = nullptr;
+    right_ = nullptr;
+}
+
 } // namespace object
@@ -0,0 +1,10 @@
+#include "object/StringBuilder.h"
+#include "object/object.h"
+#include <string>
+
+namespace object {
+
+std::string StringBuilder::inspect() const { return "builder(" + std::to_string(buffer.size()) + ")"; }
+std::string StringBuilder::typeToString() const { return "BUILDER"; }
+
+} // namespace object
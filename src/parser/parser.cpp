@@ -1,5 +1,6 @@
 #include "parser.h"
 #include "ast/ArrayLiteral.h"
+#include "ast/AssignExpression.h"
 #include "ast/BlockStatement.h"
 #include "ast/Boolean.h"
 #include "ast/CallExpression.h"
@@ -66,6 +67,8 @@ Parser::Parser(std::unique_ptr<lexer::Lexer> lexer) : lexer_(std::move(lexer)) {
     });
     registerInfix(token::TokenType::LBRACKET,
                   [this](std::unique_ptr<ast::Expression> left) { return parseIndexExpression(std::move(left)); });
+    registerInfix(token::TokenType::ASSIGN,
+                  [this](std::unique_ptr<ast::Expression> target) { return parseAssignExpression(std::move(target)); });
 }
 
 void Parser::nextToken() {
@@ -94,6 +97,13 @@ std::unique_ptr<ast::Statement> Parser::parseStatement() {
         return parseLetStatement();
     case token::TokenType::RETURN:
         return parseReturnStatement();
+    case token::TokenType::WHILE:
+        return parseWhileStatement();
+    case token::TokenType::FOR:
+        return parseForStatement();
+    case token::TokenType::BREAK:
+    case token::TokenType::CONTINUE:
+        return parseLoopControl();
     default:
         return parseExpressionStatement();
     }
@@ -130,6 +140,79 @@ std::unique_ptr<ast::ReturnStatement> Parser::parseReturnStatement() {
     return statement;
 }
 
+std::unique_ptr<ast::WhileStatement> Parser::parseWhileStatement() {
+    std::unique_ptr<ast::WhileStatement> statement = std::make_unique<ast::WhileStatement>();
+    statement->token = currentToken_;
+    if (!expectPeek(token::TokenType::LPAREN)) {
+        return nullptr;
+    }
+    nextToken();
+    statement->condition = parseExpression(Precedence::LOWEST);
+    if (!expectPeek(token::TokenType::RPAREN)) {
+        return nullptr;
+    }
+    if (!expectPeek(token::TokenType::LBRACE)) {
+        return nullptr;
+    }
+    statement->body = parseLoopBody();
+    return statement;
+}
+
+std::unique_ptr<ast::ForStatement> Parser::parseForStatement() {
+    std::unique_ptr<ast::ForStatement> statement = std::make_unique<ast::ForStatement>();
+    statement->token = currentToken_;
+    if (!expectPeek(token::TokenType::LPAREN)) {
+        return nullptr;
+    }
+    if (!expectPeek(token::TokenType::IDENT)) {
+        return nullptr;
+    }
+    statement->variable = std::make_unique<ast::Identifier>();
+    statement->variable->token = currentToken_;
+    statement->variable->value = currentToken_.literal;
+    if (!expectPeek(token::TokenType::IN)) {
+        return nullptr;
+    }
+    nextToken();
+    statement->iterable = parseExpression(Precedence::LOWEST);
+    if (!expectPeek(token::TokenType::RPAREN)) {
+        return nullptr;
+    }
+    if (!expectPeek(token::TokenType::LBRACE)) {
+        return nullptr;
+    }
+    statement->body = parseLoopBody();
+    return statement;
+}
+
+std::unique_ptr<ast::BlockStatement> Parser::parseLoopBody() {
+    loopDepth_++;
+    std::unique_ptr<ast::BlockStatement> body = parseBlockStatement();
+    loopDepth_--;
+    return body;
+}
+
+// break and continue are only valid inside a loop of the same function, so
+// the evaluator never sees one escape a loop.
+std::unique_ptr<ast::Statement> Parser::parseLoopControl() {
+    token::Token keyword = currentToken_;
+    if (peekTokenIs(token::TokenType::SEMICOLON)) {
+        nextToken();
+    }
+    if (loopDepth_ == 0) {
+        errors_.push_back(keyword.literal + " outside of a loop");
+        return nullptr;
+    }
+    if (keyword.type == token::TokenType::BREAK) {
+        std::unique_ptr<ast::BreakStatement> statement = std::make_unique<ast::BreakStatement>();
+        statement->token = keyword;
+        return statement;
+    }
+    std::unique_ptr<ast::ContinueStatement> statement = std::make_unique<ast::ContinueStatement>();
+    statement->token = keyword;
+    return statement;
+}
+
 std::unique_ptr<ast::ExpressionStatement> Parser::parseExpressionStatement() {
     std::unique_ptr<ast::ExpressionStatement> statement = std::make_unique<ast::ExpressionStatement>();
     statement->token = currentToken_;
@@ -175,6 +258,25 @@ std::unique_ptr<ast::Expression> Parser::parseIndexExpression(std::unique_ptr<as
     return expression;
 }
 
+// Assignment is right-associative, so the value is parsed at the lowest
+// precedence: a = b = c assigns c to both.
+std::unique_ptr<ast::Expression> Parser::parseAssignExpression(std::unique_ptr<ast::Expression> target) {
+    if (target == nullptr) {
+        return nullptr;
+    }
+    if (dynamic_cast<ast::Identifier *>(target.get()) == nullptr &&
+        dynamic_cast<ast::IndexExpression *>(target.get()) == nullptr) {
+        errors_.push_back("cannot assign to " + target->toString());
+        return nullptr;
+    }
+    std::unique_ptr<ast::AssignExpression> expression = std::make_unique<ast::AssignExpression>();
+    expression->token = currentToken_;
+    expression->target = std::move(target);
+    nextToken();
+    expression->value = parseExpression(Precedence::LOWEST);
+    return expression;
+}
+
 bool Parser::curTokenIs(token::TokenType tokenType) { return currentToken_.type == tokenType; }
 
 bool Parser::peekTokenIs(token::TokenType tokenType) { return peekToken_.type == tokenType; }
@@ -329,7 +431,10 @@ std::unique_ptr<ast::Expression> Parser::parseFunctionLiteral() {
     if (!expectPeek(token::TokenType::LBRACE)) {
         return nullptr;
     }
+    int enclosingLoops = loopDepth_;
+    loopDepth_ = 0;
     literal->body = parseBlockStatement();
+    loopDepth_ = enclosingLoops;
     return literal;
 }
 
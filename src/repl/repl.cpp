@@ -3,11 +3,12 @@
 #include "lexer.h"
 #include "parser.h"
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 
 namespace repl {
-void REPL::start(std::ostream &out) {
+void REPL::start(std::ostream &out, evaluator::Engine engine) {
     std::string line;
     object::Environment *env = new object::Environment();
 
@@ -26,12 +27,29 @@ void REPL::start(std::ostream &out) {
             printParserErrors(out, *parser.errors());
             continue;
         }
-        auto evaluated = evaluator::eval(program.get(), env);
+        auto evaluated = evaluator::evalWith(engine, program.get(), env);
         if (evaluated != nullptr) {
             out << evaluated->inspect() << '\n';
         }
     }
 }
+int REPL::run(std::istream &in, std::ostream &out, evaluator::Engine engine) {
+    std::stringstream source;
+    source << in.rdbuf();
+    auto lexer = std::make_unique<lexer::Lexer>(source.str());
+    parser::Parser parser = parser::Parser(std::move(lexer));
+    std::unique_ptr<ast::Program> program = parser.parseProgram();
+
+    if (parser.errors()->size() != 0) {
+        printParserErrors(out, *parser.errors());
+        return 1;
+    }
+    auto evaluated = evaluator::evalWith(engine, program.get(), new object::Environment());
+    if (evaluated != nullptr) {
+        out << evaluated->inspect() << '\n';
+    }
+    return evaluated != nullptr && evaluated->type() == object::ObjectType::ERROR_OBJ ? 1 : 0;
+}
 void REPL::printParserErrors(std::ostream &out, std::vector<std::string> errors) {
     out << MONKEY_FACE << '\n';
     out << "We ran into an issue!" << '\n';
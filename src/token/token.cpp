@@ -6,7 +6,8 @@ namespace token {
 std::map<std::string, TokenType> keywords{
     {"fn", token::TokenType::FUNCTION},   {"let", token::TokenType::LET}, {"true", token::TokenType::TRUE},
     {"false", token::TokenType::FALSE},   {"if", token::TokenType::IF},   {"else", token::TokenType::ELSE},
-    {"return", token::TokenType::RETURN},
+    {"return", token::TokenType::RETURN}, {"while", token::TokenType::WHILE}, {"for", token::TokenType::FOR},
+    {"in", token::TokenType::IN},         {"break", token::TokenType::BREAK}, {"continue", token::TokenType::CONTINUE},
 };
 
 std::string tokenTypeToString(TokenType type) {
@@ -65,6 +66,16 @@ std::string tokenTypeToString(TokenType type) {
         return "ELSE";
     case TokenType::RETURN:
         return "RETURN";
+    case TokenType::WHILE:
+        return "WHILE";
+    case TokenType::FOR:
+        return "FOR";
+    case TokenType::IN:
+        return "IN";
+    case TokenType::BREAK:
+        return "BREAK";
+    case TokenType::CONTINUE:
+        return "CONTINUE";
     case TokenType::STRING:
         return "STRING";
     case TokenType::LBRACKET:
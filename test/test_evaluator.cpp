@@ -1,12 +1,28 @@
+#include "ast/ExpressionStatement.h"
+#include "ast/FunctionLiteral.h"
+#include "ast/InfixExpression.h"
+#include "evaluator/ClosureCompiler.h"
+#include "evaluator/Compiler.h"
+#include "evaluator/FunctionProfile.h"
+#include "evaluator/Jit.h"
+#include "evaluator/Optimizer.h"
+#include "evaluator/RegisterMachine.h"
+#include "evaluator/StacklessMachine.h"
+#include "evaluator/Superinstructions.h"
+#include "evaluator/Tiering.h"
+#include "evaluator/TypeInference.h"
 #include "evaluator/evaluator.h"
 #include "lexer.h"
+#include "monkeyc/Transpiler.h"
 #include "object/Array.h"
 #include "object/Boolean.h"
 #include "object/Environment.h"
 #include "object/Error.h"
 #include "object/Function.h"
+#include "object/FunctionPrototype.h"
 #include "object/Hash.h"
 #include "object/Integer.h"
+#include "object/Set.h"
 #include "object/String.h"
 #include "object/object.h"
 #include "parser.h"
@@ -14,13 +30,30 @@
 #include <iostream>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
+std::unique_ptr<ast::Program> parse(const std::string &input);
 object::Object *testEval(std::string input);
+object::Object *testEvalIn(std::string input, object::Environment *env);
 void testIntegerObject(object::Object *obj, int expected);
+void testIntegerOnEveryEngine(const std::string &input, int expected);
 void testBooleanObject(object::Object *obj, bool expected);
 void testNullObject(object::Object *obj);
 
+// Puts back the process-wide tiering settings a test changes, however the
+// test exits.
+struct TierSettings {
+    bool jitEnabled = evaluator::jitEnabled;
+    evaluator::TierPolicy tierPolicy = evaluator::tierPolicy;
+    evaluator::TierStats *tierStats = evaluator::tierStats;
+    ~TierSettings() {
+        evaluator::jitEnabled = jitEnabled;
+        evaluator::tierPolicy = tierPolicy;
+        evaluator::tierStats = tierStats;
+    }
+};
+
 TEST(EvaluatorTest, EvalIntegerExpression) {
     struct IntegerTest {
         std::string input;
@@ -137,6 +170,27 @@ TEST(EvaluatorTest, ReturnStatements) {
     }
 }
 
+TEST(EvaluatorTest, ReturnAndErrorStatus) {
+    struct Test {
+        std::string input;
+        int expected;
+    };
+    Test tests[3] = {
+        {"let f = fn(n) { if (n == 0) { return 0; } return f(n - 1) + 1; }; f(500);", 500},
+        {"let f = fn() { let a = [1, if (true) { return 7; }, 3]; 99 }; f();", 7},
+        {"let f = fn() { return 2; }; let g = fn() { f() + 1 }; g() * 2;", 6},
+    };
+    for (const auto &test : tests) {
+        testIntegerObject(testEval(test.input), test.expected);
+    }
+
+    auto evaluated = testEval("let f = fn(x) { x + true }; [1, f(2), 3]; 4");
+    auto *err = dynamic_cast<object::Error *>(evaluated);
+    ASSERT_NE(err, nullptr) << "error did not stop evaluation" << '\n';
+    EXPECT_EQ(err->message, "type mismatch: INTEGER + BOOLEAN");
+    EXPECT_EQ(evaluator::lastError.code, object::ErrorCode::TYPE_MISMATCH);
+}
+
 TEST(EvaluatorTest, ErrorHandling) {
     struct ErrTest {
         std::string input;
@@ -220,13 +274,724 @@ TEST(EvaluatorTest, FunctionObject) {
     auto evaluated = testEval(input);
     auto *func = dynamic_cast<object::Function *>(evaluated);
     EXPECT_NE(func, nullptr) << "function is not a Function. got=" << func << '\n';
-    EXPECT_EQ(func->parameters.size(), 1)
-        << "function parameters are no the right size. got=" << func->parameters.size() << " expected=1" << '\n';
-    EXPECT_EQ(func->parameters[0]->toString(), "x")
-        << "param is not x. got=" << func->parameters[0]->toString() << '\n';
+    auto &prototype = func->prototype;
+    EXPECT_EQ(prototype->parameters.size(), 1) << "function parameters are no the right size. got="
+                                               << prototype->parameters.size() << " expected=1" << '\n';
+    EXPECT_EQ(prototype->parameters[0], "x") << "param is not x. got=" << prototype->parameters[0] << '\n';
     std::string expectedBody = "(x + 2)";
-    EXPECT_EQ(func->body->toString(), expectedBody)
-        << "body is not " << expectedBody << ", got=" << func->body->toString() << '\n';
+    EXPECT_EQ(prototype->body->toString(), expectedBody)
+        << "body is not " << expectedBody << ", got=" << prototype->body->toString() << '\n';
+}
+
+TEST(EvaluatorTest, ClosureFactory) {
+    std::string input = R"(
+        let makeAdder = fn(x) { fn(y) { x + y } };
+        let addOne = makeAdder(1);
+        let addTen = makeAdder(10);
+        addOne(2) + addTen(20) + makeAdder(100)(300);
+    )";
+    testIntegerObject(testEval(input), 433);
+
+    std::unique_ptr<ast::Program> program =
+        parse("fn(a, b) { let c = a; if (a) { let d = b; let c = d; } fn(e) { let f = e; } }");
+    object::Environment *env = new object::Environment();
+    auto *first = dynamic_cast<object::Function *>(evaluator::eval(program.get(), env));
+    auto *second = dynamic_cast<object::Function *>(evaluator::eval(program.get(), env));
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(first->prototype, second->prototype) << "closures of one literal should share a prototype" << '\n';
+    EXPECT_EQ(first->prototype->arity, 2);
+    EXPECT_EQ(first->prototype->frameSize, 4);
+
+    program.reset();
+    EXPECT_EQ(second->inspect().substr(0, 9), "fn(a, b) ");
+}
+
+TEST(EvaluatorTest, ClosureConversion) {
+    struct Test {
+        std::string input;
+        int expected;
+    };
+    Test tests[4] = {
+        {"let f = fn(a) { fn(b) { fn(c) { a + b + c } } }; f(1)(20)(300);", 321},
+        {"let f = fn() { let g = fn() { x }; let x = 5; g() }; f();", 5},
+        {"let f = fn() { let count = fn(n) { if (n == 0) { 0 } else { count(n - 1) + 1 } }; count(30) }; f();", 30},
+        {"let x = 1; let f = fn() { let y = x + 1; fn() { x + y } }; let x = 10; f()();", 21},
+    };
+    for (const auto &test : tests) {
+        testIntegerObject(testEval(test.input), test.expected);
+    }
+
+    std::unique_ptr<ast::Program> program = parse("fn(a, b, unused) { let c = 1; fn() { fn() { a + c } } }");
+    auto *outer = dynamic_cast<object::Function *>(evaluator::eval(program.get(), new object::Environment()));
+    ASSERT_NE(outer, nullptr);
+    EXPECT_EQ(outer->prototype->cellCount, 2) << "only a and c are captured" << '\n';
+    EXPECT_EQ(outer->prototype->slotCount, 2);
+    EXPECT_TRUE(outer->prototype->captures.empty());
+
+    auto *middle = dynamic_cast<object::Function *>(testEval("let f = fn(a) { fn() { fn() { a } } }; f(7)"));
+    ASSERT_NE(middle, nullptr);
+    ASSERT_EQ(middle->upvalues.size(), 1) << "middle function must thread a's cell through" << '\n';
+    EXPECT_EQ(middle->prototype->frameSize, 0);
+    testIntegerObject(middle->upvalues[0]->value, 7);
+}
+
+TEST(EvaluatorTest, TailCalls) {
+    struct Test {
+        std::string input;
+        int expected;
+    };
+    Test tests[4] = {
+        {"let loop = fn(n, acc) { if (n == 0) { acc } else { loop(n - 1, acc + 1) } }; loop(100000, 0);", 100000},
+        {"let loop = fn(n) { if (n == 0) { return 7; } return loop(n - 1); }; loop(100000);", 7},
+        {R"(
+            let even = fn(n) { if (n == 0) { true } else { odd(n - 1) } };
+            let odd = fn(n) { if (n == 0) { false } else { even(n - 1) } };
+            if (even(100001)) { 1 } else { 0 };
+        )",
+         0},
+        {R"(
+            let collect = fn(n, acc) { if (n == 0) { acc } else { collect(n - 1, push(acc, fn() { n })) } };
+            let fs = collect(3, []);
+            fs[0]() + fs[2]() * 10;
+        )",
+         13},
+    };
+    for (const auto &test : tests) {
+        testIntegerObject(testEval(test.input), test.expected);
+    }
+    testIntegerObject(testEval("let f = fn(xs) { len(xs) }; f([1, 2, 3]);"), 3);
+}
+
+TEST(EvaluatorTest, StacklessMachine) {
+    std::string inputs[] = {
+        "let f = fn(x) { if (x > 1) { return x * f(x - 1); } 1 }; f(10);",
+        "let h = {\"a\": [1, 2, 3], 2: fn(x) { -x }}; h[\"a\"][1] + h[2](5) + len(\"four\");",
+        "let mk = fn(a) { fn(b) { a + b } }; let g = mk(3); [g(1), g(2), !true][1];",
+        "if (1 < 2) { let y = 4; y * y } else { 0 }",
+        "5 + true; 10",
+        "let f = fn(x) { x }; f(1, 2);",
+        "{fn(x) { x }: 1}",
+    };
+    for (const auto &input : inputs) {
+        auto program = parse(input);
+        auto expected = evaluator::eval(program.get(), new object::Environment());
+        auto got = evaluator::evalStackless(program.get(), new object::Environment());
+        ASSERT_NE(got, nullptr) << input << '\n';
+        EXPECT_EQ(got->inspect(), expected->inspect()) << input << '\n';
+    }
+
+    auto deep = parse("let depth = fn(n) { if (n == 0) { 0 } else { 1 + depth(n - 1) } }; depth(100000);");
+    testIntegerObject(evaluator::evalStackless(deep.get(), new object::Environment()), 100000);
+
+    auto *err = dynamic_cast<object::Error *>(evaluator::evalStackless(deep.get(), new object::Environment(), 4096));
+    ASSERT_NE(err, nullptr) << "budget was not enforced" << '\n';
+    EXPECT_EQ(err->message, "evaluation exceeded its memory budget of 4096 bytes");
+
+    // two machines time-sliced on one thread
+    auto loop = parse("let loop = fn(n, acc) { if (n == 0) { acc } else { loop(n - 1, acc + 2) } }; loop(2000, 0);");
+    evaluator::StacklessMachine first;
+    evaluator::StacklessMachine second;
+    first.start(deep.get(), new object::Environment());
+    second.start(loop.get(), new object::Environment());
+    int slices = 0;
+    bool firstDone = false;
+    bool secondDone = false;
+    while (!firstDone || !secondDone) {
+        firstDone = first.run(100);
+        secondDone = second.run(100);
+        slices++;
+    }
+    EXPECT_GT(slices, 100);
+    testIntegerObject(first.result(), 100000);
+    testIntegerObject(second.result(), 4000);
+}
+
+TEST(EvaluatorTest, RegisterMachine) {
+    std::string inputs[] = {
+        "let f = fn(x) { if (x > 1) { return x * f(x - 1); } 1 }; f(10);",
+        "let h = {\"a\": [1, 2, 3], 2: fn(x) { -x }}; h[\"a\"][1] + h[2](5) + len(\"four\");",
+        "let mk = fn(a) { let b = a * 2; fn(c) { fn(d) { a + b + c + d } } }; mk(10)(1)(100);",
+        "let counter = fn() { let c = 0; fn() { c = c + 1 } }; let next = counter(); next(); next();",
+        "[1 == 1, 1 != 2, !true, !!0, -5, \"ab\" + \"cd\", [1, 2][5], {1: 2}[3], if (false) { 1 }]",
+        "let f = fn(x) { let y = x; if (x > 2) { let z = 10; } z }; let z = 99; [f(1), f(5)]",
+        "let f = fn(x) { let y = x + (x = 3); [x, y] }; f(1)",
+        "let xs = [1, 2]; xs[1] = xs[0] + 41; let h = {}; h[\"k\"] = xs; h",
+        "let t = 0; for (k in {1: 10, 2: 20}) { t = t + k; } let i = 0; while (true) { i = i + 1; "
+        "if (i < 5) { continue; } if (i > 8) { break; } t = t + 100 } [t, i]",
+        "collect(map(range(4), fn(x) { x * x }))",
+        "let loop = fn(n, acc) { if (n == 0) { return acc; } loop(n - 1, acc + 1) }; loop(100000, 0)",
+        "let x = 1; let x = 2; x",
+        "5 + true; 10",
+        "let f = fn(x) { x }; f(1, 2);",
+        "let x = 5; x(1)",
+        "y = 1;",
+        "for (x in 5) { x }",
+        "{[1]: 2}",
+        "map(1, 2)",
+    };
+    for (const auto &input : inputs) {
+        auto program = parse(input);
+        auto expected = evaluator::eval(program.get(), new object::Environment());
+        auto got = evaluator::evalRegisterMachine(program.get(), new object::Environment());
+        ASSERT_NE(got, nullptr) << input << '\n';
+        EXPECT_EQ(got->inspect(), expected->inspect()) << input << '\n';
+    }
+
+    // calls do not recurse on the native stack
+    auto deep = parse("let depth = fn(n) { if (n == 0) { 0 } else { 1 + depth(n - 1) } }; depth(100000);");
+    testIntegerObject(evaluator::evalRegisterMachine(deep.get(), new object::Environment()), 100000);
+
+    // three-address code: locals are operands in place, no pushes or pops
+    auto kernel = parse("fn(a, b, c, d) { a * b + c * d }");
+    evaluator::evalRegisterMachine(kernel.get(), new object::Environment());
+    auto literal = static_cast<ast::FunctionLiteral *>(
+        static_cast<ast::ExpressionStatement *>(kernel->statements[0].get())->expression.get());
+    auto code = evaluator::compileFunction(*literal->prototype);
+    std::vector<evaluator::Opcode> ops;
+    for (const auto &instruction : code->code) {
+        ops.push_back(instruction.op);
+    }
+    std::vector<evaluator::Opcode> expected = {evaluator::Opcode::MUL, evaluator::Opcode::MUL, evaluator::Opcode::ADD,
+                                               evaluator::Opcode::RETURN};
+    EXPECT_EQ(ops, expected) << evaluator::disassemble(*code);
+}
+
+TEST(EvaluatorTest, ClosureCompiler) {
+    std::string inputs[] = {
+        "let f = fn(x) { if (x > 1) { return x * f(x - 1); } 1 }; f(10);",
+        "let h = {\"a\": [1, 2, 3], 2: fn(x) { -x }}; h[\"a\"][1] + h[2](5) + len(\"four\");",
+        "let mk = fn(a) { let b = a * 2; fn(c) { fn(d) { a + b + c + d } } }; mk(10)(1)(100);",
+        "let counter = fn() { let c = 0; fn() { c = c + 1 } }; let next = counter(); next(); next();",
+        "[1 == 1, 1 != 2, !true, !!0, -5, \"ab\" + \"cd\", [1, 2][5], {1: 2}[3], if (false) { 1 }]",
+        "let f = fn(x) { let y = x; if (x > 2) { let z = 10; } z }; let z = 99; [f(1), f(5)]",
+        "let xs = [1, 2]; xs[1] = xs[0] + 41; let h = {}; h[\"k\"] = xs; h",
+        "let t = 0; for (k in {1: 10, 2: 20}) { t = t + k; } let i = 0; while (true) { i = i + 1; "
+        "if (i < 5) { continue; } if (i > 8) { break; } t = t + 100 } [t, i]",
+        "collect(map(range(4), fn(x) { x * x }))",
+        "let loop = fn(n, acc) { if (n == 0) { return acc; } loop(n - 1, acc + 1) }; loop(100000, 0)",
+        "[1 + true, 5]",
+        "\"a\" - 1",
+        "let f = fn(x) { x }; f(1, 2);",
+        "let x = 5; x(1)",
+        "y = 1;",
+        "for (x in 5) { x }",
+        "{[1]: 2}",
+        "-\"a\"",
+    };
+    for (const auto &input : inputs) {
+        auto program = parse(input);
+        auto expected = evaluator::eval(program.get(), new object::Environment());
+        auto got = evaluator::evalClosureCompiled(program.get(), new object::Environment());
+        ASSERT_NE(got, nullptr) << input << '\n';
+        EXPECT_EQ(got->inspect(), expected->inspect()) << input << '\n';
+    }
+
+    // a function's body is compiled once, on its first call, and shared by its closures
+    auto env = new object::Environment();
+    auto program = parse("let add = fn(a) { fn(b) { a + b } }; let one = add(1); let two = add(2); one(1) + two(2)");
+    testIntegerObject(evaluator::evalClosureCompiled(program.get(), env), 6);
+    auto one = static_cast<object::Function *>(env->get("one"));
+    auto two = static_cast<object::Function *>(env->get("two"));
+    ASSERT_NE(evaluator::profileOf(one->prototype.get()).compiled, nullptr);
+    EXPECT_EQ(evaluator::profileOf(one->prototype.get()).compiled, evaluator::profileOf(two->prototype.get()).compiled);
+}
+
+TEST(EvaluatorTest, Quickening) {
+    auto runRegisters = [](const std::string &input, object::Environment *env) {
+        return evaluator::evalRegisterMachine(parse(input).get(), env);
+    };
+    auto function = [](object::Environment *env) { return static_cast<object::Function *>(env->get("f")); };
+
+    // the tree walker rewrites the node to the operand types it last saw
+    auto env = new object::Environment();
+    testEvalIn("let f = fn(a, b) { a + b };", env);
+    auto body = function(env)->prototype->body;
+    auto infix = static_cast<ast::InfixExpression *>(
+        static_cast<ast::ExpressionStatement *>(body->statements[0].get())->expression.get());
+    EXPECT_EQ(infix->form, ast::InfixForm::UNSPECIALIZED);
+    testIntegerObject(testEvalIn("f(1, 2)", env), 3);
+    EXPECT_EQ(infix->form, ast::InfixForm::ADD_INT_INT);
+    EXPECT_EQ(testEvalIn("f(\"a\", \"b\")", env)->inspect(), "ab");
+    EXPECT_EQ(infix->form, ast::InfixForm::CONCAT_STR);
+    EXPECT_EQ(infix->deopts, 1);
+    // a site that keeps changing types stays generic
+    for (int i = 0; i < evaluator::MAX_DEOPTS; i++) {
+        testEvalIn("f(1, 2); f(\"a\", \"b\")", env);
+    }
+    EXPECT_EQ(infix->form, ast::InfixForm::UNSPECIALIZED);
+    testIntegerObject(testEvalIn("f(1, 2)", env), 3);
+    EXPECT_EQ(testEvalIn("f(1, true)", env)->inspect(), "Error: type mismatch: INTEGER + BOOLEAN");
+
+    // the register machine rewrites the instruction in place
+    env = new object::Environment();
+    runRegisters("let f = fn(a, b) { a + b };", env);
+    testIntegerObject(runRegisters("f(1, 2)", env), 3);
+    auto &add = evaluator::profileOf(function(env)->prototype.get()).code->code[0];
+    EXPECT_EQ(add.op, evaluator::Opcode::ADD_INT_INT);
+    EXPECT_EQ(runRegisters("f(\"a\", \"b\")", env)->inspect(), "ab");
+    EXPECT_EQ(add.op, evaluator::Opcode::CONCAT_STR);
+    EXPECT_EQ(add.deopts, 1);
+    EXPECT_EQ(runRegisters("f(1, true)", env)->inspect(), "Error: type mismatch: INTEGER + BOOLEAN");
+    EXPECT_EQ(add.op, evaluator::Opcode::ADD);
+    testIntegerObject(runRegisters("f(40, 2)", env), 42);
+    EXPECT_EQ(add.op, evaluator::Opcode::ADD_INT_INT);
+}
+
+TEST(EvaluatorTest, Superinstructions) {
+    auto ops = [](const evaluator::CodeBlock &code) {
+        std::vector<evaluator::Opcode> ops;
+        for (const auto &instruction : code.code) {
+            ops.push_back(instruction.op);
+        }
+        return ops;
+    };
+
+    // fused and unfused evaluation agree, including locals read before their let
+    std::string inputs[] = {
+        "let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }; fib(15)",
+        "let sum = fn(xs) { let i = 0; let s = 0; while (i < len(xs)) { s = s + xs[i]; i = i + 1; } s }; "
+        "sum([1, 2, 3])",
+        "let f = fn(x) { if (x > 2) { let z = 10; } z + 1 }; let z = 99; [f(1), f(5)]",
+        "let f = fn(a, b) { [a + b, a == b, a - 1] }; [f(1, 2), f(\"x\", \"y\")]",
+        "let f = fn(a) { len(a) }; f(1)",
+        "let f = fn(h, k) { h[k] }; [f({1: 2}, 1), f([5, 6], 1), f(1, 1)]",
+        "let f = fn(x) { g(x) }; f(1)",
+    };
+    for (const auto &input : inputs) {
+        evaluator::enabledFusions = evaluator::FusionSet();
+        auto plain = parse(input);
+        auto expected = evaluator::eval(plain.get(), new object::Environment())->inspect();
+        evaluator::enabledFusions = evaluator::allFusions();
+        auto fused = parse(input);
+        EXPECT_EQ(evaluator::eval(fused.get(), new object::Environment())->inspect(), expected) << input;
+        auto compiled = parse(input);
+        EXPECT_EQ(evaluator::evalRegisterMachine(compiled.get(), new object::Environment())->inspect(), expected)
+            << input;
+    }
+    evaluator::enabledFusions = evaluator::defaultFusions();
+
+    // a profiling run counts the fused nodes; shapes that never ran are not chosen
+    evaluator::FusionProfile profile;
+    evaluator::fusionProfile = &profile;
+    auto profiled = parse("let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } }; fib(10)");
+    evaluator::eval(profiled.get(), new object::Environment());
+    evaluator::fusionProfile = nullptr;
+    EXPECT_EQ(profile.counts[static_cast<std::size_t>(ast::Fusion::LOCAL_OP_CONST)], 177u + 2 * 88u);
+    EXPECT_EQ(profile.counts[static_cast<std::size_t>(ast::Fusion::CALL_NAMED)], 176u);
+    auto chosen = evaluator::chooseFusions(profile, 0.01);
+    EXPECT_TRUE(chosen.test(static_cast<std::size_t>(ast::Fusion::LOCAL_OP_CONST)));
+    EXPECT_TRUE(chosen.test(static_cast<std::size_t>(ast::Fusion::CALL_NAMED)));
+    EXPECT_FALSE(chosen.test(static_cast<std::size_t>(ast::Fusion::INDEX_BY_LOCAL)));
+    // the default set is chosen the same way from the checked-in profile
+    EXPECT_EQ(evaluator::defaultFusions(), evaluator::chooseFusions(evaluator::defaultProfile, 0.01));
+    EXPECT_TRUE(evaluator::defaultFusions().test(static_cast<std::size_t>(ast::Fusion::LOCAL_OP_LOCAL)));
+
+    // the register machine tests and branches in one instruction, and passes
+    // a single local argument in place
+    auto branch = parse("fn(n) { if (n < 2) { 1 } else { 0 } }");
+    evaluator::evalRegisterMachine(branch.get(), new object::Environment());
+    auto literal = static_cast<ast::FunctionLiteral *>(
+        static_cast<ast::ExpressionStatement *>(branch->statements[0].get())->expression.get());
+    auto code = evaluator::compileFunction(*literal->prototype);
+    EXPECT_EQ(ops(*code).front(), evaluator::Opcode::JMPIFNOTLT) << evaluator::disassemble(*code);
+
+    auto call = parse("fn(xs) { len(xs) + 1 }");
+    evaluator::evalRegisterMachine(call.get(), new object::Environment());
+    literal = static_cast<ast::FunctionLiteral *>(
+        static_cast<ast::ExpressionStatement *>(call->statements[0].get())->expression.get());
+    code = evaluator::compileFunction(*literal->prototype);
+    std::vector<evaluator::Opcode> expected = {evaluator::Opcode::GETGLOBAL, evaluator::Opcode::CALL1,
+                                               evaluator::Opcode::ADD, evaluator::Opcode::RETURN};
+    EXPECT_EQ(ops(*code), expected) << evaluator::disassemble(*code);
+}
+
+#if MONKEY_JIT_SUPPORTED
+TEST(EvaluatorTest, Jit) {
+    TierSettings settings;
+    evaluator::jitEnabled = true;
+    evaluator::tierPolicy = evaluator::TierPolicy{0, 3, 0, false};
+
+    // a function is compiled once it has been called nativeThreshold times
+    auto env = new object::Environment();
+    testEvalIn("let f = fn(a, b) { if (a < b) { a * b - 1 } else { a + b } };", env);
+    auto f = static_cast<object::Function *>(env->get("f"));
+    testIntegerObject(testEvalIn("f(2, 3)", env), 5);
+    testIntegerObject(testEvalIn("f(3, 2)", env), 5);
+    EXPECT_EQ(evaluator::profileOf(f->prototype.get()).native, nullptr);
+    testIntegerObject(testEvalIn("f(4, 5)", env), 19);
+    ASSERT_NE(evaluator::profileOf(f->prototype.get()).native, nullptr);
+    testIntegerObject(testEvalIn("f(5, 4)", env), 9);
+    // non-integer operands leave the inline path for the runtime
+    EXPECT_EQ(testEvalIn("f(true, 1)", env)->inspect(), "Error: type mismatch: BOOLEAN < INTEGER");
+
+    // compiled code gives the interpreter's results, errors and tail calls included
+    std::string inputs[] = {
+        "let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) }; fib(15)",
+        "let loop = fn(n, acc) { if (n == 0) { return acc; } loop(n - 1, acc + 1) }; loop(100000, 0)",
+        "let sum = fn(xs) { let t = 0; for (x in xs) { t = t + x; } t }; [sum([1, 2, 3]), sum(range(10)), sum([])]",
+        "let g = fn(x) { let h = {\"k\": [x, x / 2]}; h[\"k\"][1] + len(\"abc\") }; [g(10), g(11), g(12), g(13)]",
+        "let count = fn(n) { let i = 0; while (i < n) { i = i + 1; } i }; [count(5), count(5), count(5), count(5)]",
+        "let add = fn(a) { fn(b) { a + b } }; let inc = add(1); [inc(1), inc(2), inc(3), inc(4)]",
+        "let d = fn(x) { 10 / x }; [d(1), d(2), d(5), d(-3)]",
+        "let c = fn(a, b) { a + b }; [c(1, 2), c(3, 4), c(\"a\", \"b\"), c(5, 6), c(\"c\", \"d\")]",
+        "let k = fn(x) { x + missing }; [k(1), k(2), k(3), k(4)]",
+    };
+    for (const auto &input : inputs) {
+        evaluator::jitEnabled = false;
+        std::string expected = testEvalIn(input, new object::Environment())->inspect();
+        evaluator::jitEnabled = true;
+        EXPECT_EQ(testEvalIn(input, new object::Environment())->inspect(), expected) << input << '\n';
+    }
+
+    // functions that keep locals in cells are left to the interpreter
+    env = new object::Environment();
+    testEvalIn("let counter = fn() { let c = 0; fn() { c = c + 1 } }; [counter(), counter(), counter(), counter()]",
+               env);
+    auto counter = static_cast<object::Function *>(env->get("counter"));
+    EXPECT_EQ(evaluator::profileOf(counter->prototype.get()).native, nullptr);
+}
+#endif
+
+TEST(EvaluatorTest, Tiering) {
+    TierSettings settings;
+    evaluator::TierStats stats;
+    evaluator::tierStats = &stats;
+
+    // a function starts on the tree walker and moves up as its calls cross each threshold
+    evaluator::tierPolicy = evaluator::TierPolicy{2, 4, 0, false};
+    auto env = new object::Environment();
+    testEvalIn("let f = fn(x) { x * 2 };", env);
+    auto f = static_cast<object::Function *>(env->get("f"));
+    std::vector<evaluator::Tier> tiers;
+    for (int i = 1; i <= 5; i++) {
+        testIntegerObject(testEvalIn("f(" + std::to_string(i) + ")", env), 2 * i);
+        tiers.push_back(evaluator::profileOf(f->prototype.get()).tier);
+    }
+    std::vector<evaluator::Tier> expected = {evaluator::Tier::TREE, evaluator::Tier::BYTECODE,
+                                             evaluator::Tier::BYTECODE, evaluator::Tier::BYTECODE,
+                                             evaluator::Tier::BYTECODE};
+    if (evaluator::jitEnabled) {
+        expected[3] = expected[4] = evaluator::Tier::NATIVE;
+    }
+    EXPECT_EQ(tiers, expected);
+    ASSERT_GE(stats.promotions.size(), 1u);
+    EXPECT_EQ(stats.promotions[0].prototype, f->prototype.get());
+    EXPECT_EQ(stats.promotions[0].tier, evaluator::Tier::BYTECODE);
+    EXPECT_EQ(stats.promotions[0].calls, 2u);
+    EXPECT_NE(evaluator::formatTierStats(stats).find("fn(x)\tbytecode\tafter 2 calls"), std::string::npos);
+
+    // without the JIT the bytecode tier is the last one
+    evaluator::jitEnabled = false;
+    env = new object::Environment();
+    testEvalIn("let g = fn(x) { x }; g(1); g(2); g(3); g(4); g(5);", env);
+    auto g = static_cast<object::Function *>(env->get("g"));
+    EXPECT_EQ(evaluator::profileOf(g->prototype.get()).tier, evaluator::Tier::BYTECODE);
+    evaluator::jitEnabled = settings.jitEnabled;
+
+    // every tier gives the tree walker's results
+    std::string inputs[] = {
+        "let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) }; fib(15)",
+        "let loop = fn(n, acc) { if (n == 0) { return acc; } loop(n - 1, acc + 1) }; loop(100000, 0)",
+        "let counter = fn() { let c = 0; fn() { c = c + 1 } }; let n = counter(); [n(), n(), n(), n(), n(), n()]",
+        "collect(map(range(8), fn(x) { x * x }))",
+        "let k = fn(x) { x + missing }; [k(1), k(2), k(3), k(4), k(5), k(6)]",
+    };
+    for (evaluator::TierPolicy tiered : {evaluator::TierPolicy{1, 0, 0, false}, evaluator::TierPolicy{1, 3, 0, false},
+                                         evaluator::TierPolicy{1, 3, 0, true}, evaluator::TierPolicy{1, 3, 5, false},
+                                         evaluator::TierPolicy{1, 3, 5, true}}) {
+        for (const auto &input : inputs) {
+            evaluator::tierPolicy = evaluator::TierPolicy{0, 0, 0, false};
+            std::string expected = testEvalIn(input, new object::Environment())->inspect();
+            evaluator::tierPolicy = tiered;
+            EXPECT_EQ(testEvalIn(input, new object::Environment())->inspect(), expected) << input << '\n';
+            evaluator::finishBackgroundCompilation();
+        }
+    }
+
+    // with background compilation the function stays in its tier until the worker is done
+    evaluator::tierPolicy = evaluator::TierPolicy{2, 0, 0, true};
+    env = new object::Environment();
+    testEvalIn("let h = fn(x) { x + 1 }; h(1); h(2);", env);
+    auto h = static_cast<object::Function *>(env->get("h"));
+    evaluator::finishBackgroundCompilation();
+    EXPECT_EQ(evaluator::profileOf(h->prototype.get()).tier, evaluator::Tier::BYTECODE);
+    EXPECT_NE(evaluator::profileOf(h->prototype.get()).code, nullptr);
+    testIntegerObject(testEvalIn("h(3)", env), 4);
+}
+
+TEST(EvaluatorTest, OptimizingTier) {
+    if (!evaluator::optimizerAvailable()) {
+        GTEST_SKIP() << "built without LLVM";
+    }
+    TierSettings settings;
+    evaluator::jitEnabled = true;
+    evaluator::tierPolicy = evaluator::TierPolicy{0, 0, 3, false};
+
+    // integer and boolean kernels are compiled; anything else is not
+    auto env = new object::Environment();
+    testEvalIn("let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) };"
+        "let odd = fn(n) { if (n == 0) { false } else { !odd(n - 1) } };"
+        "let gcd = fn(a, b) { if (b == 0) { return a; } gcd(b, a - (a / b) * b) };"
+        "let greet = fn(x) { \"hello \" + x };"
+        "let pair = fn(x) { [x, x] };",
+        env);
+    auto prototype = [&](const std::string &name) {
+        return static_cast<object::Function *>(env->get(name))->prototype.get();
+    };
+    auto fib = evaluator::compileOptimized(prototype("fib"));
+    ASSERT_NE(fib, nullptr);
+    EXPECT_FALSE(fib->returnsBoolean());
+    EXPECT_EQ(fib->selfNames(), std::vector<std::string>{"fib"});
+    auto odd = evaluator::compileOptimized(prototype("odd"));
+    ASSERT_NE(odd, nullptr);
+    EXPECT_TRUE(odd->returnsBoolean());
+    EXPECT_NE(evaluator::compileOptimized(prototype("gcd")), nullptr);
+    EXPECT_EQ(evaluator::compileOptimized(prototype("greet")), nullptr);
+    EXPECT_EQ(evaluator::compileOptimized(prototype("pair")), nullptr);
+
+    // a function is promoted once it has been called optimizedThreshold times
+    testIntegerObject(testEvalIn("fib(1)", env), 1);
+    testIntegerObject(testEvalIn("fib(1)", env), 1);
+    EXPECT_EQ(evaluator::profileOf(prototype("fib")).tier, evaluator::Tier::TREE);
+    testIntegerObject(testEvalIn("fib(20)", env), 6765);
+    EXPECT_EQ(evaluator::profileOf(prototype("fib")).tier, evaluator::Tier::OPTIMIZED);
+    testBooleanObject(testEvalIn("[odd(1), odd(1), odd(1)]; odd(7)", env), true);
+    testIntegerObject(testEvalIn("[gcd(1, 1), gcd(1, 1), gcd(1, 1)]; gcd(1071, 462)", env), 21);
+
+    // failed guards rerun the call on a lower tier
+    EXPECT_EQ(testEvalIn("fib(\"x\")", env)->inspect(), "Error: type mismatch: STRING < INTEGER");
+    testBooleanObject(testEvalIn("odd(20001)", env), true);
+    testIntegerObject(testEvalIn("let f = fib; let fib = fn(n) { 0 }; f(10)", env), 0);
+    EXPECT_EQ(evaluator::profileOf(prototype("gcd")).tier, evaluator::Tier::OPTIMIZED);
+
+    // a function that keeps failing its guards leaves the tier for good
+    testEvalIn("let inc = fn(x) { x + 1 }; inc(1); inc(2); inc(3);", env);
+    EXPECT_EQ(evaluator::profileOf(prototype("inc")).tier, evaluator::Tier::OPTIMIZED);
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(testEvalIn("inc(true)", env)->inspect(), "Error: type mismatch: BOOLEAN + INTEGER");
+    }
+    EXPECT_TRUE(evaluator::profileOf(prototype("inc")).optimizedFailed);
+    EXPECT_LT(evaluator::profileOf(prototype("inc")).tier, evaluator::Tier::OPTIMIZED);
+    testIntegerObject(testEvalIn("inc(41)", env), 42);
+}
+
+TEST(EvaluatorTest, AheadOfTimeCompilation) {
+    auto transpile = [](const std::string &input) { return monkeyc::transpile(parse(input).get()); };
+    auto contains = [](const std::string &code, const std::string &text) {
+        return code.find(text) != std::string::npos;
+    };
+
+    // locals only ever holding integer expressions are unboxed
+    std::string code = transpile("let sum = fn(n) { let total = 0; let i = 0; while (i < n) { total = total + i; "
+                                 "i = i + 1; } total }; sum(10)");
+    EXPECT_TRUE(contains(code, "int i1_total = 0;"));
+    EXPECT_TRUE(contains(code, "int i2_i = 0;"));
+    EXPECT_TRUE(contains(code, "monkeyc::add("));
+    EXPECT_TRUE(contains(code, "evaluator::profileOf(prototype.get()).entry = f0;"));
+    // ... but not one read before its let, or assigned anything else
+    code = transpile("let f = fn() { let x = 1; x = \"s\"; let y = y + 1; y }; f()");
+    EXPECT_FALSE(contains(code, "int i"));
+
+    // a tail call of the function itself jumps back to its start
+    code = transpile("let loop = fn(n) { if (n == 0) { 0 } else { loop(n - 1) } }; loop(5)");
+    EXPECT_TRUE(contains(code, "goto start;"));
+
+    // applyFunction runs a prototype's entry in place of its body
+    auto prototype = std::make_shared<object::FunctionPrototype>(
+        std::vector<std::string>{"x"}, std::vector<ast::Binding>{{ast::BindingKind::LOCAL, 0}}, nullptr,
+        std::vector<object::FunctionPrototype::Capture>{}, 1, 0);
+    evaluator::profileOf(prototype.get()).entry = [](object::Function *, object::Args args) -> object::Result {
+        return new object::Integer(static_cast<object::Integer *>(args[0])->value * 2);
+    };
+    object::Object *argv[] = {new object::Integer(21)};
+    object::Result result =
+        evaluator::applyFunction(new object::Function(prototype, nullptr), object::Args{argv, 1});
+    testIntegerObject(result.value, 42);
+}
+
+TEST(EvaluatorTest, TypeInference) {
+    auto infer = [](const std::string &input) {
+        auto program = parse(input);
+        evaluator::inferTypes(program.get());
+        return evaluator::dumpTypes(program.get());
+    };
+
+    // parameters take the types of the arguments at every call site, and
+    // calls the type their callee returns
+    EXPECT_EQ(infer("let fib = fn(n) { if (n < 2) { return n; } fib(n - 1) + fib(n - 2) }; fib(20)"),
+              "fn(n):\n"
+              "    n: integer\n"
+              "    (n < 2): boolean\n"
+              "    (fib((n - 1)) + fib((n - 2))): integer\n"
+              "    (n - 1): integer\n"
+              "    (n - 2): integer\n");
+    EXPECT_EQ(infer("let f = fn(a, b) { let t = a > b; for (i in range(0, a)) { t = i == b; } t }; f(1, 2)"),
+              "fn(a, b):\n"
+              "    a: integer\n"
+              "    b: integer\n"
+              "    t: boolean\n"
+              "    (a > b): boolean\n"
+              "    i: integer\n"
+              "    (i == b): boolean\n");
+
+    // nothing is proven about arguments of another type, functions that
+    // escape, or variables that may be read before they are stored to
+    EXPECT_EQ(infer("let inc = fn(x) { x + 1 }; inc(1); inc(\"a\")"), "fn(x):\n");
+    EXPECT_EQ(infer("let inc = fn(x) { x + 1 }; inc(1); map([1], inc)"), "fn(x):\n");
+    EXPECT_EQ(infer("let f = fn() { if (true) { let x = 1; } x }; f()"), "fn():\n");
+    EXPECT_EQ(infer("let f = fn() { let g = fn() { y }; let y = 1; g() }; f()"), "fn():\nfn():\n");
+    EXPECT_EQ(infer("let x = 1; x + 1"), "");
+}
+
+TEST(EvaluatorTest, Loops) {
+    struct Test {
+        std::string input;
+        int expected;
+    };
+    Test tests[] = {
+        {"let i = 0; let sum = 0; while (i < 10) { let i = i + 1; let sum = sum + i; } sum;", 55},
+        {"let sum = 0; for (x in [1, 2, 3, 4]) { if (x == 3) { continue; } let sum = sum + x; } sum;", 7},
+        {"let sum = 0; for (i in range(100)) { if (i > 9) { break; } let sum = sum + i; } sum;", 45},
+        {"let sum = 0; for (i in range(10, 0, -3)) { let sum = sum * 100 + i; } sum;", 10070401},
+        {"let sum = 0; for (k in {1: 10, 2: 20, 5: 50}) { let sum = sum + k; } sum;", 8},
+        {"let h = {\"a\": 1, \"b\": 2}; let sum = 0; for (k in h) { let sum = sum + h[k]; } sum;", 3},
+        {"let n = 0; for (c in \"hello\") { let n = n + 1; } n;", 5},
+        {"let n = 0; for (m in set(3, 1, 2, 3)) { let n = n + m; } n;", 6},
+        {R"(
+            let find = fn(xs, target) {
+                let index = 0;
+                for (x in xs) {
+                    if (x == target) { return index; }
+                    let index = index + 1;
+                }
+                -1
+            };
+            find([5, 6, 7], 7) * 10 + find([5], 9);
+        )",
+         19},
+        {R"(
+            let count = fn(n) {
+                let total = 0;
+                while (true) {
+                    for (j in range(n)) {
+                        if (j == 2) { break; }
+                        let total = total + 1;
+                    }
+                    let n = n - 1;
+                    if (n == 0) { break; }
+                }
+                total
+            };
+            count(4);
+        )",
+         7},
+        {"let total = 0; for (i in range(200000)) { let total = total + 1; } total;", 200000},
+    };
+    for (const auto &test : tests) {
+        testIntegerOnEveryEngine(test.input, test.expected);
+    }
+
+    auto evaluated = testEval("for (x in 5) { x }");
+    auto *err = dynamic_cast<object::Error *>(evaluated);
+    ASSERT_NE(err, nullptr) << "no error object returned" << '\n';
+    EXPECT_EQ(err->message, "not iterable: INTEGER");
+    testIntegerObject(testEval("len(range(2, 11, 3))"), 3);
+    auto *reversed = dynamic_cast<object::String *>(testEval("let s = \"\"; for (c in \"abc\") { let s = c + s; } s"));
+    ASSERT_NE(reversed, nullptr);
+    EXPECT_EQ(reversed->value(), "cba");
+}
+
+TEST(EvaluatorTest, Assignment) {
+    struct Test {
+        std::string input;
+        int expected;
+    };
+    Test tests[] = {
+        {"let x = 1; x = x + 41; x;", 42},
+        {"let a = 1; let b = 2; a = b = 7; a + b;", 14},
+        {"let counter = fn() { let c = 0; fn() { c = c + 1 } }; let next = counter(); next(); next(); next();", 3},
+        {"let total = 0; let add = fn(n) { total = total + n; }; add(3); add(4); total;", 7},
+        {"let xs = [1, 2, 3]; let ys = xs; xs[1] = 20; ys[1] + len(xs);", 23},
+        {"let h = {\"a\": 1}; h[\"a\"] = 5; h[\"b\"] = 6; h[\"a\"] * 10 + h[\"b\"];", 56},
+        {"let h = {}; for (i in range(100)) { h[i * 2] = i; } h[198] + h[10];", 104},
+        {R"(
+            let fib = fn(n) {
+                let table = [0, 1];
+                for (i in range(2, n + 1)) { table = push(table, 0); }
+                for (i in range(2, n + 1)) { table[i] = table[i - 1] + table[i - 2]; }
+                table[n]
+            };
+            fib(40);
+        )",
+         102334155},
+        {"let i = 0; let sum = 0; while (i < 5) { i = i + 1; sum = sum + i; } sum;", 15},
+    };
+    for (const auto &test : tests) {
+        testIntegerOnEveryEngine(test.input, test.expected);
+    }
+
+    struct ErrTest {
+        std::string input;
+        std::string expectedMessage;
+    };
+    ErrTest errors[] = {
+        {"y = 1;", "identifier not found: y"},
+        {"let xs = [1]; xs[1] = 2;", "index out of range: 1 (length 1)"},
+        {"let h = {}; h[[1]] = 2;", "unusable as hash key: ARRAY"},
+        {"let s = \"abc\"; s[0] = \"x\";", "index operator not supported: STRING"},
+    };
+    for (const auto &test : errors) {
+        auto *err = dynamic_cast<object::Error *>(testEval(test.input));
+        ASSERT_NE(err, nullptr) << test.input << '\n';
+        EXPECT_EQ(err->message, test.expectedMessage);
+    }
+}
+
+TEST(EvaluatorTest, Iterators) {
+    struct Test {
+        std::string input;
+        int expected;
+    };
+    Test tests[] = {
+        {"reduce(map(filter(range(1, 11), fn(x) { x / 2 * 2 == x }), fn(x) { x * x }), 0, fn(a, x) { a + x });", 220},
+        {"len(collect(take(map(range(1000000000), fn(x) { x * 3 }), 4)));", 4},
+        {"collect(take(filter(range(100), fn(x) { x / 7 * 7 == x }), 3))[2];", 14},
+        {"let pairs = collect(zip([1, 2, 3], range(10, 100, 10))); pairs[2][0] * 100 + pairs[2][1];", 330},
+        {"len(collect(zip(range(5), \"ab\")));", 2},
+        {"let sum = 0; for (x in map([1, 2, 3], fn(x) { x + 1 })) { sum = sum + x; } sum;", 9},
+        {"let it = map(range(4), fn(x) { x }); collect(take(it, 2)); len(collect(it));", 2},
+        {"let calls = 0; let f = fn(x) { calls = calls + 1; x }; collect(take(map(range(100), f), 3)); calls;", 3},
+        {"reduce({1: 1, 2: 2}, 10, fn(a, k) { a + k });", 13},
+        {"reduce(map(range(200000), fn(x) { 1 }), 0, fn(a, x) { a + x });", 200000},
+        // iterators are single-use; ranges are not
+        {"let it = map(range(3), fn(x) { x }); collect(it); len(collect(it));", 0},
+        {"let it = map(range(3), fn(x) { x }); let n = 0; for (x in it) { n = n + 1; } "
+         "reduce(it, n, fn(a, x) { 0 });",
+         3},
+        {"let r = range(3); collect(r); len(collect(r));", 3},
+    };
+    for (const auto &test : tests) {
+        testIntegerOnEveryEngine(test.input, test.expected);
+    }
+
+    struct ErrTest {
+        std::string input;
+        std::string expectedMessage;
+    };
+    ErrTest errors[] = {
+        {"collect(map(5, fn(x) { x }));", "argument to `map` not supported, got INTEGER"},
+        {"collect(map([1, \"a\"], fn(x) { -x }));", "unknown operator: -STRING"},
+        {"for (x in filter([1], fn(x) { y })) { x }", "identifier not found: y"},
+        {"take([1], -1);", "argument to `take` must be a non-negative INTEGER, got INTEGER"},
+        {"range(0, 5, 0);", "step of `range` must not be zero"},
+    };
+    for (const auto &test : errors) {
+        auto *err = dynamic_cast<object::Error *>(testEval(test.input));
+        ASSERT_NE(err, nullptr) << test.input << '\n';
+        EXPECT_EQ(err->message, test.expectedMessage);
+    }
 }
 
 TEST(EvaluatorTest, FunctionApplication) {
@@ -248,13 +1013,49 @@ TEST(EvaluatorTest, FunctionApplication) {
     }
 }
 
+TEST(EvaluatorTest, FunctionArity) {
+    struct ArityTest {
+        std::string input;
+        std::string expected;
+    };
+    ArityTest tests[3] = {
+        {"let add = fn(x, y) { x + y; }; add(1);", "wrong number of arguments. want=2 but got=1"},
+        {"fn() { 1 }(1, 2)", "wrong number of arguments. want=0 but got=2"},
+        {"let add = fn(x, y) { x + y; }; add(1, add(2, 3, 4));", "wrong number of arguments. want=2 but got=3"},
+    };
+    for (ArityTest test : tests) {
+        auto evaluated = testEval(test.input);
+        auto *err = dynamic_cast<object::Error *>(evaluated);
+        ASSERT_NE(err, nullptr) << "object is not an Error. got=" << evaluated << '\n';
+        EXPECT_EQ(err->message, test.expected);
+    }
+}
+
+TEST(EvaluatorTest, ArgumentStack) {
+    evaluator::ArgumentStack stack;
+    auto outer = stack.mark();
+    object::Object **first = stack.reserve(3000);
+    first[2999] = nullptr;
+    // does not fit next to the first block, so it must start a new chunk without moving the first
+    object::Object **second = stack.reserve(3000);
+    EXPECT_TRUE(second + 3000 <= first || second >= first + 3000) << "reserved blocks overlap" << '\n';
+    object::Object **huge = stack.reserve(10000);
+    huge[9999] = nullptr;
+    stack.reset(outer);
+    EXPECT_EQ(stack.reserve(3000), first) << "released storage was not reused" << '\n';
+
+    std::string input = "let sum = fn(a, b, c, d, e, f) { a + b + c + d + e + f }; ";
+    input += "sum(1, sum(1, 1, 1, 1, 1, 1), 1, sum(1, 2, 3, 4, 5, 6), 1, len([1, 2]))";
+    testIntegerObject(testEval(input), 32);
+}
+
 TEST(EvaluatorTest, StringLiteral) {
     std::string input = "\"Hello World!\"";
     auto evaluated = testEval(input);
     auto *result = dynamic_cast<object::String *>(evaluated);
     EXPECT_NE(result, nullptr) << "object is not a String. got=" << evaluated << '\n';
-    EXPECT_EQ(result->value, "Hello World!")
-        << "object has wrong value. got=" << result->value << " wanted=Hello World!" << '\n';
+    EXPECT_EQ(result->value(), "Hello World!")
+        << "object has wrong value. got=" << result->value() << " wanted=Hello World!" << '\n';
 }
 
 TEST(EvaluatorTest, StringConcatenation) {
@@ -262,8 +1063,45 @@ TEST(EvaluatorTest, StringConcatenation) {
     auto evaluated = testEval(input);
     auto *result = dynamic_cast<object::String *>(evaluated);
     EXPECT_NE(result, nullptr) << "object is not a String. got=" << evaluated << '\n';
-    EXPECT_EQ(result->value, "Hello World!")
-        << "object has wrong value. got=" << result->value << " wanted=Hello World!" << '\n';
+    EXPECT_EQ(result->value(), "Hello World!")
+        << "object has wrong value. got=" << result->value() << " wanted=Hello World!" << '\n';
+}
+
+TEST(EvaluatorTest, RopeConcatenation) {
+    std::string input = R"(
+        let repeat = fn(s, n) { if (n == 0) { "" } else { repeat(s, n - 1) + s } };
+        repeat("abcdefghij", 500);
+    )";
+    auto evaluated = testEval(input);
+    auto *result = dynamic_cast<object::String *>(evaluated);
+    ASSERT_NE(result, nullptr) << "object is not a String. got=" << evaluated << '\n';
+    EXPECT_EQ(result->length(), 5000) << "string has wrong length. got=" << result->length() << '\n';
+    EXPECT_FALSE(result->isFlat()) << "long concatenation was copied eagerly" << '\n';
+    std::string expected;
+    for (int i = 0; i < 500; i++) {
+        expected += "abcdefghij";
+    }
+    EXPECT_EQ(result->value(), expected) << "flattened rope has wrong value" << '\n';
+    EXPECT_TRUE(result->isFlat()) << "rope was not flattened on access" << '\n';
+}
+
+TEST(EvaluatorTest, StringBuilder) {
+    struct BuilderTest {
+        std::string input;
+        std::string expected;
+    };
+    BuilderTest tests[4] = {
+        {"build(builder())", ""},
+        {"build(builder(\"abc\"))", "abc"},
+        {"let b = builder(); append(b, \"x = \", 5); append(b, \"!\"); build(b)", "x = 5!"},
+        {"let b = append(builder(), \"a\", \"b\"); len(build(append(b, \"c\")))", "3"},
+    };
+    for (BuilderTest test : tests) {
+        auto evaluated = testEval(test.input);
+        ASSERT_NE(evaluated, nullptr) << "input produced nullptr: " << test.input << '\n';
+        EXPECT_EQ(evaluated->inspect(), test.expected)
+            << "wrong result. got=" << evaluated->inspect() << " wanted=" << test.expected << '\n';
+    }
 }
 
 TEST(EvaluatorTest, BuiltinFunctions) {
@@ -449,11 +1287,187 @@ TEST(EvaluatorTest, HashIndexExpressions) {
     }
 }
 
-object::Object *testEval(std::string input) {
+TEST(EvaluatorTest, StringInterning) {
+    auto *first = object::String::intern("name");
+    auto *second = object::String::intern(std::string("na") + "me");
+    EXPECT_EQ(first, second) << "equal strings were interned twice" << '\n';
+    EXPECT_TRUE(first->isInterned());
+    EXPECT_EQ(first->hashKey().value, object::String("name").hashKey().value) << "interned hash differs" << '\n';
+
+    // computed keys are not interned; they make the hash general instead
+    auto evaluated = testEval("let h = {\"na\" + \"me\": 1}; h");
+    auto *hash = dynamic_cast<object::Hash *>(evaluated);
+    ASSERT_NE(hash, nullptr) << "object is not a Hash. got=" << evaluated << '\n';
+    ASSERT_EQ(hash->size(), 1) << "hash is wrong size" << '\n';
+    EXPECT_FALSE(hash->isRecord()) << "computed hash key extended a shape" << '\n';
+    EXPECT_FALSE(static_cast<object::String *>(hash->pairs.begin()->second.key)->isInterned());
+    testIntegerObject(testEval("let h = {\"na\" + \"me\": 1}; h[\"name\"]"), 1);
+    testIntegerObject(testEval("let h = {\"name\": 1}; h[\"na\" + \"me\"] = 2; h[\"name\"]"), 2);
+    auto *built = dynamic_cast<object::Hash *>(testEval("let h = {}; for (c in \"xyz\") { h[\"key-\" + c] = 1; } h"));
+    ASSERT_NE(built, nullptr);
+    EXPECT_EQ(built->size(), 3);
+    for (const auto &pair : built->pairs) {
+        EXPECT_FALSE(static_cast<object::String *>(pair.second.key)->isInterned());
+    }
+
+    testIntegerObject(testEval("let k = \"a\"; {\"ab\": 7}[k + \"b\"]"), 7);
+}
+
+TEST(EvaluatorTest, RecordShapes) {
+    auto evaluated = testEval(R"(
+        let make = fn(x, y) { {"x": x, "y": y} };
+        [make(1, 2), make(3, 4), {"x": 5}, {"x": 6, 1: 7}]
+    )");
+    auto *array = dynamic_cast<object::Array *>(evaluated);
+    ASSERT_NE(array, nullptr) << "object is not an Array. got=" << evaluated << '\n';
+    auto *first = dynamic_cast<object::Hash *>(array->elements[0]);
+    auto *second = dynamic_cast<object::Hash *>(array->elements[1]);
+    auto *third = dynamic_cast<object::Hash *>(array->elements[2]);
+    auto *mixed = dynamic_cast<object::Hash *>(array->elements[3]);
+    ASSERT_TRUE(first->isRecord() && second->isRecord() && third->isRecord());
+    EXPECT_EQ(first->shape, second->shape) << "same keys produced different shapes" << '\n';
+    EXPECT_NE(first->shape, third->shape) << "different keys produced the same shape" << '\n';
+    EXPECT_FALSE(mixed->isRecord()) << "hash with an integer key stayed a record" << '\n';
+    EXPECT_EQ(mixed->size(), 2);
+
+    struct RecordTest {
+        std::string input;
+        std::optional<int> expected;
+    };
+    RecordTest tests[4] = {
+        {R"(let get = fn(p) { p["y"] }; get({"x": 1, "y": 2}) + get({"x": 3, "y": 4}))", 6},
+        {R"(let get = fn(p) { p["y"] }; get({"x": 1, "y": 2}) + get({"y": 5}))", 7},
+        {R"(let get = fn(p, k) { p[k] }; get({"x": 1, "y": 2}, "x") + get({"x": 1, "y": 2}, "y"))", 3},
+        {R"(let get = fn(p) { p["z"] }; get({"x": 1}); get({"x": 1}))", std::nullopt},
+    };
+    for (RecordTest test : tests) {
+        auto evaluated = testEval(test.input);
+        if (test.expected.has_value()) {
+            testIntegerObject(evaluated, test.expected.value());
+        } else {
+            testNullObject(evaluated);
+        }
+    }
+}
+
+TEST(EvaluatorTest, HashKeyCollisions) {
+    // every new string hashes alike here, so the string keys below share one
+    // HashKey and only keysEqual tells them apart
+    struct CollidingHashes {
+        std::size_t (*saved)(std::string_view) = object::String::hasher;
+        CollidingHashes() { object::String::hasher = [](std::string_view) -> std::size_t { return 7; }; }
+        ~CollidingHashes() { object::String::hasher = saved; }
+    } colliding;
+    ASSERT_EQ(object::String("collide-a").hashKey().value, object::String("collide-b").hashKey().value);
+    std::string hash = R"(let h = {true: 0, "collide-a": 1, "collide-b": 2, "collide-c": 3};)";
+    testIntegerObject(testEval(hash + R"(h["collide-a"])"), 1);
+    testIntegerObject(testEval(hash + R"(h["collide-b"])"), 2);
+    testIntegerObject(testEval(hash + R"(h["collide-c"])"), 3);
+    testNullObject(testEval(hash + R"(h["collide-d"])"));
+    testIntegerObject(testEval(hash + R"(let t = 0; for (k in h) { t = t + 10 + h[k]; } t)"), 46);
+    testIntegerObject(testEval(hash + R"(h["collide-a"] = 4; h["collide-a"] * 10 + h["collide-b"])"), 42);
+    std::string inspected = testEval(hash + "h")->inspect();
+    EXPECT_NE(inspected.find("collide-a: 1"), std::string::npos) << inspected;
+    EXPECT_NE(inspected.find("collide-b: 2"), std::string::npos) << inspected;
+    EXPECT_NE(inspected.find("collide-c: 3"), std::string::npos) << inspected;
+}
+
+TEST(EvaluatorTest, DenseIntegerHashes) {
+    auto evaluated = testEval("[{0: 1, 2: 3, 5: 6}, {0: 1, 1000: 2}, {0: 1, -1: 2}, {0: 1, \"a\": 2}]");
+    auto *array = dynamic_cast<object::Array *>(evaluated);
+    ASSERT_NE(array, nullptr) << "object is not an Array. got=" << evaluated << '\n';
+    auto *dense = dynamic_cast<object::Hash *>(array->elements[0]);
+    ASSERT_TRUE(dense->isDense()) << "small integer keys did not produce a dense hash" << '\n';
+    EXPECT_EQ(dense->size(), 3);
+    for (size_t i = 1; i < array->elements.size(); i++) {
+        auto *hash = dynamic_cast<object::Hash *>(array->elements[i]);
+        EXPECT_FALSE(hash->isDense()) << "hash " << i << " should have left dense mode" << '\n';
+        EXPECT_EQ(hash->size(), 2) << "hash " << i << " lost a key while converting" << '\n';
+    }
+
+    struct DenseTest {
+        std::string input;
+        std::optional<int> expected;
+    };
+    DenseTest tests[5] = {
+        {"{0: 1, 2: 3, 5: 6}[5]", 6},
+        {"{0: 1, 2: 3, 5: 6}[1]", std::nullopt},
+        {"{0: 1, 2: 3, 5: 6}[100]", std::nullopt},
+        {"{0: 1, 1000: 2}[1000]", 2},
+        {"{3: 1, -1: 2}[-1] + {3: 1, \"a\": 2}[3]", 3},
+    };
+    for (DenseTest test : tests) {
+        auto evaluated = testEval(test.input);
+        if (test.expected.has_value()) {
+            testIntegerObject(evaluated, test.expected.value());
+        } else {
+            testNullObject(evaluated);
+        }
+    }
+}
+
+TEST(EvaluatorTest, Sets) {
+    struct SetTest {
+        std::string input;
+        std::string expected;
+    };
+    SetTest tests[14] = {
+        {"set(3, 1, 2, 3)", "set(1, 2, 3)"},
+        {"set([5, 4])", "set(4, 5)"},
+        {"len(set(1, 2, 2, 70000))", "3"},
+        {"has(set(1, 2), 2)", "true"},
+        {"has(set(1, 2), 3)", "false"},
+        {"has(set(\"a\", true), \"a\")", "true"},
+        {"has(set(\"a\", true), false)", "false"},
+        {"let s = set(); add(s, 1, 2); remove(s, 1); s", "set(2)"},
+        {"union(set(1, 2), set(2, 200))", "set(1, 2, 200)"},
+        {"intersect(set(1, 2, 3), set(2, 3, 4))", "set(2, 3)"},
+        {"difference(set(1, 2, 3), set(2))", "set(1, 3)"},
+        {"len(intersect(set(1, \"a\", -5), set(\"a\", -5)))", "2"},
+        {"set([1])[0]", "index operator not supported: SET"},
+        {"set(fn(x) { x })", "unusable as set member: FUNCTION"},
+    };
+    for (SetTest test : tests) {
+        auto evaluated = testEval(test.input);
+        ASSERT_NE(evaluated, nullptr) << "input produced nullptr: " << test.input << '\n';
+        std::string got = evaluated->inspect();
+        if (auto *err = dynamic_cast<object::Error *>(evaluated)) {
+            got = err->message;
+        }
+        EXPECT_EQ(got, test.expected) << "wrong result for " << test.input << '\n';
+    }
+
+    auto *small = dynamic_cast<object::Set *>(testEval("set(1, 2, 3)"));
+    ASSERT_NE(small, nullptr);
+    EXPECT_TRUE(small->isBitset()) << "small integer set is not a bitset" << '\n';
+    auto *large = dynamic_cast<object::Set *>(testEval("set(1, -1)"));
+    ASSERT_NE(large, nullptr);
+    EXPECT_FALSE(large->isBitset()) << "negative member stayed in a bitset" << '\n';
+
+    auto *churn = new object::Set();
+    for (int i = 0; i < 1000; i++) {
+        churn->add(new object::Integer(-i));
+        if (i % 3 == 0) {
+            churn->remove(new object::Integer(-i));
+        }
+    }
+    EXPECT_EQ(churn->size(), 666);
+    EXPECT_TRUE(churn->has(new object::Integer(-998)));
+    EXPECT_FALSE(churn->has(new object::Integer(-999)));
+}
+
+std::unique_ptr<ast::Program> parse(const std::string &input) {
     auto lexer = std::make_unique<lexer::Lexer>(input);
     parser::Parser parser = parser::Parser(std::move(lexer));
-    std::unique_ptr<ast::Program> program = parser.parseProgram();
-    object::Environment *env = new object::Environment();
+    return parser.parseProgram();
+}
+
+object::Object *testEval(std::string input) { return testEvalIn(input, new object::Environment()); }
+
+// Evaluates `input` in `env`, so a test can run several programs against
+// the same globals.
+object::Object *testEvalIn(std::string input, object::Environment *env) {
+    std::unique_ptr<ast::Program> program = parse(input);
     return evaluator::eval(program.get(), env);
 }
 
@@ -464,6 +1478,17 @@ void testIntegerObject(object::Object *obj, int expected) {
                                        << " wanted=" << expected << '\n';
 }
 
+// Runs `input` on the tree walker and every other engine, each in a fresh
+// environment, and expects `expected` from all of them.
+void testIntegerOnEveryEngine(const std::string &input, int expected) {
+    SCOPED_TRACE(input);
+    testIntegerObject(testEval(input), expected);
+    std::unique_ptr<ast::Program> program = parse(input);
+    testIntegerObject(evaluator::evalStackless(program.get(), new object::Environment()), expected);
+    testIntegerObject(evaluator::evalRegisterMachine(program.get(), new object::Environment()), expected);
+    testIntegerObject(evaluator::evalClosureCompiled(program.get(), new object::Environment()), expected);
+}
+
 void testBooleanObject(object::Object *obj, bool expected) {
     auto *result = dynamic_cast<object::Boolean *>(obj);
     EXPECT_NE(result, nullptr) << "object is not a Boolean. got=" << result << '\n';
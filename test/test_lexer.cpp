@@ -81,3 +81,20 @@ TEST(LexerTest, NextToken) {
         EXPECT_EQ(tok.literal, expected[i].second) << "Test[" << i << "] - literal wrong.";
     }
 }
+
+TEST(LexerTest, LoopKeywords) {
+    std::string input = "while for in break continue inner";
+    std::vector<std::pair<token::TokenType, std::string>> expected = {
+        {token::TokenType::WHILE, "while"}, {token::TokenType::FOR, "for"},
+        {token::TokenType::IN, "in"},       {token::TokenType::BREAK, "break"},
+        {token::TokenType::CONTINUE, "continue"}, {token::TokenType::IDENT, "inner"},
+        {token::TokenType::END_OF_FILE, ""}};
+
+    lexer::Lexer lexer(input);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        token::Token tok = lexer.nextToken();
+        EXPECT_EQ(tok.type, expected[i].first) << "Test[" << i << "] - tokentype wrong. got "
+                                               << token::tokenTypeToString(tok.type) << '\n';
+        EXPECT_EQ(tok.literal, expected[i].second) << "Test[" << i << "] - literal wrong.";
+    }
+}
@@ -102,6 +102,64 @@ TEST(ParserTest, ReturnStatement) {
     }
 }
 
+TEST(ParserTest, LoopStatements) {
+    std::string input = "while (x < 10) { x; break; } for (item in [1, 2]) { continue; item }";
+    auto lexer = std::make_unique<lexer::Lexer>(input);
+    parser::Parser parser = parser::Parser(std::move(lexer));
+    std::unique_ptr<ast::Program> program = parser.parseProgram();
+    checkParserErrors(&parser);
+    ASSERT_EQ(program->statements.size(), 2)
+        << "program statement size isn't correct: " << program->statements.size() << '\n';
+
+    auto *whileStatement = dynamic_cast<ast::WhileStatement *>(program->statements[0].get());
+    ASSERT_NE(whileStatement, nullptr) << "statement[0] is not a WhileStatement" << '\n';
+    testInfixExpression(whileStatement->condition.get(), "x", "<", 10);
+    ASSERT_EQ(whileStatement->body->statements.size(), 2);
+    EXPECT_NE(dynamic_cast<ast::BreakStatement *>(whileStatement->body->statements[1].get()), nullptr);
+
+    auto *forStatement = dynamic_cast<ast::ForStatement *>(program->statements[1].get());
+    ASSERT_NE(forStatement, nullptr) << "statement[1] is not a ForStatement" << '\n';
+    testIdentifier(forStatement->variable.get(), "item");
+    EXPECT_EQ(forStatement->iterable->toString(), "[1, 2]");
+    ASSERT_EQ(forStatement->body->statements.size(), 2);
+    EXPECT_NE(dynamic_cast<ast::ContinueStatement *>(forStatement->body->statements[0].get()), nullptr);
+
+    std::string misplaced[] = {"break;", "while (true) { fn() { continue; } }"};
+    for (const auto &test : misplaced) {
+        auto lexer = std::make_unique<lexer::Lexer>(test);
+        parser::Parser parser = parser::Parser(std::move(lexer));
+        parser.parseProgram();
+        ASSERT_EQ(parser.errors()->size(), 1) << test << '\n';
+        EXPECT_NE((*parser.errors())[0].find("outside of a loop"), std::string::npos);
+    }
+}
+
+TEST(ParserTest, AssignExpressions) {
+    struct Test {
+        std::string input;
+        std::string expected;
+    };
+    Test tests[] = {
+        {"x = 5 + 1;", "(x = (5 + 1))\n"},
+        {"a = b = c", "(a = (b = c))\n"},
+        {"xs[i + 1] = xs[i] * 2", "((xs[(i + 1)]) = ((xs[i]) * 2))\n"},
+        {"let y = h[\"k\"] = 3;", "let y = ((h[k]) = 3);\n"},
+        {"x == y = 1", ""},
+    };
+    for (const auto &test : tests) {
+        auto lexer = std::make_unique<lexer::Lexer>(test.input);
+        parser::Parser parser = parser::Parser(std::move(lexer));
+        std::unique_ptr<ast::Program> program = parser.parseProgram();
+        if (test.expected.empty()) {
+            ASSERT_EQ(parser.errors()->size(), 1) << test.input << '\n';
+            EXPECT_EQ((*parser.errors())[0], "cannot assign to (x == y)");
+            continue;
+        }
+        checkParserErrors(&parser);
+        EXPECT_EQ(program->toString(), test.expected);
+    }
+}
+
 TEST(ParserTest, TestString) {
     ast::Program program = ast::Program();
     std::unique_ptr<ast::LetStatement> letStatement = std::make_unique<ast::LetStatement>();